@@ -0,0 +1,139 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace ast
+{
+
+namespace
+{
+thread_local Arena *active_arena = nullptr;
+std::atomic<size_t> live_arenas = 0;
+
+// Заголовок перед каждым узлом: арена, которой принадлежит узел, либо nullptr для узла в куче
+struct alignas(Arena::ALIGNMENT) NodeHeader
+{
+    Arena *arena;
+};
+
+constexpr size_t AlignUp(size_t size)
+{
+    return (size + Arena::ALIGNMENT - 1) & ~(Arena::ALIGNMENT - 1);
+}
+} // namespace
+
+Arena::Arena(size_t first_block_size) : next_block_size_(std::clamp(AlignUp(first_block_size), ALIGNMENT, BLOCK_SIZE))
+{
+    live_arenas.fetch_add(1, std::memory_order_relaxed);
+}
+
+Arena::~Arena()
+{
+    live_arenas.fetch_sub(1, std::memory_order_relaxed);
+}
+
+Arena *Arena::Active()
+{
+    return active_arena;
+}
+
+size_t Arena::LiveCount()
+{
+    return live_arenas.load(std::memory_order_relaxed);
+}
+
+void *Arena::Allocate(size_t size)
+{
+    size = AlignUp(size);
+    if (size > remaining_)
+    {
+        // Крупные узлы получают отдельный блок, остаток текущего блока не используется
+        const size_t block_size = std::max(next_block_size_, size);
+        next_block_size_ = std::min(next_block_size_ * 2, BLOCK_SIZE);
+        blocks_.emplace_back(new std::byte[block_size]);
+        cursor_ = blocks_.back().get();
+        remaining_ = block_size;
+    }
+    void *result = cursor_;
+    cursor_ += size;
+    remaining_ -= size;
+    allocated_ += size;
+    return result;
+}
+
+void Arena::Release()
+{
+    Release(1);
+}
+
+void Arena::Release(size_t count)
+{
+    if (references_.fetch_sub(count, std::memory_order_acq_rel) == count)
+    {
+        delete this;
+    }
+}
+
+size_t Arena::GetAllocatedBytes() const
+{
+    return allocated_;
+}
+
+size_t Arena::GetBlockCount() const
+{
+    return blocks_.size();
+}
+
+ArenaScope::ArenaScope(size_t first_block_size) : arena_(new Arena(first_block_size)), previous_(active_arena)
+{
+    active_arena = arena_;
+}
+
+ArenaScope::~ArenaScope()
+{
+    active_arena = previous_;
+    // Ссылка области заменяется ссылками всех размещённых в ней узлов
+    arena_->Release(Arena::SCOPE_REFERENCES - arena_->node_count_);
+}
+
+Arena &ArenaScope::GetArena() const
+{
+    return *arena_;
+}
+
+void *AllocateNode(size_t size)
+{
+    Arena *arena = active_arena;
+    void *memory = nullptr;
+    if (arena != nullptr)
+    {
+        memory = arena->Allocate(sizeof(NodeHeader) + size);
+        ++arena->node_count_;
+    }
+    else
+    {
+        memory = ::operator new(sizeof(NodeHeader) + size);
+    }
+    new (memory) NodeHeader{arena};
+    return static_cast<std::byte *>(memory) + sizeof(NodeHeader);
+}
+
+void FreeNode(void *node)
+{
+    if (node == nullptr)
+    {
+        return;
+    }
+    auto *header = reinterpret_cast<NodeHeader *>(static_cast<std::byte *>(node) - sizeof(NodeHeader));
+    if (Arena *arena = header->arena)
+    {
+        arena->Release();
+    }
+    else
+    {
+        ::operator delete(header);
+    }
+}
+
+} // namespace ast
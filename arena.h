@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace ast
+{
+
+/*
+ * Арена для узлов синтаксического дерева. Узлы размещаются подряд в крупных блоках памяти
+ * вслед за заголовком из ALIGNMENT байт со ссылкой на арену. Деструкторы узлов выполняются как обычно
+ * (узлы владеют строками и значениями), но память отдельного узла не освобождается: удаление узла
+ * лишь уменьшает счётчик живых узлов арены. Размещение узла счётчик не изменяет - узлы, созданные
+ * в области ArenaScope, учитываются разом при её завершении.
+ * Все блоки освобождаются разом, когда удалён последний узел и завершена область ArenaScope,
+ * создавшая арену. Узлы считаются по отдельности, потому что части дерева (тела методов классов,
+ * инструкции IncrementalParser) живут дольше корня программы.
+ * Затраты на построение и удаление дерева сравниваются замерами BM_BuildAndFreeTree
+ */
+class Arena
+{
+public:
+    // Наибольший размер блока. Блоки арены растут вдвое, начиная с размера, заданного ArenaScope
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // Арена, в которой размещаются узлы, создаваемые текущим потоком, либо nullptr
+    [[nodiscard]] static Arena *Active();
+
+    // Количество существующих арен (для тестов и диагностики)
+    [[nodiscard]] static size_t LiveCount();
+
+    // Выделяет size байт с выравниванием ALIGNMENT. Вызывается только потоком, создавшим арену
+    [[nodiscard]] void *Allocate(size_t size);
+
+    // Освобождает ссылку удалённого узла на арену; последняя освобождённая ссылка удаляет арену
+    void Release();
+
+    [[nodiscard]] size_t GetAllocatedBytes() const;
+
+    [[nodiscard]] size_t GetBlockCount() const;
+
+private:
+    friend class ArenaScope;
+
+    friend void *AllocateNode(size_t size);
+
+    // Пока область ArenaScope не завершена, счётчик ссылок содержит SCOPE_REFERENCES вместо числа
+    // размещённых узлов: узлы, удалённые раньше завершения области, не обнуляют его
+    static constexpr size_t SCOPE_REFERENCES = std::numeric_limits<size_t>::max() / 2;
+
+    explicit Arena(size_t first_block_size);
+    ~Arena();
+
+    void Release(size_t count);
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    size_t next_block_size_;
+    std::byte *cursor_ = nullptr;
+    size_t remaining_ = 0;
+    size_t allocated_ = 0;
+    // Узлы, размещённые в области ArenaScope; изменяется только потоком, создавшим арену
+    size_t node_count_ = 0;
+    std::atomic<size_t> references_ = SCOPE_REFERENCES;
+};
+
+/*
+ * Создаёт новую арену и делает её активной для текущего потока на время своего существования.
+ * Узлы, созданные внутри области, размещаются в этой арене. Арена, в которой размещается немного узлов,
+ * начинается с блока меньше BLOCK_SIZE
+ */
+class ArenaScope
+{
+public:
+    explicit ArenaScope(size_t first_block_size = Arena::BLOCK_SIZE);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+    [[nodiscard]] Arena &GetArena() const;
+
+private:
+    Arena *arena_;
+    Arena *previous_;
+};
+
+// Выделяет память под узел в активной арене, а при её отсутствии - в куче
+[[nodiscard]] void *AllocateNode(size_t size);
+
+// Освобождает память узла, выделенную AllocateNode
+void FreeNode(void *node);
+
+} // namespace ast
@@ -0,0 +1,101 @@
+#include "batch.h"
+
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace batch
+{
+
+namespace
+{
+JobResult RunJob(const Job &job, const ProgramRunner &runner)
+{
+    JobResult result;
+    const auto start = chrono::steady_clock::now();
+    try
+    {
+        parse::MappedFile input(job.input_path);
+        ofstream output(job.output_path);
+        if (!output.is_open())
+        {
+            throw runtime_error("Failed to open output_file: "s + job.output_path);
+        }
+        runner(input.GetData(), output);
+        result.success = true;
+    }
+    catch (const exception &e)
+    {
+        result.error = e.what();
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+} // namespace
+
+std::vector<Job> ReadManifest(std::istream &input)
+{
+    std::vector<Job> jobs;
+    string line;
+    for (size_t line_number = 1; getline(input, line); ++line_number)
+    {
+        istringstream fields(line);
+        Job job;
+        if (!(fields >> job.input_path) || job.input_path[0] == '#')
+        {
+            continue;
+        }
+        string extra;
+        if (!(fields >> job.output_path) || fields >> extra)
+        {
+            throw runtime_error("Invalid manifest line "s + to_string(line_number) + ": "s + line);
+        }
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+std::vector<JobResult> RunJobs(const std::vector<Job> &jobs, size_t thread_count, const ProgramRunner &runner)
+{
+    std::vector<JobResult> results(jobs.size());
+    ThreadPool pool(thread_count);
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        pool.Submit([&jobs, &results, &runner, i] { results[i] = RunJob(jobs[i], runner); });
+    }
+    pool.Wait();
+    return results;
+}
+
+size_t PrintReport(std::ostream &output, const std::vector<Job> &jobs, const std::vector<JobResult> &results)
+{
+    size_t failed = 0;
+    double total_seconds = 0;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        const JobResult &result = results[i];
+        total_seconds += result.seconds;
+        if (result.success)
+        {
+            output << "OK "sv << jobs[i].input_path << " -> "sv << jobs[i].output_path;
+        }
+        else
+        {
+            ++failed;
+            output << "FAILED "sv << jobs[i].input_path << ": "sv << result.error;
+        }
+        output << " ("sv << fixed << setprecision(3) << result.seconds << " s)\n"sv;
+    }
+    output << jobs.size() - failed << " of "sv << jobs.size() << " jobs succeeded, "sv << fixed << setprecision(3)
+           << total_seconds << " s of job time\n"sv;
+    return failed;
+}
+
+} // namespace batch
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace batch
+{
+
+// Задание пакетного режима: программа из input_path, вывод которой записывается в output_path
+struct Job
+{
+    std::string input_path;
+    std::string output_path;
+};
+
+struct JobResult
+{
+    bool success = false;
+    // Описание ошибки, если задание не выполнено
+    std::string error;
+    double seconds = 0;
+};
+
+// Исполняет текст программы source, направляя вывод в output
+using ProgramRunner = std::function<void(std::string_view source, std::ostream &output)>;
+
+/*
+ * Читает список заданий: каждая непустая строка содержит путь к входному и выходному файлам,
+ * разделённые пробелами. Строки, начинающиеся с #, пропускаются.
+ * При строке другого вида выбрасывает исключение runtime_error
+ */
+std::vector<Job> ReadManifest(std::istream &input);
+
+/*
+ * Выполняет задания на thread_count потоках (0 - по количеству аппаратных потоков).
+ * Ошибки отдельных заданий не прерывают остальные и сообщаются в результатах.
+ * Результаты возвращаются в порядке заданий. runner вызывается одновременно из нескольких потоков
+ */
+std::vector<JobResult> RunJobs(const std::vector<Job> &jobs, size_t thread_count, const ProgramRunner &runner);
+
+// Выводит по строке на задание и итоговую строку. Возвращает количество невыполненных заданий
+size_t PrintReport(std::ostream &output, const std::vector<Job> &jobs, const std::vector<JobResult> &results);
+
+} // namespace batch
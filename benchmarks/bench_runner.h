@@ -0,0 +1,228 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Не позволяет компилятору удалить вычисление value как неиспользуемое
+template <class T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// Параметры одного прогона замера: функция замера выполняет операцию GetIterations() раз
+class BenchmarkState {
+public:
+    explicit BenchmarkState(uint64_t iterations) : iterations_(iterations) {
+    }
+
+    [[nodiscard]] uint64_t GetIterations() const {
+        return iterations_;
+    }
+
+    // Объём данных и количество элементов, обработанных за одну итерацию
+    void SetBytesPerIteration(uint64_t bytes) {
+        bytes_per_iteration_ = bytes;
+    }
+
+    void SetItemsPerIteration(uint64_t items) {
+        items_per_iteration_ = items;
+    }
+
+    [[nodiscard]] uint64_t GetBytesPerIteration() const {
+        return bytes_per_iteration_;
+    }
+
+    [[nodiscard]] uint64_t GetItemsPerIteration() const {
+        return items_per_iteration_;
+    }
+
+private:
+    uint64_t iterations_;
+    uint64_t bytes_per_iteration_ = 0;
+    uint64_t items_per_iteration_ = 0;
+};
+
+/*
+ * Набор замеров производительности. Количество итераций каждого замера подбирается так,
+ * чтобы прогон длился не меньше min_time. Результаты выводятся таблицей либо в формате JSON,
+ * совместимом с выводом Google Benchmark (--benchmark_format=json), что позволяет сравнивать
+ * сборки теми же инструментами (например, compare.py)
+ */
+class BenchmarkRunner {
+public:
+    using Function = std::function<void(BenchmarkState&)>;
+
+    struct Result {
+        std::string name;
+        uint64_t iterations = 0;
+        double real_time_ns = 0;
+        double cpu_time_ns = 0;
+        double bytes_per_second = 0;
+        double items_per_second = 0;
+    };
+
+    void Add(std::string name, Function function) {
+        benchmarks_.push_back({std::move(name), std::move(function)});
+    }
+
+    /*
+     * Разбирает ключи командной строки и выполняет замеры:
+     *   --benchmark_filter=<подстрока>  выполнить только замеры, имя которых содержит подстроку
+     *   --benchmark_format=console|json
+     *   --benchmark_min_time=<секунды>
+     * Возвращает код возврата программы
+     */
+    int Run(int argc, const char** argv, std::ostream& output = std::cout) {
+        using namespace std::literals;
+        std::string_view filter;
+        bool json = false;
+        double min_time = 0.5;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg(argv[i]);
+            if (arg.substr(0, "--benchmark_filter="sv.size()) == "--benchmark_filter="sv) {
+                filter = arg.substr("--benchmark_filter="sv.size());
+            } else if (arg == "--benchmark_format=json"sv) {
+                json = true;
+            } else if (arg == "--benchmark_format=console"sv) {
+                json = false;
+            } else if (arg.substr(0, "--benchmark_min_time="sv.size()) == "--benchmark_min_time="sv) {
+                min_time = std::stod(std::string(arg.substr("--benchmark_min_time="sv.size())));
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return 1;
+            }
+        }
+
+        if (!json) {
+            output << std::left << std::setw(40) << "benchmark" << std::right << std::setw(17) << "time"
+                   << std::setw(17) << "cpu" << std::setw(12) << "iterations" << std::endl;
+        }
+        std::vector<Result> results;
+        for (const auto& [name, function] : benchmarks_) {
+            if (name.find(filter) != std::string::npos) {
+                results.push_back(Measure(name, function, min_time));
+                if (!json) {
+                    PrintConsole(output, results.back());
+                }
+            }
+        }
+        if (json) {
+            PrintJson(output, results, argc > 0 ? argv[0] : "");
+        }
+        return 0;
+    }
+
+private:
+    struct Benchmark {
+        std::string name;
+        Function function;
+    };
+
+    static Result Measure(const std::string& name, const Function& function, double min_time) {
+        using Seconds = std::chrono::duration<double>;
+        uint64_t iterations = 1;
+        while (true) {
+            BenchmarkState state(iterations);
+            const std::clock_t cpu_start = std::clock();
+            const auto start = std::chrono::steady_clock::now();
+            function(state);
+            const double real = Seconds(std::chrono::steady_clock::now() - start).count();
+            const double cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+            if (real >= min_time || iterations >= MAX_ITERATIONS) {
+                Result result;
+                result.name = name;
+                result.iterations = iterations;
+                result.real_time_ns = real * 1e9 / static_cast<double>(iterations);
+                result.cpu_time_ns = cpu * 1e9 / static_cast<double>(iterations);
+                const double total = static_cast<double>(iterations) / real;
+                result.bytes_per_second = static_cast<double>(state.GetBytesPerIteration()) * total;
+                result.items_per_second = static_cast<double>(state.GetItemsPerIteration()) * total;
+                return result;
+            }
+            // Как и Google Benchmark, оцениваем необходимое число итераций с запасом, но не более чем в 10 раз
+            const double estimate = real > 0 ? min_time * 1.4 / real : 10.0;
+            const double factor = estimate < 10.0 ? estimate : 10.0;
+            const auto next = static_cast<uint64_t>(static_cast<double>(iterations) * factor);
+            iterations = next > iterations ? next : iterations + 1;
+        }
+    }
+
+    static void PrintConsole(std::ostream& output, const Result& result) {
+        output << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+               << std::setw(14) << result.real_time_ns << " ns" << std::setw(14) << result.cpu_time_ns << " ns"
+               << std::setw(12) << result.iterations;
+        if (result.bytes_per_second > 0) {
+            output << "  " << std::setprecision(2) << result.bytes_per_second / (1 << 20) << " MB/s";
+        }
+        if (result.items_per_second > 0) {
+            output << "  " << std::setprecision(3) << result.items_per_second / 1e6 << " M items/s";
+        }
+        output << std::endl;
+    }
+
+    static void PrintJsonString(std::ostream& output, std::string_view str) {
+        output << '"';
+        for (const char c : str) {
+            if (c == '"' || c == '\\') {
+                output << '\\';
+            }
+            output << c;
+        }
+        output << '"';
+    }
+
+    static void PrintJson(std::ostream& output, const std::vector<Result>& results, std::string_view executable) {
+        const std::time_t now = std::time(nullptr);
+        char date[64];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+        output << "{\n  \"context\": {\n    \"date\": ";
+        PrintJsonString(output, date);
+        output << ",\n    \"executable\": ";
+        PrintJsonString(output, executable);
+        output << ",\n    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n    \"library_build_type\": "
+#ifdef NDEBUG
+               << "\"release\""
+#else
+               << "\"debug\""
+#endif
+               << "\n  },\n  \"benchmarks\": [";
+        output << std::setprecision(17);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& result = results[i];
+            output << (i == 0 ? "\n" : ",\n") << "    {\n      \"name\": ";
+            PrintJsonString(output, result.name);
+            output << ",\n      \"run_name\": ";
+            PrintJsonString(output, result.name);
+            output << ",\n      \"run_type\": \"iteration\",\n      \"iterations\": " << result.iterations
+                   << ",\n      \"real_time\": " << result.real_time_ns << ",\n      \"cpu_time\": " << result.cpu_time_ns
+                   << ",\n      \"time_unit\": \"ns\"";
+            if (result.bytes_per_second > 0) {
+                output << ",\n      \"bytes_per_second\": " << result.bytes_per_second;
+            }
+            if (result.items_per_second > 0) {
+                output << ",\n      \"items_per_second\": " << result.items_per_second;
+            }
+            output << "\n    }";
+        }
+        output << "\n  ]\n}\n";
+    }
+
+    static constexpr uint64_t MAX_ITERATIONS = 1'000'000'000;
+
+    std::vector<Benchmark> benchmarks_;
+};
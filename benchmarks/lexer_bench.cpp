@@ -0,0 +1,104 @@
+#include "../incremental_parse.h"
+#include "../lexer.h"
+#include "../parse.h"
+#include "../statement.h"
+#include "bench_runner.h"
+
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+
+// Исходный текст с высокой плотностью ключевых слов, типичный для сгенерированных сценариев.
+// Классы нумеруются, чтобы текст оставался корректной программой
+string MakeKeywordDenseSource(size_t min_size) {
+    const string_view head = "class Node"sv;
+    const string_view chunk = R"(:
+  def __init__(value, next):
+    self.value = value
+    self.next = next
+
+  def check(other):
+    if self.value == None or not other:
+      return False
+    else:
+      if self.value >= other.value and True:
+        print 'ok', self.value
+      return True
+
+)"sv;
+    string source;
+    source.reserve(min_size + head.size() + chunk.size() + 16);
+    for (size_t i = 0; source.size() < min_size; ++i) {
+        source += head;
+        source += to_string(i);
+        source += chunk;
+    }
+    return source;
+}
+
+const string& GetSource() {
+    static const string source = MakeKeywordDenseSource(1 << 20);
+    return source;
+}
+
+size_t CountTokens(string_view source) {
+    parse::Lexer lexer(source);
+    size_t count = 1;
+    while (!lexer.CurrentToken().Is<parse::token_type::Eof>()) {
+        lexer.NextToken();
+        ++count;
+    }
+    return count;
+}
+
+void BenchmarkLexer(BenchmarkState& state) {
+    const string& source = GetSource();
+    size_t tokens = 0;
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        tokens = CountTokens(source);
+        DoNotOptimize(tokens);
+    }
+    state.SetBytesPerIteration(source.size());
+    state.SetItemsPerIteration(tokens);
+}
+
+void BenchmarkParseProgram(BenchmarkState& state) {
+    const string& source = GetSource();
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        parse::Lexer lexer(source);
+        auto program = ParseProgram(lexer);
+        DoNotOptimize(program.get());
+    }
+    state.SetBytesPerIteration(source.size());
+}
+
+// Правка одной строки в середине текста: разбирается заново лишь изменённый класс
+void BenchmarkIncrementalReparse(BenchmarkState& state) {
+    const string& source = GetSource();
+    string edited = source;
+    const size_t pos = edited.find("print 'ok'"sv, edited.size() / 2);
+    edited.replace(pos, "print 'ok'"sv.size(), "print 'ko'"sv);
+
+    parse::IncrementalParser parser;
+    parser.Update(source);
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        const auto& stats = parser.Update(i % 2 == 0 ? edited : source);
+        DoNotOptimize(stats.parsed);
+    }
+    state.SetBytesPerIteration(source.size());
+}
+
+}  // namespace
+
+namespace parse {
+
+void RegisterLexerBenchmarks(BenchmarkRunner& runner) {
+    runner.Add("BM_Lexer", BenchmarkLexer);
+    runner.Add("BM_ParseProgram", BenchmarkParseProgram);
+    runner.Add("BM_IncrementalReparse", BenchmarkIncrementalReparse);
+}
+
+}  // namespace parse
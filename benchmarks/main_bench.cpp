@@ -0,0 +1,25 @@
+#include "bench_runner.h"
+
+namespace parse {
+void RegisterLexerBenchmarks(BenchmarkRunner& runner);
+}  // namespace parse
+
+namespace runtime {
+void RegisterRuntimeBenchmarks(BenchmarkRunner& runner);
+}  // namespace runtime
+
+namespace ast {
+void RegisterStatementBenchmarks(BenchmarkRunner& runner);
+}  // namespace ast
+
+/*
+ * Замеры производительности интерпретатора:
+ * mython_bench [--benchmark_filter=<подстрока>] [--benchmark_format=console|json] [--benchmark_min_time=<секунды>]
+ */
+int main(int argc, const char** argv) {
+    BenchmarkRunner runner;
+    parse::RegisterLexerBenchmarks(runner);
+    runtime::RegisterRuntimeBenchmarks(runner);
+    ast::RegisterStatementBenchmarks(runner);
+    return runner.Run(argc, argv);
+}
@@ -0,0 +1,124 @@
+#include "../interpreter.h"
+#include "../runtime.h"
+#include "bench_runner.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+// Классы с методами сравнения; экземпляры a и b создаются программой
+const string CLASSES_PROGRAM = R"(class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def sum(dx):
+    return self.x + self.y + dx
+
+  def __eq__(other):
+    return self.x == other.x
+
+  def __lt__(other):
+    return self.x < other.x
+
+a = Point(1, 2)
+b = Point(3, 4)
+)"s;
+
+// Программа и глобальные переменные, созданные ею, живут до конца замеров
+struct Fixture {
+    Fixture() : program(interpreter::Compile(CLASSES_PROGRAM)) {
+        interpreter::Run(program, context, globals);
+    }
+
+    interpreter::CompiledProgram program;
+    DummyContext context;
+    Closure globals;
+};
+
+Fixture& GetFixture() {
+    static Fixture fixture;
+    return fixture;
+}
+
+void BenchmarkMethodCall(BenchmarkState& state) {
+    Fixture& fixture = GetFixture();
+    auto& instance = *fixture.globals.at("a"s).TryAs<ClassInstance>();
+    const vector<ObjectHolder> args = {ObjectHolder::Own(Number(5))};
+    const Symbol method("sum"s);
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        DoNotOptimize(instance.Call(method, args, fixture.context));
+    }
+    state.SetItemsPerIteration(1);
+}
+
+void BenchmarkAddNumbers(BenchmarkState& state) {
+    DummyContext context;
+    const ObjectHolder lhs = ObjectHolder::Own(Number(17));
+    const ObjectHolder rhs = ObjectHolder::Own(Number(25));
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        DoNotOptimize(Add(lhs, rhs, context));
+    }
+    state.SetItemsPerIteration(1);
+}
+
+void BenchmarkAddStrings(BenchmarkState& state) {
+    DummyContext context;
+    const ObjectHolder lhs = ObjectHolder::Own(String("hello, "s));
+    const ObjectHolder rhs = ObjectHolder::Own(String("world"s));
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        DoNotOptimize(Add(lhs, rhs, context));
+    }
+    state.SetItemsPerIteration(1);
+}
+
+void BenchmarkMult(BenchmarkState& state) {
+    const ObjectHolder lhs = ObjectHolder::Own(Number(17));
+    const ObjectHolder rhs = ObjectHolder::Own(Number(25));
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        DoNotOptimize(Mult(lhs, rhs));
+    }
+    state.SetItemsPerIteration(1);
+}
+
+void BenchmarkCompare(BenchmarkState& state, const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        DoNotOptimize(Less(lhs, rhs, context));
+        DoNotOptimize(Equal(lhs, rhs, context));
+    }
+    state.SetItemsPerIteration(2);
+}
+
+void BenchmarkCompareNumbers(BenchmarkState& state) {
+    DummyContext context;
+    BenchmarkCompare(state, ObjectHolder::Own(Number(17)), ObjectHolder::Own(Number(25)), context);
+}
+
+void BenchmarkCompareStrings(BenchmarkState& state) {
+    DummyContext context;
+    BenchmarkCompare(state, ObjectHolder::Own(String("abcdef"s)), ObjectHolder::Own(String("abcdeg"s)), context);
+}
+
+void BenchmarkCompareInstances(BenchmarkState& state) {
+    Fixture& fixture = GetFixture();
+    BenchmarkCompare(state, fixture.globals.at("a"s), fixture.globals.at("b"s), fixture.context);
+}
+
+}  // namespace
+
+void RegisterRuntimeBenchmarks(BenchmarkRunner& runner) {
+    runner.Add("BM_ClassInstanceCall", BenchmarkMethodCall);
+    runner.Add("BM_AddNumbers", BenchmarkAddNumbers);
+    runner.Add("BM_AddStrings", BenchmarkAddStrings);
+    runner.Add("BM_MultNumbers", BenchmarkMult);
+    runner.Add("BM_CompareNumbers", BenchmarkCompareNumbers);
+    runner.Add("BM_CompareStrings", BenchmarkCompareStrings);
+    runner.Add("BM_CompareInstances", BenchmarkCompareInstances);
+}
+
+}  // namespace runtime
@@ -0,0 +1,186 @@
+#include "../arena.h"
+#include "../interpreter.h"
+#include "../runtime.h"
+#include "../statement.h"
+#include "bench_runner.h"
+
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+const string FIELDS_PROGRAM = R"(class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+p = Point(1, 2)
+n = 17
+s = 'value'
+)"s;
+
+struct Fixture {
+    Fixture() : program(interpreter::Compile(FIELDS_PROGRAM)) {
+        interpreter::Run(program, context, globals);
+    }
+
+    interpreter::CompiledProgram program;
+    runtime::DummyContext context;
+    runtime::Closure globals;
+};
+
+Fixture& GetFixture() {
+    static Fixture fixture;
+    return fixture;
+}
+
+// Поток, отбрасывающий записанные данные: замер Print не зависит от устройства вывода
+class NullBuffer : public streambuf {
+protected:
+    int_type overflow(int_type c) override {
+        return traits_type::not_eof(c);
+    }
+
+    streamsize xsputn(const char* /*s*/, streamsize count) override {
+        return count;
+    }
+};
+
+void ExecuteRepeatedly(BenchmarkState& state, Statement& node, runtime::Closure& closure, runtime::Context& context) {
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        DoNotOptimize(node.Execute(closure, context));
+    }
+    state.SetItemsPerIteration(1);
+}
+
+void BenchmarkFieldRead(BenchmarkState& state) {
+    Fixture& fixture = GetFixture();
+    VariableValue node(vector{"p"s, "x"s});
+    ExecuteRepeatedly(state, node, fixture.globals, fixture.context);
+}
+
+void BenchmarkFieldAssignment(BenchmarkState& state) {
+    Fixture& fixture = GetFixture();
+    FieldAssignment node(VariableValue("p"s), "y"s, make_unique<NumericConst>(runtime::Number(5)));
+    ExecuteRepeatedly(state, node, fixture.globals, fixture.context);
+}
+
+void BenchmarkAddNode(BenchmarkState& state) {
+    Fixture& fixture = GetFixture();
+    Add node(make_unique<VariableValue>("n"s), make_unique<NumericConst>(runtime::Number(25)));
+    ExecuteRepeatedly(state, node, fixture.globals, fixture.context);
+}
+
+void BenchmarkMultNode(BenchmarkState& state) {
+    Fixture& fixture = GetFixture();
+    Mult node(make_unique<VariableValue>("n"s), make_unique<NumericConst>(runtime::Number(25)));
+    ExecuteRepeatedly(state, node, fixture.globals, fixture.context);
+}
+
+// print n, s, p.x: числа и строки через буфер вывода контекста
+void BenchmarkPrint(BenchmarkState& state) {
+    Fixture& fixture = GetFixture();
+    NullBuffer null_buffer;
+    ostream output(&null_buffer);
+    runtime::SimpleContext context(output);
+
+    vector<unique_ptr<Statement>> args;
+    args.push_back(make_unique<VariableValue>("n"s));
+    args.push_back(make_unique<VariableValue>("s"s));
+    args.push_back(make_unique<VariableValue>(vector{"p"s, "x"s}));
+    Print node(std::move(args));
+    ExecuteRepeatedly(state, node, fixture.globals, context);
+    // Каждое исполнение выводит строку "17 value 1\n"
+    state.SetBytesPerIteration(11);
+}
+
+// Дерево из TREE_SIZE инструкций x = x + 1 в одном Compound
+constexpr int TREE_SIZE = 1000;
+
+unique_ptr<Compound> BuildTree() {
+    auto tree = make_unique<Compound>();
+    for (int i = 0; i < TREE_SIZE; ++i) {
+        tree->AddStatement(make_unique<Assignment>(
+            "x"s, make_unique<Add>(make_unique<VariableValue>("x"s), make_unique<NumericConst>(runtime::Number(1)))));
+    }
+    return tree;
+}
+
+// Построение и удаление дерева: узлы в арене (как после ParseProgram) либо по отдельности в куче.
+// Узел арены несёт заголовок со ссылкой на арену, а его удаление атомарно уменьшает счётчик ссылок
+void BuildAndFreeTree(BenchmarkState& state, bool use_arena) {
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        unique_ptr<Compound> tree;
+        if (use_arena) {
+            ArenaScope arena;
+            tree = BuildTree();
+        } else {
+            tree = BuildTree();
+        }
+        DoNotOptimize(tree.get());
+    }
+    state.SetItemsPerIteration(TREE_SIZE * 4);
+}
+
+void BenchmarkBuildAndFreeTreeArena(BenchmarkState& state) {
+    BuildAndFreeTree(state, true);
+}
+
+void BenchmarkBuildAndFreeTreeHeap(BenchmarkState& state) {
+    BuildAndFreeTree(state, false);
+}
+
+// Обход дерева, узлы которого размещены в арене либо в куче вперемешку с другими объектами
+void ExecuteTree(BenchmarkState& state, bool use_arena) {
+    unique_ptr<Compound> tree;
+    vector<unique_ptr<string>> noise;
+    if (use_arena) {
+        ArenaScope arena;
+        tree = BuildTree();
+    } else {
+        tree = make_unique<Compound>();
+        for (int i = 0; i < TREE_SIZE; ++i) {
+            noise.push_back(make_unique<string>(64, 'n'));
+            tree->AddStatement(make_unique<Assignment>(
+                "x"s, make_unique<Add>(make_unique<VariableValue>("x"s), make_unique<NumericConst>(runtime::Number(1)))));
+        }
+    }
+    runtime::DummyContext context;
+    runtime::Closure closure = {{"x"s, runtime::ObjectHolder::Own(runtime::Number(0))}};
+    for (uint64_t i = 0; i < state.GetIterations(); ++i) {
+        closure["x"s] = runtime::ObjectHolder::Own(runtime::Number(0));
+        DoNotOptimize(tree->Execute(closure, context));
+    }
+    state.SetItemsPerIteration(TREE_SIZE);
+}
+
+void BenchmarkExecuteTreeArena(BenchmarkState& state) {
+    ExecuteTree(state, true);
+}
+
+void BenchmarkExecuteTreeHeap(BenchmarkState& state) {
+    ExecuteTree(state, false);
+}
+
+}  // namespace
+
+void RegisterStatementBenchmarks(BenchmarkRunner& runner) {
+    runner.Add("BM_FieldRead", BenchmarkFieldRead);
+    runner.Add("BM_FieldAssignment", BenchmarkFieldAssignment);
+    runner.Add("BM_AddNode", BenchmarkAddNode);
+    runner.Add("BM_MultNode", BenchmarkMultNode);
+    runner.Add("BM_Print", BenchmarkPrint);
+    runner.Add("BM_BuildAndFreeTree/arena", BenchmarkBuildAndFreeTreeArena);
+    runner.Add("BM_BuildAndFreeTree/heap", BenchmarkBuildAndFreeTreeHeap);
+    runner.Add("BM_ExecuteTree/arena", BenchmarkExecuteTreeArena);
+    runner.Add("BM_ExecuteTree/heap", BenchmarkExecuteTreeHeap);
+}
+
+}  // namespace ast
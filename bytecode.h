@@ -0,0 +1,116 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vm
+{
+
+using Register = uint32_t;
+
+constexpr Register NO_REGISTER = std::numeric_limits<Register>::max();
+
+/*
+ * Набор инструкций регистровой машины. Операнды a, b, c, d - номера регистров текущего кадра,
+ * индексы в таблицах функции либо адреса переходов (в зависимости от инструкции).
+ */
+enum class OpCode : uint8_t
+{
+    LoadConst,         // a = constants[b]
+    LoadNone,          // a = None
+    LoadBool,          // a = Bool(b != 0)
+    Move,              // a = b
+    CheckDefined,      // если регистр a не инициализирован, ошибка обращения к переменной names[b]
+    GetField,          // a = b.names[c]
+    SetField,          // a.names[b] = c
+    Add,               // a = b + c
+    Sub,               // a = b - c
+    Mult,              // a = b * c
+    Div,               // a = b / c
+    Compare,           // a = CompareOp(d)(b, c)
+    CompareCustom,     // a = custom_comparators[d](b, c)
+    Not,               // a = not b
+    Stringify,         // a = str(b)
+    Jump,              // переход на инструкцию b
+    JumpIfFalse,       // если a ложно, переход на инструкцию b
+    JumpIfTrue,        // если a истинно, переход на инструкцию b
+    JumpIfNotInstance, // если a не экземпляр класса, переход на инструкцию b
+    Print,             // вывести a
+    PrintSpace,        // вывести разделитель аргументов print
+    PrintNewline,      // вывести перевод строки
+    CallMethod,        // a = b.method(...), параметры вызова - call_sites[c]
+    NewInstance,       // a = classes[b]() без вызова __init__
+    Construct,         // a = classes[b](c, c + 1, ..., c + d - 1) с вызовом __init__
+    Return,            // вернуть значение регистра a
+    ReturnNone,        // вернуть None
+};
+
+enum class CompareOp : uint8_t
+{
+    Equal,
+    NotEqual,
+    Less,
+    Greater,
+    LessOrEqual,
+    GreaterOrEqual,
+};
+
+struct Instruction
+{
+    OpCode op;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    uint32_t c = 0;
+    uint32_t d = 0;
+};
+
+// Место вызова метода: имя метода и расположение фактических параметров в регистрах
+struct CallSite
+{
+    runtime::Symbol method;
+    Register first_arg = 0;
+    uint32_t arg_count = 0;
+};
+
+using Comparator =
+    std::function<bool(const runtime::ObjectHolder &, const runtime::ObjectHolder &, runtime::Context &)>;
+
+/*
+ * Скомпилированная функция: тело метода либо код верхнего уровня программы.
+ * Регистры [0, local_count) соответствуют именованным переменным (local_names),
+ * первые param_count из них инициализируются при вызове (self и формальные параметры).
+ * Остальные регистры - временные значения.
+ */
+struct Function
+{
+    std::string name;
+    std::vector<Instruction> code;
+    std::vector<runtime::ObjectHolder> constants;
+    std::vector<runtime::Symbol> names;
+    std::vector<CallSite> call_sites;
+    std::vector<Comparator> custom_comparators;
+    std::vector<std::string> local_names;
+    uint32_t param_count = 0;
+    uint32_t local_count = 0;
+    uint32_t register_count = 0;
+};
+
+/*
+ * Результат компиляции программы. Ссылается на классы исходного дерева,
+ * поэтому дерево должно жить дольше скомпилированной программы.
+ */
+struct Program
+{
+    Function main;
+    std::vector<Function> methods;
+    std::unordered_map<const runtime::Method *, size_t> method_index;
+    std::vector<const runtime::Class *> classes;
+};
+
+} // namespace vm
@@ -0,0 +1,615 @@
+#include "compiler.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <deque>
+#include <optional>
+
+using namespace std;
+
+namespace vm
+{
+
+namespace
+{
+const runtime::Symbol INIT_METHOD = "__init__";
+const string SELF_NAME = "self"s;
+
+class ProgramCompiler;
+
+// Компилирует тело одной функции. Именованные переменные получают фиксированные регистры,
+// временные значения размещаются над ними по стековой дисциплине
+class FunctionCompiler
+{
+public:
+    FunctionCompiler(ProgramCompiler &program, Function &function) : program_(program), function_(function) {}
+
+    void CompileMethod(const runtime::Method &method)
+    {
+        function_.name = method.name;
+        AddLocal(SELF_NAME);
+        for (const auto &param : method.formal_params)
+        {
+            AddLocal(param);
+        }
+        function_.param_count = static_cast<uint32_t>(locals_.size());
+        CollectNames(*method.body);
+        FinishLocals();
+
+        if (auto body = dynamic_cast<const ast::MethodBody *>(method.body.get()))
+        {
+            CompileStatement(body->GetBody());
+            Emit(OpCode::ReturnNone);
+        }
+        else
+        {
+            // Тело без MethodBody возвращает значение выражения, как и при обходе дерева
+            Register result = AllocTemp();
+            CompileInto(*method.body, result);
+            Emit(OpCode::Return, result);
+        }
+        Finish();
+    }
+
+    void CompileMain(const runtime::Executable &program)
+    {
+        function_.name = "<main>"s;
+        CollectNames(program);
+        FinishLocals();
+        CompileStatement(program);
+        Emit(OpCode::ReturnNone);
+        Finish();
+    }
+
+private:
+    void AddLocal(const string &name)
+    {
+        if (locals_.count(name) == 0)
+        {
+            locals_[name] = static_cast<Register>(function_.local_names.size());
+            function_.local_names.push_back(name);
+        }
+    }
+
+    void FinishLocals()
+    {
+        function_.local_count = static_cast<uint32_t>(function_.local_names.size());
+        next_temp_ = function_.local_count;
+        max_register_ = next_temp_;
+    }
+
+    void Finish()
+    {
+        function_.register_count = max_register_;
+    }
+
+    // Собирает имена всех переменных, которые читаются или присваиваются в теле функции
+    void CollectNames(const runtime::Executable &node)
+    {
+        if (auto var = dynamic_cast<const ast::VariableValue *>(&node))
+        {
+            AddLocal(var->GetName());
+        }
+        else if (auto assign = dynamic_cast<const ast::Assignment *>(&node))
+        {
+            AddLocal(assign->GetVarName());
+            CollectNames(assign->GetRightValue());
+        }
+        else if (auto field_assign = dynamic_cast<const ast::FieldAssignment *>(&node))
+        {
+            CollectNames(field_assign->GetObject());
+            CollectNames(field_assign->GetRightValue());
+        }
+        else if (auto print = dynamic_cast<const ast::Print *>(&node))
+        {
+            CollectAll(print->GetArgs());
+        }
+        else if (auto call = dynamic_cast<const ast::MethodCall *>(&node))
+        {
+            CollectNames(call->GetObject());
+            CollectAll(call->GetArgs());
+        }
+        else if (auto new_instance = dynamic_cast<const ast::NewInstance *>(&node))
+        {
+            CollectAll(new_instance->GetArgs());
+        }
+        else if (auto unary = dynamic_cast<const ast::UnaryOperation *>(&node))
+        {
+            CollectNames(unary->GetArgument());
+        }
+        else if (auto binary = dynamic_cast<const ast::BinaryOperation *>(&node))
+        {
+            CollectNames(binary->GetLhs());
+            CollectNames(binary->GetRhs());
+        }
+        else if (auto compound = dynamic_cast<const ast::Compound *>(&node))
+        {
+            CollectAll(compound->GetStatements());
+        }
+        else if (auto body = dynamic_cast<const ast::MethodBody *>(&node))
+        {
+            CollectNames(body->GetBody());
+        }
+        else if (auto ret = dynamic_cast<const ast::Return *>(&node))
+        {
+            CollectNames(ret->GetStatement());
+        }
+        else if (auto if_else = dynamic_cast<const ast::IfElse *>(&node))
+        {
+            CollectNames(if_else->GetCondition());
+            CollectNames(if_else->GetIfBody());
+            if (if_else->GetElseBody() != nullptr)
+            {
+                CollectNames(*if_else->GetElseBody());
+            }
+        }
+        else if (auto class_def = dynamic_cast<const ast::ClassDefinition *>(&node))
+        {
+            AddLocal(class_def->GetClass().TryAs<runtime::Class>()->GetName());
+        }
+    }
+
+    void CollectAll(const vector<unique_ptr<ast::Statement>> &nodes)
+    {
+        for (const auto &node : nodes)
+        {
+            CollectNames(*node);
+        }
+    }
+
+    size_t Emit(OpCode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0)
+    {
+        function_.code.push_back(Instruction{op, a, b, c, d});
+        return function_.code.size() - 1;
+    }
+
+    // Устанавливает адрес перехода инструкции jump на следующую инструкцию
+    void PatchJump(size_t jump)
+    {
+        function_.code[jump].b = static_cast<uint32_t>(function_.code.size());
+    }
+
+    Register AllocTemp()
+    {
+        Register result = next_temp_++;
+        max_register_ = std::max(max_register_, next_temp_);
+        return result;
+    }
+
+    uint32_t AddConstant(runtime::ObjectHolder value)
+    {
+        // Константы копируются в регистры запусков программы, исполняемых в разных потоках
+        value.ShareBetweenThreads();
+        function_.constants.push_back(std::move(value));
+        return static_cast<uint32_t>(function_.constants.size() - 1);
+    }
+
+    uint32_t AddName(runtime::Symbol name)
+    {
+        auto [iter, inserted] = name_index_.emplace(name, static_cast<uint32_t>(function_.names.size()));
+        if (inserted)
+        {
+            function_.names.push_back(name);
+        }
+        return iter->second;
+    }
+
+    // Возвращает регистр переменной name, проверяя перед чтением, что она инициализирована
+    Register ReadLocal(const string &name)
+    {
+        Register reg = locals_.at(name);
+        if (reg >= function_.param_count)
+        {
+            Emit(OpCode::CheckDefined, reg, AddName(name));
+        }
+        return reg;
+    }
+
+    // Возвращает регистр со значением выражения. Для простых переменных новый регистр не выделяется
+    Register CompileOperand(const runtime::Executable &node)
+    {
+        if (auto var = dynamic_cast<const ast::VariableValue *>(&node); var != nullptr && var->GetDottedIds().empty())
+        {
+            return ReadLocal(var->GetName());
+        }
+        Register result = AllocTemp();
+        CompileInto(node, result);
+        return result;
+    }
+
+    // Вычисляет аргументы в последовательно расположенных регистрах и возвращает первый из них
+    Register CompileArgs(const vector<unique_ptr<ast::Statement>> &args)
+    {
+        Register first = next_temp_;
+        for (const auto &arg : args)
+        {
+            Register reg = AllocTemp();
+            Register mark = next_temp_;
+            CompileInto(*arg, reg);
+            next_temp_ = mark;
+        }
+        return first;
+    }
+
+    void CompileBinary(OpCode op, const ast::BinaryOperation &node, Register dst, uint32_t d = 0)
+    {
+        Register mark = next_temp_;
+        Register lhs = CompileOperand(node.GetLhs());
+        Register rhs = CompileOperand(node.GetRhs());
+        Emit(op, dst, lhs, rhs, d);
+        next_temp_ = mark;
+    }
+
+    void CompileComparison(const ast::Comparison &node, Register dst)
+    {
+        const optional<ast::ComparisonOp> op = node.GetOp();
+        if (!op)
+        {
+            function_.custom_comparators.push_back(node.GetComparator());
+            CompileBinary(OpCode::CompareCustom, node, dst,
+                          static_cast<uint32_t>(function_.custom_comparators.size() - 1));
+            return;
+        }
+        CompareOp compare = CompareOp::Equal;
+        switch (*op)
+        {
+        case ast::ComparisonOp::Equal:
+            compare = CompareOp::Equal;
+            break;
+        case ast::ComparisonOp::NotEqual:
+            compare = CompareOp::NotEqual;
+            break;
+        case ast::ComparisonOp::Less:
+            compare = CompareOp::Less;
+            break;
+        case ast::ComparisonOp::Greater:
+            compare = CompareOp::Greater;
+            break;
+        case ast::ComparisonOp::LessOrEqual:
+            compare = CompareOp::LessOrEqual;
+            break;
+        case ast::ComparisonOp::GreaterOrEqual:
+            compare = CompareOp::GreaterOrEqual;
+            break;
+        }
+        CompileBinary(OpCode::Compare, node, dst, static_cast<uint32_t>(compare));
+    }
+
+    void CompileVariable(const ast::VariableValue &var, Register dst)
+    {
+        Register reg = ReadLocal(var.GetName());
+        const auto &dotted_ids = var.GetDottedIds();
+        if (dotted_ids.empty())
+        {
+            Emit(OpCode::Move, dst, reg);
+            return;
+        }
+        for (const auto &field : dotted_ids)
+        {
+            Emit(OpCode::GetField, dst, reg, AddName(field));
+            reg = dst;
+        }
+    }
+
+    void CompileMethodCall(const ast::MethodCall &call, Register dst)
+    {
+        Register mark = next_temp_;
+        Register object = CompileOperand(call.GetObject());
+        size_t not_instance = Emit(OpCode::JumpIfNotInstance, object);
+
+        const auto &args = call.GetArgs();
+        Register first_arg = CompileArgs(args);
+        function_.call_sites.push_back(CallSite{call.GetMethodName(), first_arg, static_cast<uint32_t>(args.size())});
+        Emit(OpCode::CallMethod, dst, object, static_cast<uint32_t>(function_.call_sites.size() - 1));
+        size_t end = Emit(OpCode::Jump);
+
+        // Вызов метода не у экземпляра класса возвращает None
+        PatchJump(not_instance);
+        Emit(OpCode::LoadNone, dst);
+        PatchJump(end);
+        next_temp_ = mark;
+    }
+
+    // Добавляет класс в таблицу классов программы и ставит его методы в очередь на компиляцию
+    uint32_t RegisterClass(const runtime::Class &cls);
+
+    void CompileNewInstance(const ast::NewInstance &node, Register dst);
+
+    void CompileLogical(const ast::BinaryOperation &node, Register dst, bool is_or)
+    {
+        const OpCode short_circuit = is_or ? OpCode::JumpIfTrue : OpCode::JumpIfFalse;
+        Register mark = next_temp_;
+
+        size_t lhs_jump = Emit(short_circuit, CompileOperand(node.GetLhs()));
+        size_t rhs_jump = Emit(short_circuit, CompileOperand(node.GetRhs()));
+        next_temp_ = mark;
+
+        Emit(OpCode::LoadBool, dst, is_or ? 0 : 1);
+        size_t end = Emit(OpCode::Jump);
+        PatchJump(lhs_jump);
+        PatchJump(rhs_jump);
+        Emit(OpCode::LoadBool, dst, is_or ? 1 : 0);
+        PatchJump(end);
+    }
+
+    // Вычисляет значение узла в регистр dst
+    void CompileInto(const runtime::Executable &node, Register dst)
+    {
+        if (auto num = dynamic_cast<const ast::NumericConst *>(&node))
+        {
+            Emit(OpCode::LoadConst, dst, AddConstant(runtime::ObjectHolder::Own(runtime::Number(num->GetValue()))));
+        }
+        else if (auto str = dynamic_cast<const ast::StringConst *>(&node))
+        {
+            Emit(OpCode::LoadConst, dst, AddConstant(runtime::ObjectHolder::Own(runtime::String(str->GetValue()))));
+        }
+        else if (auto boolean = dynamic_cast<const ast::BoolConst *>(&node))
+        {
+            Emit(OpCode::LoadBool, dst, boolean->GetValue().GetValue() ? 1 : 0);
+        }
+        else if (dynamic_cast<const ast::None *>(&node) != nullptr)
+        {
+            Emit(OpCode::LoadNone, dst);
+        }
+        else if (auto var = dynamic_cast<const ast::VariableValue *>(&node))
+        {
+            CompileVariable(*var, dst);
+        }
+        else if (auto call = dynamic_cast<const ast::MethodCall *>(&node))
+        {
+            CompileMethodCall(*call, dst);
+        }
+        else if (auto new_instance = dynamic_cast<const ast::NewInstance *>(&node))
+        {
+            CompileNewInstance(*new_instance, dst);
+        }
+        else if (auto stringify = dynamic_cast<const ast::Stringify *>(&node))
+        {
+            Register mark = next_temp_;
+            Emit(OpCode::Stringify, dst, CompileOperand(stringify->GetArgument()));
+            next_temp_ = mark;
+        }
+        else if (auto not_op = dynamic_cast<const ast::Not *>(&node))
+        {
+            Register mark = next_temp_;
+            Emit(OpCode::Not, dst, CompileOperand(not_op->GetArgument()));
+            next_temp_ = mark;
+        }
+        else if (auto add = dynamic_cast<const ast::Add *>(&node))
+        {
+            CompileBinary(OpCode::Add, *add, dst);
+        }
+        else if (auto sub = dynamic_cast<const ast::Sub *>(&node))
+        {
+            CompileBinary(OpCode::Sub, *sub, dst);
+        }
+        else if (auto mult = dynamic_cast<const ast::Mult *>(&node))
+        {
+            CompileBinary(OpCode::Mult, *mult, dst);
+        }
+        else if (auto div = dynamic_cast<const ast::Div *>(&node))
+        {
+            CompileBinary(OpCode::Div, *div, dst);
+        }
+        else if (auto or_op = dynamic_cast<const ast::Or *>(&node))
+        {
+            CompileLogical(*or_op, dst, true);
+        }
+        else if (auto and_op = dynamic_cast<const ast::And *>(&node))
+        {
+            CompileLogical(*and_op, dst, false);
+        }
+        else if (auto comparison = dynamic_cast<const ast::Comparison *>(&node))
+        {
+            CompileComparison(*comparison, dst);
+        }
+        else if (auto assign = dynamic_cast<const ast::Assignment *>(&node))
+        {
+            Register var = locals_.at(assign->GetVarName());
+            CompileInto(assign->GetRightValue(), var);
+            Emit(OpCode::Move, dst, var);
+        }
+        else if (auto field_assign = dynamic_cast<const ast::FieldAssignment *>(&node))
+        {
+            Register mark = next_temp_;
+            Register object = CompileOperand(field_assign->GetObject());
+            CompileInto(field_assign->GetRightValue(), dst);
+            Emit(OpCode::SetField, object, AddName(field_assign->GetFieldName()), dst);
+            next_temp_ = mark;
+        }
+        else
+        {
+            // Инструкции, не имеющие значения, возвращают None
+            CompileStatement(node);
+            Emit(OpCode::LoadNone, dst);
+        }
+    }
+
+    void CompileStatement(const runtime::Executable &node)
+    {
+        Register mark = next_temp_;
+        if (auto compound = dynamic_cast<const ast::Compound *>(&node))
+        {
+            for (const auto &statement : compound->GetStatements())
+            {
+                CompileStatement(*statement);
+            }
+        }
+        else if (auto ret = dynamic_cast<const ast::Return *>(&node))
+        {
+            Emit(OpCode::Return, CompileOperand(ret->GetStatement()));
+        }
+        else if (auto if_else = dynamic_cast<const ast::IfElse *>(&node))
+        {
+            size_t to_else = Emit(OpCode::JumpIfFalse, CompileOperand(if_else->GetCondition()));
+            next_temp_ = mark;
+            CompileStatement(if_else->GetIfBody());
+            if (if_else->GetElseBody() != nullptr)
+            {
+                size_t to_end = Emit(OpCode::Jump);
+                PatchJump(to_else);
+                CompileStatement(*if_else->GetElseBody());
+                PatchJump(to_end);
+            }
+            else
+            {
+                PatchJump(to_else);
+            }
+        }
+        else if (auto assign = dynamic_cast<const ast::Assignment *>(&node))
+        {
+            CompileInto(assign->GetRightValue(), locals_.at(assign->GetVarName()));
+        }
+        else if (auto class_def = dynamic_cast<const ast::ClassDefinition *>(&node))
+        {
+            const runtime::ObjectHolder &cls = class_def->GetClass();
+            RegisterClass(*cls.TryAs<runtime::Class>());
+            Emit(OpCode::LoadConst, locals_.at(cls.TryAs<runtime::Class>()->GetName()), AddConstant(cls));
+        }
+        else if (auto print = dynamic_cast<const ast::Print *>(&node))
+        {
+            bool is_first = true;
+            for (const auto &arg : print->GetArgs())
+            {
+                // Разделитель выводится до вычисления аргумента, как и при обходе дерева
+                if (!is_first)
+                {
+                    Emit(OpCode::PrintSpace);
+                }
+                Register arg_mark = next_temp_;
+                Emit(OpCode::Print, CompileOperand(*arg));
+                next_temp_ = arg_mark;
+                is_first = false;
+            }
+            Emit(OpCode::PrintNewline);
+        }
+        else if (IsKnownExpression(node))
+        {
+            CompileInto(node, AllocTemp());
+        }
+        else
+        {
+            throw CompileError("Unsupported node in vm::Compile"s);
+        }
+        next_temp_ = mark;
+    }
+
+    static bool IsKnownExpression(const runtime::Executable &node)
+    {
+        return dynamic_cast<const ast::NumericConst *>(&node) != nullptr ||
+               dynamic_cast<const ast::StringConst *>(&node) != nullptr ||
+               dynamic_cast<const ast::BoolConst *>(&node) != nullptr ||
+               dynamic_cast<const ast::None *>(&node) != nullptr ||
+               dynamic_cast<const ast::VariableValue *>(&node) != nullptr ||
+               dynamic_cast<const ast::FieldAssignment *>(&node) != nullptr ||
+               dynamic_cast<const ast::MethodCall *>(&node) != nullptr ||
+               dynamic_cast<const ast::NewInstance *>(&node) != nullptr ||
+               dynamic_cast<const ast::UnaryOperation *>(&node) != nullptr ||
+               dynamic_cast<const ast::BinaryOperation *>(&node) != nullptr;
+    }
+
+    ProgramCompiler &program_;
+    Function &function_;
+    unordered_map<string, Register> locals_;
+    unordered_map<runtime::Symbol, uint32_t> name_index_;
+    Register next_temp_ = 0;
+    Register max_register_ = 0;
+};
+
+class ProgramCompiler
+{
+public:
+    Program Compile(const runtime::Executable &root)
+    {
+        FunctionCompiler(*this, program_.main).CompileMain(root);
+
+        // Методы классов компилируются по мере обнаружения классов
+        while (!pending_.empty())
+        {
+            const runtime::Class *cls = pending_.front();
+            pending_.pop_front();
+            for (const auto &method : cls->GetMethods())
+            {
+                CompileMethod(method);
+            }
+        }
+        return std::move(program_);
+    }
+
+    uint32_t AddClass(const runtime::Class &cls)
+    {
+        auto [iter, inserted] = class_index_.emplace(&cls, static_cast<uint32_t>(program_.classes.size()));
+        if (inserted)
+        {
+            program_.classes.push_back(&cls);
+            pending_.push_back(&cls);
+            if (cls.GetParent() != nullptr)
+            {
+                AddClass(*cls.GetParent());
+            }
+        }
+        return iter->second;
+    }
+
+private:
+    void CompileMethod(const runtime::Method &method)
+    {
+        if (method.body == nullptr)
+        {
+            // Встроенный метод вызывается через ClassInstance::Call
+            return;
+        }
+        Function function;
+        try
+        {
+            FunctionCompiler(*this, function).CompileMethod(method);
+        }
+        catch (const CompileError &)
+        {
+            // Метод останется некомпилированным и будет вызываться через ClassInstance::Call
+            return;
+        }
+        program_.method_index[&method] = program_.methods.size();
+        program_.methods.push_back(std::move(function));
+    }
+
+    Program program_;
+    unordered_map<const runtime::Class *, uint32_t> class_index_;
+    deque<const runtime::Class *> pending_;
+};
+
+uint32_t FunctionCompiler::RegisterClass(const runtime::Class &cls)
+{
+    return program_.AddClass(cls);
+}
+
+void FunctionCompiler::CompileNewInstance(const ast::NewInstance &node, Register dst)
+{
+    const runtime::Class &cls = node.GetClass();
+    const auto &args = node.GetArgs();
+    uint32_t class_index = RegisterClass(cls);
+
+    // Классы неизменяемы, поэтому наличие подходящего конструктора известно на этапе компиляции
+    const runtime::Method *init = cls.GetMethod(INIT_METHOD);
+    if (init != nullptr && init->formal_params.size() == args.size())
+    {
+        Register mark = next_temp_;
+        Register first_arg = CompileArgs(args);
+        Emit(OpCode::Construct, dst, class_index, first_arg, static_cast<uint32_t>(args.size()));
+        next_temp_ = mark;
+    }
+    else
+    {
+        Emit(OpCode::NewInstance, dst, class_index);
+    }
+}
+
+} // namespace
+
+Program Compile(const runtime::Executable &program)
+{
+    return ProgramCompiler{}.Compile(program);
+}
+
+} // namespace vm
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "bytecode.h"
+
+#include <stdexcept>
+
+namespace vm
+{
+
+class CompileError : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/*
+ * Транслирует дерево, полученное из ParseProgram, в байткод.
+ * Вместе с кодом верхнего уровня компилируются методы всех классов, которые в нём встречаются.
+ * Методы с телом, не являющимся узлом ast, остаются некомпилированными и вызываются
+ * через ClassInstance::Call. Если код верхнего уровня содержит такой узел, выбрасывается CompileError
+ */
+Program Compile(const runtime::Executable &program);
+
+} // namespace vm
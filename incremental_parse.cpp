@@ -0,0 +1,337 @@
+#include "incremental_parse.h"
+
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+namespace parse
+{
+
+namespace
+{
+// Часть текста: инструкция верхнего уровня вместе с относящимися к ней строками
+struct Piece
+{
+    string_view text;
+    uint32_t first_line;
+};
+
+// Первый блок арены частей, разобранных одним вызовом Update: правка обычно затрагивает несколько
+// небольших частей, а арена освобождается лишь вместе с последним из её узлов
+constexpr size_t FIRST_ARENA_BLOCK_SIZE = 4 * 1024;
+
+// Строка начинает инструкцию верхнего уровня: не имеет отступа, не пуста,
+// не является комментарием и не продолжает инструкцию if веткой else
+bool StartsStatement(string_view line)
+{
+    if (line.empty() || line[0] == ' ' || line[0] == '\t' || line[0] == '\r' || line[0] == '\n' || line[0] == '#')
+    {
+        return false;
+    }
+    constexpr string_view ELSE = "else"sv;
+    if (line.substr(0, ELSE.size()) == ELSE)
+    {
+        return !(line.size() == ELSE.size() || line[ELSE.size()] == ':' || line[ELSE.size()] == ' ' ||
+                 line[ELSE.size()] == '\t' || line[ELSE.size()] == '\r' || line[ELSE.size()] == '\n');
+    }
+    return true;
+}
+
+vector<Piece> SplitTopLevel(string_view source)
+{
+    vector<Piece> pieces;
+    size_t piece_start = 0;
+    uint32_t piece_line = 1;
+    uint32_t line = 1;
+    for (size_t pos = 0; pos < source.size(); ++line)
+    {
+        size_t end = source.find('\n', pos);
+        end = end == string_view::npos ? source.size() : end + 1;
+        if (pos != piece_start && StartsStatement(source.substr(pos, end - pos)))
+        {
+            pieces.push_back({source.substr(piece_start, pos - piece_start), piece_line});
+            piece_start = pos;
+            piece_line = line;
+        }
+        pos = end;
+    }
+    if (piece_start < source.size())
+    {
+        pieces.push_back({source.substr(piece_start), piece_line});
+    }
+    return pieces;
+}
+
+// Идентификаторы текста без повторений
+vector<string> Identifiers(string_view text)
+{
+    vector<string> result;
+    Lexer lexer(text);
+    while (!lexer.CurrentToken().Is<token_type::Eof>())
+    {
+        if (const auto *id = lexer.CurrentToken().TryAs<token_type::Id>())
+        {
+            result.emplace_back(id->value);
+        }
+        lexer.NextToken();
+    }
+    sort(result.begin(), result.end());
+    result.erase(unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+// Сдвигает номера строк узла и его потомков, включая тела методов объявленных в нём классов
+void ShiftLines(ast::Statement &node, int64_t delta)
+{
+    if (node.GetLine() != 0)
+    {
+        node.SetLine(static_cast<uint32_t>(node.GetLine() + delta));
+    }
+    if (auto class_def = dynamic_cast<ast::ClassDefinition *>(&node))
+    {
+        for (const runtime::Method &method : class_def->GetClass().TryAs<runtime::Class>()->GetMethods())
+        {
+            if (auto body = dynamic_cast<ast::MethodBody *>(method.body.get()); body != nullptr && body->GetLine() != 0)
+            {
+                body->SetLine(static_cast<uint32_t>(body->GetLine() + delta));
+            }
+        }
+    }
+    node.ForEachChild([delta](unique_ptr<ast::Statement> &child) { ShiftLines(*child, delta); });
+}
+} // namespace
+
+struct IncrementalParser::Chunk
+{
+    string text;
+    uint32_t first_line = 1;
+    // Часть разобрана без ошибок
+    bool parsed = false;
+    vector<unique_ptr<ast::Statement>> statements;
+    // Количество инструкций части, переданных дереву программы
+    size_t statement_count = 0;
+    // Объявленные ранее классы, имена которых встречаются в части, и классы, объявленные в ней
+    vector<pair<string, runtime::ObjectHolder>> dependencies;
+    vector<pair<string, runtime::ObjectHolder>> classes;
+
+    void ShiftTo(uint32_t line)
+    {
+        const int64_t delta = static_cast<int64_t>(line) - first_line;
+        if (delta != 0)
+        {
+            for (const auto &statement : statements)
+            {
+                ShiftLines(*statement, delta);
+            }
+        }
+        first_line = line;
+    }
+};
+
+IncrementalParser::IncrementalParser(runtime::Closure declared_classes)
+    : predeclared_classes_(std::move(declared_classes)), program_(make_unique<ast::Compound>())
+{
+}
+
+IncrementalParser::~IncrementalParser() = default;
+
+const IncrementalParser::UpdateStats &IncrementalParser::Update(string_view source)
+{
+    ReclaimStatements();
+    stats_ = {};
+
+    vector<unique_ptr<Chunk>> previous = std::move(chunks_);
+    chunks_.clear();
+    const vector<Piece> pieces = SplitTopLevel(source);
+    stats_.chunks = pieces.size();
+
+    // Правка обычно затрагивает несколько соседних частей: совпадающие начало и конец текста сопоставляются
+    // по порядку, остальные части предыдущей версии - по тексту
+    const auto same = [&](size_t old_index, size_t new_index) {
+        return previous[old_index]->parsed && previous[old_index]->text == pieces[new_index].text;
+    };
+    const size_t common = min(previous.size(), pieces.size());
+    size_t prefix = 0;
+    while (prefix < common && same(prefix, prefix))
+    {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < common - prefix && same(previous.size() - 1 - suffix, pieces.size() - 1 - suffix))
+    {
+        ++suffix;
+    }
+    // Ключи ссылаются на текст частей, которые хранятся до конца Update
+    unordered_map<string_view, deque<size_t>> previous_by_text;
+    for (size_t i = prefix; i < previous.size() - suffix; ++i)
+    {
+        if (previous[i]->parsed)
+        {
+            previous_by_text[previous[i]->text].push_back(i);
+        }
+    }
+    vector<unique_ptr<Chunk>> retired;
+    const auto take_previous = [&](size_t index) -> unique_ptr<Chunk> {
+        if (index < prefix)
+        {
+            return std::move(previous[index]);
+        }
+        if (index >= pieces.size() - suffix)
+        {
+            return std::move(previous[index - pieces.size() + previous.size()]);
+        }
+        auto iter = previous_by_text.find(pieces[index].text);
+        if (iter == previous_by_text.end() || iter->second.empty())
+        {
+            return nullptr;
+        }
+        const size_t old_index = iter->second.front();
+        iter->second.pop_front();
+        return std::move(previous[old_index]);
+    };
+
+    runtime::Closure declared_classes = predeclared_classes_;
+    // Все части, разобранные заново, размещаются в одной арене
+    ast::ArenaScope arena(FIRST_ARENA_BLOCK_SIZE);
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        unique_ptr<Chunk> chunk = take_previous(i);
+        if (chunk != nullptr && IsReusable(*chunk, declared_classes))
+        {
+            chunk->ShiftTo(pieces[i].first_line);
+            for (const auto &[name, cls] : chunk->classes)
+            {
+                declared_classes[name] = cls;
+            }
+            ++stats_.reused;
+            chunks_.push_back(std::move(chunk));
+            continue;
+        }
+        try
+        {
+            chunks_.push_back(ParseChunk(pieces[i].text, pieces[i].first_line, declared_classes));
+            ++stats_.parsed;
+            retired.push_back(std::move(chunk));
+        }
+        catch (...)
+        {
+            // Неразобранные части сохраняют деревья предыдущей версии для следующего вызова
+            for (size_t j = i; j < pieces.size(); ++j)
+            {
+                unique_ptr<Chunk> rest = j == i ? std::move(chunk) : take_previous(j);
+                if (rest == nullptr)
+                {
+                    rest = make_unique<Chunk>();
+                    rest->text = string(pieces[j].text);
+                    rest->first_line = pieces[j].first_line;
+                }
+                chunks_.push_back(std::move(rest));
+            }
+            program_ = make_unique<ast::Compound>();
+            throw;
+        }
+    }
+
+    program_ = make_unique<ast::Compound>();
+    for (const auto &chunk : chunks_)
+    {
+        chunk->statement_count = chunk->statements.size();
+        for (auto &statement : chunk->statements)
+        {
+            program_->AddStatement(std::move(statement));
+        }
+        chunk->statements.clear();
+    }
+    return stats_;
+}
+
+ast::Statement &IncrementalParser::GetProgram()
+{
+    return *program_;
+}
+
+const IncrementalParser::UpdateStats &IncrementalParser::GetStats() const
+{
+    return stats_;
+}
+
+void IncrementalParser::ReclaimStatements()
+{
+    vector<unique_ptr<ast::Statement>> statements;
+    program_->ForEachChild([&statements](unique_ptr<ast::Statement> &statement) {
+        statements.push_back(std::move(statement));
+    });
+    auto next = statements.begin();
+    for (const auto &chunk : chunks_)
+    {
+        for (size_t i = 0; i < chunk->statement_count; ++i)
+        {
+            chunk->statements.push_back(std::move(*next++));
+        }
+        chunk->statement_count = 0;
+    }
+    program_ = make_unique<ast::Compound>();
+}
+
+bool IncrementalParser::IsReusable(const Chunk &chunk, const runtime::Closure &declared_classes)
+{
+    for (const auto &[name, cls] : chunk.dependencies)
+    {
+        auto iter = declared_classes.find(name);
+        if (iter == declared_classes.end() || iter->second.Get() != cls.Get())
+        {
+            return false;
+        }
+    }
+    // Класс части, объявленный и в одной из предыдущих частей, - ошибка разбора
+    return none_of(chunk.classes.begin(), chunk.classes.end(),
+                   [&declared_classes](const auto &cls) { return declared_classes.count(cls.first) != 0; });
+}
+
+unique_ptr<IncrementalParser::Chunk> IncrementalParser::ParseChunk(string_view text, uint32_t first_line,
+                                                                   runtime::Closure &declared_classes)
+{
+    auto chunk = make_unique<Chunk>();
+    chunk->text = string(text);
+    chunk->first_line = first_line;
+
+    const vector<string> identifiers = Identifiers(chunk->text);
+    for (const string &id : identifiers)
+    {
+        if (auto iter = declared_classes.find(id); iter != declared_classes.end())
+        {
+            chunk->dependencies.emplace_back(id, iter->second);
+        }
+    }
+
+    Lexer lexer(chunk->text);
+    unique_ptr<ast::Statement> tree = ParseProgram(lexer, declared_classes);
+    for (const string &id : identifiers)
+    {
+        auto iter = declared_classes.find(id);
+        const bool declared_before = any_of(chunk->dependencies.begin(), chunk->dependencies.end(),
+                                            [&id](const auto &dependency) { return dependency.first == id; });
+        if (iter != declared_classes.end() && !declared_before)
+        {
+            chunk->classes.emplace_back(id, iter->second);
+        }
+    }
+    tree->ForEachChild([&chunk](unique_ptr<ast::Statement> &statement) {
+        chunk->statements.push_back(std::move(statement));
+    });
+
+    // Лексер нумерует строки части с единицы
+    chunk->first_line = 1;
+    chunk->ShiftTo(first_line);
+    chunk->parsed = true;
+    return chunk;
+}
+
+} // namespace parse
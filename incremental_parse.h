@@ -0,0 +1,71 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace ast
+{
+class Compound;
+class Statement;
+}
+
+namespace parse
+{
+
+/*
+ * Разбор редактируемого текста программы (редактор, REPL). Текст делится на части по инструкциям верхнего уровня:
+ * часть начинается строкой без отступа и включает следующие строки с отступом, пустые строки, комментарии
+ * и ветви else. Update заново разбирает лишь части, текст которых изменился, и части, ссылающиеся на классы
+ * из изменённых частей. Деревья остальных частей и их классы (runtime::Class) сохраняются,
+ * а номера строк в них сдвигаются вслед за правкой
+ */
+class IncrementalParser
+{
+public:
+    struct UpdateStats
+    {
+        size_t chunks = 0;
+        // Части, дерево которых сохранено, и части, разобранные заново
+        size_t reused = 0;
+        size_t parsed = 0;
+    };
+
+    // Классы из declared_classes объявлены до начала программы (см. ParseProgram)
+    explicit IncrementalParser(runtime::Closure declared_classes = {});
+    ~IncrementalParser();
+
+    IncrementalParser(const IncrementalParser &) = delete;
+    IncrementalParser &operator=(const IncrementalParser &) = delete;
+
+    /*
+     * Разбирает новую версию текста. Ошибки сообщаются исключениями лексера и ParseError; после ошибки
+     * дерево программы пусто, а части, разобранные до ошибки, используются следующим вызовом Update
+     */
+    const UpdateStats &Update(std::string_view source);
+
+    // Дерево последней версии текста (ast::Compound). Действительно до следующего вызова Update
+    [[nodiscard]] ast::Statement &GetProgram();
+
+    [[nodiscard]] const UpdateStats &GetStats() const;
+
+private:
+    struct Chunk;
+
+    // Возвращает в части инструкции, переданные дереву программы
+    void ReclaimStatements();
+
+    [[nodiscard]] static bool IsReusable(const Chunk &chunk, const runtime::Closure &declared_classes);
+    [[nodiscard]] static std::unique_ptr<Chunk> ParseChunk(std::string_view text, uint32_t first_line,
+                                                           runtime::Closure &declared_classes);
+
+    runtime::Closure predeclared_classes_;
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    std::unique_ptr<ast::Compound> program_;
+    UpdateStats stats_;
+};
+
+} // namespace parse
@@ -0,0 +1,153 @@
+#include "interpreter.h"
+
+#include "compiler.h"
+#include "lexer.h"
+#include "parse.h"
+#include "profiler.h"
+#include "serializer.h"
+#include "statement.h"
+#include "vm.h"
+
+#include <stdexcept>
+
+namespace interpreter
+{
+
+struct CompiledProgram::State
+{
+    Options options;
+    ast::OptimizationStats optimization_stats;
+    // Узлы дерева изменяют при исполнении только свои потокобезопасные кеши
+    std::unique_ptr<ast::Statement> tree;
+    std::unique_ptr<vm::Program> bytecode;
+};
+
+CompiledProgram::CompiledProgram(std::shared_ptr<const State> state) : state_(std::move(state)) {}
+
+CompiledProgram CompiledProgram::Build(std::unique_ptr<ast::Statement> tree, const Options &options)
+{
+    auto state = std::make_shared<State>();
+    state->options = options;
+    state->tree = std::move(tree);
+    state->optimization_stats = ast::Optimize(state->tree, options.level);
+    if (options.profiler != nullptr)
+    {
+        if (options.engine != Engine::Tree)
+        {
+            throw std::invalid_argument("Profiling is supported only by the tree engine");
+        }
+        options.profiler->Instrument(state->tree);
+    }
+    if (options.engine == Engine::Vm)
+    {
+        state->bytecode = std::make_unique<vm::Program>(vm::Compile(*state->tree));
+    }
+    return CompiledProgram(std::move(state));
+}
+
+const Options &CompiledProgram::GetOptions() const
+{
+    return state_->options;
+}
+
+const ast::OptimizationStats &CompiledProgram::GetOptimizationStats() const
+{
+    return state_->optimization_stats;
+}
+
+namespace
+{
+runtime::Closure DeclaredClasses(const Options &options)
+{
+    runtime::Closure classes;
+    for (const runtime::ObjectHolder &holder : options.classes)
+    {
+        const auto *cls = holder.TryAs<runtime::Class>();
+        if (cls == nullptr)
+        {
+            throw std::invalid_argument("Options::classes must contain only classes");
+        }
+        classes[cls->GetName()] = holder;
+    }
+    return classes;
+}
+} // namespace
+
+NativeClassBuilder::NativeClassBuilder(std::string name, const runtime::Class *parent)
+    : name_(std::move(name)), parent_(parent)
+{
+}
+
+NativeClassBuilder &NativeClassBuilder::AddMethod(std::string name, std::vector<std::string> params,
+                                                  runtime::NativeMethod method)
+{
+    runtime::Method &added = methods_.emplace_back();
+    added.name = std::move(name);
+    added.formal_params = std::move(params);
+    added.native = std::move(method);
+    return *this;
+}
+
+runtime::ObjectHolder NativeClassBuilder::Build()
+{
+    runtime::ObjectHolder cls = runtime::ObjectHolder::Own(runtime::Class(name_, std::move(methods_), parent_));
+    // Класс, как и классы программы, доступен всем её запускам
+    cls.ShareBetweenThreads();
+    methods_.clear();
+    return cls;
+}
+
+CompiledProgram Compile(std::string_view source, const Options &options)
+{
+    parse::Lexer lexer(source);
+    runtime::Closure classes = DeclaredClasses(options);
+    return CompiledProgram::Build(ParseProgram(lexer, classes), options);
+}
+
+CompiledProgram Compile(std::istream &input, const Options &options)
+{
+    parse::Lexer lexer(input);
+    runtime::Closure classes = DeclaredClasses(options);
+    return CompiledProgram::Build(ParseProgram(lexer, classes), options);
+}
+
+CompiledProgram Load(std::string_view image, const Options &options)
+{
+    return CompiledProgram::Build(ast::DeserializeProgram(image), options);
+}
+
+void Save(const CompiledProgram &program, std::ostream &output)
+{
+    ast::SerializeProgram(*program.state_->tree, output);
+}
+
+void Run(const CompiledProgram &program, runtime::Context &context, runtime::Closure &globals)
+{
+    const CompiledProgram::State &state = *program.state_;
+    context.SetRecursionLimit(state.options.recursion_limit);
+    context.SetStepLimit(state.options.step_limit);
+    if (state.options.time_limit.count() > 0)
+    {
+        context.SetDeadline(std::chrono::steady_clock::now() + state.options.time_limit);
+    }
+    else
+    {
+        context.SetDeadline(std::nullopt);
+    }
+    if (state.bytecode != nullptr)
+    {
+        vm::Machine(*state.bytecode, context).Run(globals);
+    }
+    else
+    {
+        state.tree->Execute(globals, context);
+    }
+}
+
+void Run(const CompiledProgram &program, runtime::Context &context)
+{
+    runtime::Closure globals;
+    Run(program, context, globals);
+}
+
+} // namespace interpreter
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "optimizer.h"
+#include "runtime.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ast
+{
+class Profiler;
+class Statement;
+}
+
+namespace vm
+{
+struct Program;
+}
+
+namespace interpreter
+{
+
+enum class Engine
+{
+    // Обход синтаксического дерева
+    Tree,
+    // Компиляция в байткод и исполнение на регистровой машине
+    Vm,
+};
+
+struct Options
+{
+    Engine engine = Engine::Tree;
+    ast::OptimizationLevel level = ast::OptimizationLevel::O1;
+    // Если задан, в дерево встраиваются счётчики профилировщика. Поддерживается только Engine::Tree,
+    // программу со счётчиками нельзя исполнять одновременно из нескольких потоков
+    ast::Profiler *profiler = nullptr;
+    // Наибольшая глубина вложенных вызовов методов при исполнении (см. runtime::Context::SetRecursionLimit);
+    // по умолчанию не ограничена
+    size_t recursion_limit = runtime::NO_RECURSION_LIMIT;
+    // Бюджет шагов исполнения и время исполнения одного запуска (см. runtime::Context::SetStepLimit);
+    // нулевые значения не ограничивают исполнение
+    uint64_t step_limit = 0;
+    std::chrono::milliseconds time_limit{0};
+    // Классы, объявленные до начала программы (например, построенные NativeClassBuilder): программа
+    // создаёт их экземпляры и наследует от них по имени. Программа с такими классами не сохраняется в образ
+    std::vector<runtime::ObjectHolder> classes{};
+};
+
+/*
+ * Строит класс, методы которого реализованы функциями C++. Вызовы таких методов из программы проходят
+ * обычным путём вызова метода, но исполняются без кадра и синтаксического дерева.
+ * Класс можно использовать одновременно из нескольких потоков, если это допускают функции его методов
+ */
+class NativeClassBuilder
+{
+public:
+    explicit NativeClassBuilder(std::string name, const runtime::Class *parent = nullptr);
+
+    // Добавляет метод name с формальными параметрами params
+    NativeClassBuilder &AddMethod(std::string name, std::vector<std::string> params, runtime::NativeMethod method);
+
+    [[nodiscard]] runtime::ObjectHolder Build();
+
+private:
+    std::string name_;
+    const runtime::Class *parent_;
+    std::vector<runtime::Method> methods_;
+};
+
+/*
+ * Разобранная (и при необходимости скомпилированная в байткод) программа.
+ * Программа не изменяется при исполнении, поэтому её можно исполнять многократно,
+ * в том числе одновременно из нескольких потоков: каждый запуск создаёт свои объекты,
+ * а общими остаются лишь классы и потокобезопасные кеши мест вызова.
+ * Копии ссылаются на одну и ту же программу
+ */
+class CompiledProgram
+{
+public:
+    [[nodiscard]] const Options &GetOptions() const;
+
+    // Результат оптимизации дерева при разборе
+    [[nodiscard]] const ast::OptimizationStats &GetOptimizationStats() const;
+
+private:
+    struct State;
+
+    explicit CompiledProgram(std::shared_ptr<const State> state);
+
+    [[nodiscard]] static CompiledProgram Build(std::unique_ptr<ast::Statement> tree, const Options &options);
+
+    friend CompiledProgram Compile(std::string_view source, const Options &options);
+    friend CompiledProgram Compile(std::istream &input, const Options &options);
+    friend CompiledProgram Load(std::string_view image, const Options &options);
+    friend void Save(const CompiledProgram &program, std::ostream &output);
+    friend void Run(const CompiledProgram &program, runtime::Context &context, runtime::Closure &globals);
+
+    std::shared_ptr<const State> state_;
+};
+
+// Разбирает программу. Ошибки разбора сообщаются исключениями лексера и ParseError
+CompiledProgram Compile(std::string_view source, const Options &options = {});
+CompiledProgram Compile(std::istream &input, const Options &options = {});
+
+/*
+ * Загружает программу из образа, записанного Save, без лексического и синтаксического разбора.
+ * Дерево в образе уже оптимизировано при сохранении; options.level применяется к нему повторно.
+ * Повреждённый образ сообщается исключением ast::SerializationError
+ */
+CompiledProgram Load(std::string_view image, const Options &options = {});
+
+// Записывает образ разобранной программы (файл .myc)
+void Save(const CompiledProgram &program, std::ostream &output);
+
+/*
+ * Исполняет программу. Входные данные передаются переменными в globals,
+ * по завершении globals содержит переменные верхнего уровня программы.
+ * Ограничения глубины рекурсии, числа шагов и срок исполнения контекста устанавливаются из options программы.
+ * Флаг отмены задаётся в контексте вызывающим кодом (runtime::Context::SetCancellationFlag)
+ */
+void Run(const CompiledProgram &program, runtime::Context &context, runtime::Closure &globals);
+
+// Исполняет программу с пустым набором переменных
+void Run(const CompiledProgram &program, runtime::Context &context);
+
+} // namespace interpreter
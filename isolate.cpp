@@ -0,0 +1,291 @@
+#include "isolate.h"
+
+#include "runtime.h"
+
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace interpreter
+{
+
+namespace
+{
+// Ожидание другой стороны канала: сначала короткие повторные проверки, затем уступка процессора
+class Backoff
+{
+public:
+    void Wait()
+    {
+        if (++attempts_ > SPIN_ATTEMPTS)
+        {
+            this_thread::yield();
+        }
+    }
+
+private:
+    static constexpr size_t SPIN_ATTEMPTS = 64;
+    size_t attempts_ = 0;
+};
+
+size_t RoundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+Message ToMessage(const runtime::ObjectHolder &value)
+{
+    if (const auto *number = value.TryAs<runtime::Number>())
+    {
+        return number->GetValue();
+    }
+    if (const auto *str = value.TryAs<runtime::String>())
+    {
+        return str->GetValue();
+    }
+    if (const auto *boolean = value.TryAs<runtime::Bool>())
+    {
+        return boolean->GetValue();
+    }
+    throw runtime_error("Only numbers, strings and bools can be sent to a channel"s);
+}
+
+runtime::ObjectHolder FromMessage(Message message)
+{
+    if (const int *number = get_if<int>(&message))
+    {
+        return runtime::ObjectHolder::Own(runtime::Number(*number));
+    }
+    if (string *str = get_if<string>(&message))
+    {
+        return runtime::ObjectHolder::Own(runtime::String(std::move(*str)));
+    }
+    return runtime::ObjectHolder::Own(runtime::Bool(get<bool>(message)));
+}
+} // namespace
+
+Channel::Channel(size_t capacity) : buffer_(RoundUpToPowerOfTwo(max<size_t>(capacity, 1))), mask_(buffer_.size() - 1)
+{
+}
+
+bool Channel::TrySend(Message &message)
+{
+    const size_t tail = tail_.load(memory_order_relaxed);
+    if (tail - cached_head_ == buffer_.size())
+    {
+        cached_head_ = head_.load(memory_order_acquire);
+        if (tail - cached_head_ == buffer_.size())
+        {
+            return false;
+        }
+    }
+    buffer_[tail & mask_] = std::move(message);
+    tail_.store(tail + 1, memory_order_release);
+    return true;
+}
+
+void Channel::Send(Message message)
+{
+    Backoff backoff;
+    while (true)
+    {
+        if (IsClosed())
+        {
+            throw runtime_error("Channel is closed"s);
+        }
+        if (TrySend(message))
+        {
+            return;
+        }
+        backoff.Wait();
+    }
+}
+
+bool Channel::TryReceive(Message &message)
+{
+    if (!HasMessage())
+    {
+        return false;
+    }
+    const size_t head = head_.load(memory_order_relaxed);
+    message = std::move(buffer_[head & mask_]);
+    head_.store(head + 1, memory_order_release);
+    return true;
+}
+
+optional<Message> Channel::Receive()
+{
+    Message message;
+    if (!WaitForMessage() || !TryReceive(message))
+    {
+        return nullopt;
+    }
+    return message;
+}
+
+bool Channel::WaitForMessage()
+{
+    Backoff backoff;
+    while (!HasMessage())
+    {
+        if (IsClosed())
+        {
+            // Сообщения, отправленные до закрытия канала, видны после чтения флага
+            return HasMessage();
+        }
+        backoff.Wait();
+    }
+    return true;
+}
+
+bool Channel::HasMessage()
+{
+    const size_t head = head_.load(memory_order_relaxed);
+    if (head == cached_tail_)
+    {
+        cached_tail_ = tail_.load(memory_order_acquire);
+    }
+    return head != cached_tail_;
+}
+
+void Channel::Close()
+{
+    closed_.store(true, memory_order_release);
+}
+
+bool Channel::IsClosed() const
+{
+    return closed_.load(memory_order_acquire);
+}
+
+size_t Channel::GetCapacity() const
+{
+    return buffer_.size();
+}
+
+Isolate::Isolate(CompiledProgram program, std::ostream &output) : program_(std::move(program)), output_(output)
+{
+}
+
+Isolate::~Isolate()
+{
+    if (thread_.joinable())
+    {
+        Cancel();
+        thread_.join();
+    }
+}
+
+Isolate &Isolate::BindReceiver(const std::string &name, std::shared_ptr<Channel> channel)
+{
+    CheckNotStarted();
+    Channel *receiver = channel.get();
+    runtime::ObjectHolder cls =
+        NativeClassBuilder("Receiver"s)
+            .AddMethod("has_next"s, {},
+                       [receiver](runtime::ClassInstance &, const vector<runtime::ObjectHolder> &, runtime::Context &) {
+                           return runtime::ObjectHolder::Own(runtime::Bool(receiver->WaitForMessage()));
+                       })
+            .AddMethod("receive"s, {},
+                       [receiver](runtime::ClassInstance &, const vector<runtime::ObjectHolder> &, runtime::Context &) {
+                           optional<Message> message = receiver->Receive();
+                           return message ? FromMessage(std::move(*message)) : runtime::ObjectHolder::None();
+                       })
+            .Build();
+    bindings_.push_back({name, std::move(channel), std::move(cls)});
+    return *this;
+}
+
+Isolate &Isolate::BindSender(const std::string &name, std::shared_ptr<Channel> channel)
+{
+    CheckNotStarted();
+    Channel *sender = channel.get();
+    runtime::ObjectHolder cls =
+        NativeClassBuilder("Sender"s)
+            .AddMethod("send"s, {"value"s},
+                       [sender](runtime::ClassInstance &, const vector<runtime::ObjectHolder> &args,
+                                runtime::Context &) {
+                           sender->Send(ToMessage(args[0]));
+                           return runtime::ObjectHolder::None();
+                       })
+            .AddMethod("close"s, {},
+                       [sender](runtime::ClassInstance &, const vector<runtime::ObjectHolder> &, runtime::Context &) {
+                           sender->Close();
+                           return runtime::ObjectHolder::None();
+                       })
+            .Build();
+    bindings_.push_back({name, std::move(channel), std::move(cls)});
+    return *this;
+}
+
+void Isolate::Start()
+{
+    CheckNotStarted();
+    started_ = true;
+    thread_ = thread([this] { Execute(); });
+}
+
+void Isolate::Join()
+{
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    if (error_)
+    {
+        rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void Isolate::Cancel()
+{
+    cancelled_.store(true, memory_order_relaxed);
+    CloseChannels();
+}
+
+void Isolate::Execute()
+{
+    try
+    {
+        runtime::SimpleContext context(output_);
+        context.SetCancellationFlag(&cancelled_);
+        runtime::Closure globals;
+        for (const Binding &binding : bindings_)
+        {
+            const auto &cls = *binding.cls.TryAs<runtime::Class>();
+            globals[binding.name] = runtime::ObjectHolder::Own(runtime::ClassInstance(cls));
+        }
+        Run(program_, context, globals);
+    }
+    catch (...)
+    {
+        error_ = current_exception();
+    }
+    // Объекты программы освобождаются в потоке изолята, которому принадлежит куча
+    runtime::CollectCycles();
+    CloseChannels();
+}
+
+void Isolate::CheckNotStarted() const
+{
+    if (started_)
+    {
+        throw logic_error("Isolate is already started"s);
+    }
+}
+
+void Isolate::CloseChannels()
+{
+    for (const Binding &binding : bindings_)
+    {
+        binding.channel->Close();
+    }
+}
+
+} // namespace interpreter
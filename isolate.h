@@ -0,0 +1,126 @@
+#pragma once
+
+#include "interpreter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace interpreter
+{
+
+// Значение, передаваемое между изолятами: копия числа, строки или логического значения
+using Message = std::variant<int, std::string, bool>;
+
+constexpr size_t DEFAULT_CHANNEL_CAPACITY = 1024;
+
+/*
+ * Канал без блокировок между одним отправителем и одним получателем: кольцевой буфер, ёмкость
+ * которого округляется вверх до степени двойки. Send ожидает свободного места, Receive - сообщения.
+ * Закрыть канал может любая из сторон: получатель дочитывает отправленные сообщения,
+ * а отправка в закрытый канал выбрасывает исключение runtime_error
+ */
+class Channel
+{
+public:
+    explicit Channel(size_t capacity = DEFAULT_CHANNEL_CAPACITY);
+
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    // Вызываются только отправителем. TrySend возвращает false, если буфер заполнен
+    [[nodiscard]] bool TrySend(Message &message);
+    void Send(Message message);
+
+    // Вызываются только получателем. Receive возвращает nullopt, если канал закрыт и сообщений в нём нет
+    [[nodiscard]] bool TryReceive(Message &message);
+    [[nodiscard]] std::optional<Message> Receive();
+
+    // Ожидает сообщения, не извлекая его. Возвращает false, если канал закрыт и сообщений в нём нет
+    [[nodiscard]] bool WaitForMessage();
+
+    void Close();
+
+    [[nodiscard]] bool IsClosed() const;
+
+    [[nodiscard]] size_t GetCapacity() const;
+
+private:
+    [[nodiscard]] bool HasMessage();
+
+    std::vector<Message> buffer_;
+    size_t mask_;
+    std::atomic<bool> closed_ = false;
+
+    // Индексы растут неограниченно; позиция в буфере - индекс по модулю ёмкости.
+    // Каждая сторона хранит копию индекса другой стороны, чтобы реже читать чужую строку кеша
+    alignas(64) std::atomic<size_t> head_ = 0;
+    size_t cached_tail_ = 0;
+    alignas(64) std::atomic<size_t> tail_ = 0;
+    size_t cached_head_ = 0;
+};
+
+/*
+ * Изолят - независимый экземпляр интерпретатора, исполняющий программу в собственном потоке.
+ * Объекты программы (переменные, экземпляры классов, строки) размещаются в куче этого потока и
+ * не видны другим изолятам; общими остаются лишь неизменяемая CompiledProgram и её классы.
+ * Изоляты обмениваются значениями только через каналы: переменная, связанная с каналом,
+ * - объект с методами has_next() и receive() (ожидают сообщения; когда канал закрыт и пуст, has_next()
+ * возвращает False, а receive() - None) либо с методами send(value) и close().
+ * По завершении программы, в том числе с ошибкой, изолят закрывает все свои каналы, так что следующие
+ * стадии конвейера дочитывают сообщения и завершаются, а предыдущие получают ошибку при отправке
+ */
+class Isolate
+{
+public:
+    // Вывод print направляется в output, который не должен использоваться другими изолятами
+    Isolate(CompiledProgram program, std::ostream &output);
+
+    // Отменяет исполнение, если изолят запущен, и дожидается его завершения
+    ~Isolate();
+
+    Isolate(const Isolate &) = delete;
+    Isolate &operator=(const Isolate &) = delete;
+
+    // Связывают переменную name программы с получающим либо отправляющим концом канала. Вызываются до Start
+    Isolate &BindReceiver(const std::string &name, std::shared_ptr<Channel> channel);
+    Isolate &BindSender(const std::string &name, std::shared_ptr<Channel> channel);
+
+    void Start();
+
+    // Дожидается завершения программы; ошибка исполнения выбрасывается повторно
+    void Join();
+
+    // Прерывает исполнение (runtime::ExecutionLimitError) и закрывает каналы изолята
+    void Cancel();
+
+private:
+    struct Binding
+    {
+        std::string name;
+        std::shared_ptr<Channel> channel;
+        // Класс объекта, через который программа обращается к каналу
+        runtime::ObjectHolder cls;
+    };
+
+    void Execute();
+    void CheckNotStarted() const;
+    void CloseChannels();
+
+    CompiledProgram program_;
+    std::ostream &output_;
+    std::vector<Binding> bindings_;
+    bool started_ = false;
+    std::atomic<bool> cancelled_ = false;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+} // namespace interpreter
@@ -11,6 +11,103 @@ using namespace std;
 namespace parse
 {
 
+namespace
+{
+// Распознаёт ключевое слово по длине и первому символу, сравнивая не более одной строки
+std::optional<Token> FindKeyword(std::string_view word)
+{
+    switch (word.size())
+    {
+    case 2:
+        if (word == "if"sv)
+        {
+            return token_type::If{};
+        }
+        if (word == "or"sv)
+        {
+            return token_type::Or{};
+        }
+        break;
+    case 3:
+        switch (word[0])
+        {
+        case 'd':
+            if (word == "def"sv)
+            {
+                return token_type::Def{};
+            }
+            break;
+        case 'n':
+            if (word == "not"sv)
+            {
+                return token_type::Not{};
+            }
+            break;
+        case 'a':
+            if (word == "and"sv)
+            {
+                return token_type::And{};
+            }
+            break;
+        }
+        break;
+    case 4:
+        switch (word[0])
+        {
+        case 'e':
+            if (word == "else"sv)
+            {
+                return token_type::Else{};
+            }
+            break;
+        case 'N':
+            if (word == "None"sv)
+            {
+                return token_type::None{};
+            }
+            break;
+        case 'T':
+            if (word == "True"sv)
+            {
+                return token_type::True{};
+            }
+            break;
+        }
+        break;
+    case 5:
+        switch (word[0])
+        {
+        case 'c':
+            if (word == "class"sv)
+            {
+                return token_type::Class{};
+            }
+            break;
+        case 'p':
+            if (word == "print"sv)
+            {
+                return token_type::Print{};
+            }
+            break;
+        case 'F':
+            if (word == "False"sv)
+            {
+                return token_type::False{};
+            }
+            break;
+        }
+        break;
+    case 6:
+        if (word == "return"sv)
+        {
+            return token_type::Return{};
+        }
+        break;
+    }
+    return std::nullopt;
+}
+} // namespace
+
 bool operator==(const Token &lhs, const Token &rhs)
 {
     using namespace token_type;
@@ -88,53 +185,56 @@ std::ostream &operator<<(std::ostream &os, const Token &rhs)
     return os << "Unknown token :("sv;
 }
 
-void Lexer::ProcessKeyWord(const std::string &word)
+template <typename T>
+void Lexer::PushText(std::string_view text)
 {
-    const std::map<std::string, Token> KEYWORD_TO_TOKEN = {
-        {"class", Token(token_type::Class{})}, {"return", Token(token_type::Return{})},
-        {"if", Token(token_type::If{})},       {"else", Token(token_type::Else{})},
-        {"def", Token(token_type::Def{})},     {"print", Token(token_type::Print{})},
-        {"or", Token(token_type::Or{})},       {"None", Token(token_type::None{})},
-        {"not", Token(token_type::Not{})},     {"and", Token(token_type::And{})},
-        {"True", Token(token_type::True{})},   {"False", Token(token_type::False{})}};
-
-    auto iter = KEYWORD_TO_TOKEN.find(word);
-    if (iter != KEYWORD_TO_TOKEN.end())
+    // Порция потока перезаписывается при чтении следующей, а текст в памяти не изменяется
+    if (input_ == nullptr)
     {
-        tokens_.push_back(iter->second);
+        PushToken(Token(T{text}));
     }
     else
     {
-        std::runtime_error("Failed to process key word");
+        PushOwnedText<T>(std::string(text));
     }
 }
 
-void Lexer::ProcessWord(std::istream &input)
+template <typename T>
+void Lexer::PushOwnedText(std::string text)
 {
-    std::string word;
-    while (std::isalpha(input.peek()) || std::isdigit(input.peek()) || input.peek() == '_')
+    PushToken(Token(T{}));
+    LocatedToken &located = tokens_.back();
+    located.text = std::move(text);
+    located.token = Token(T{located.text});
+}
+
+void Lexer::ProcessWord()
+{
+    const size_t start = pos_;
+    while (std::isalpha(Peek()) || std::isdigit(Peek()) || Peek() == '_')
     {
-        word.push_back(static_cast<char>(input.get()));
+        ++pos_;
     }
-    if (IsKeyWord(word))
+    const std::string_view word = source_.substr(start, pos_ - start);
+    if (std::optional<Token> keyword = FindKeyword(word))
     {
-        ProcessKeyWord(std::move(word));
+        PushToken(std::move(*keyword));
     }
     else
     {
-        tokens_.push_back(Token(token_type::Id{std::move(word)}));
+        PushText<token_type::Id>(word);
     }
 }
 
-void Lexer::ProcessIndent(std::istream &input)
+void Lexer::ProcessIndent()
 {
     size_t space_count = 0;
-    while (input && static_cast<char>(input.peek()) == ' ')
+    while (Peek() == ' ')
     {
-        input.get();
+        ++pos_;
         space_count++;
     }
-    if (input.peek() == '\n')
+    if (Peek() == '\n')
     {
         return;
     }
@@ -143,7 +243,7 @@ void Lexer::ProcessIndent(std::istream &input)
     {
         for (size_t i = 0; i < indent - prev_indent; i++)
         {
-            tokens_.push_back(Token(token_type::Indent{}));
+            PushToken(Token(token_type::Indent{}));
         }
         prev_indent = indent;
     }
@@ -151,7 +251,7 @@ void Lexer::ProcessIndent(std::istream &input)
     {
         for (size_t i = 0; i < prev_indent - indent; i++)
         {
-            tokens_.push_back(Token(token_type::Dedent{}));
+            PushToken(Token(token_type::Dedent{}));
         }
         prev_indent = indent;
     }
@@ -170,85 +270,108 @@ void Lexer::ProcessComparisonOperator(char left, char right)
 
     if (oper == ">=")
     {
-        tokens_.push_back(Token(token_type::GreaterOrEq{}));
+        PushToken(Token(token_type::GreaterOrEq{}));
     }
     else if (oper == "<=")
     {
-        tokens_.push_back(Token(token_type::LessOrEq{}));
+        PushToken(Token(token_type::LessOrEq{}));
     }
     else if (oper == "==")
     {
-        tokens_.push_back(Token(token_type::Eq{}));
+        PushToken(Token(token_type::Eq{}));
     }
     else if (oper == "!=")
     {
-        tokens_.push_back(Token(token_type::NotEq{}));
+        PushToken(Token(token_type::NotEq{}));
     }
 }
 
 void Lexer::ProcessSymbol(char c)
 {
-    tokens_.push_back(Token(token_type::Char{c}));
+    PushToken(Token(token_type::Char{c}));
 }
 
 void Lexer::ProcessNextLine()
 {
-    if (!tokens_.empty() && !tokens_.back().Is<token_type::Newline>())
+    if (has_tokens_ && !last_is_newline_)
     {
-        tokens_.push_back(Token(token_type::Newline{}));
+        PushToken(Token(token_type::Newline{}));
     }
 }
 
-void Lexer::ProcessNum(std::istream &input)
+void Lexer::ProcessNum()
 {
-    std::string num_str;
-    while (std::isdigit(input.peek()))
+    const size_t start = pos_;
+    while (std::isdigit(Peek()))
     {
-        num_str.push_back(static_cast<char>(input.get()));
+        ++pos_;
     }
 
-    int result = std::stoi(num_str);
-    tokens_.push_back(Token(token_type::Number{result}));
+    const std::string_view num_str = source_.substr(start, pos_ - start);
+    int result = 0;
+    if (std::from_chars(num_str.data(), num_str.data() + num_str.size(), result).ec != std::errc{})
+    {
+        throw LexerError("Number is out of range: "s + std::string(num_str));
+    }
+    PushToken(Token(token_type::Number{result}));
 }
 
-void Lexer::IgnoreComment(std::istream &input)
+void Lexer::IgnoreComment()
 {
-    do
+    while (Peek() != '\n' && Peek() != END_OF_INPUT)
     {
-        input.ignore(1024, '\n');
-        if (!input.eof())
-        {
-            input.unget();
-        }
-    } while (input.peek() != '\n' && !input.eof());
+        ++pos_;
+    }
 }
 
-void Lexer::ProcessString(std::istream &input)
+void Lexer::ProcessString()
 {
-    char delim = static_cast<char>(input.get());
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
+    const char delim = static_cast<char>(Get());
+    const size_t start = pos_;
+    // Строка без escape-последовательностей копируется из буфера целиком
+    while (true)
+    {
+        const int ch = Peek();
+        if (ch == END_OF_INPUT)
+        {
+            throw ParsingError("String parsing error");
+        }
+        if (ch == delim)
+        {
+            PushText<token_type::String>(source_.substr(start, pos_ - start));
+            ++pos_;
+            return;
+        }
+        if (ch == '\\')
+        {
+            break;
+        }
+        if (ch == '\n' || ch == '\r')
+        {
+            throw ParsingError("Unexpected end of line"s);
+        }
+        ++pos_;
+    }
+
+    std::string s(source_.substr(start, pos_ - start));
     while (true)
     {
-        if (it == end)
+        const int ch = Get();
+        if (ch == END_OF_INPUT)
         {
             throw ParsingError("String parsing error");
         }
-        const char ch = *it;
         if (ch == delim)
         {
-            ++it;
             break;
         }
         else if (ch == '\\')
         {
-            ++it;
-            if (it == end)
+            const int escaped_char = Get();
+            if (escaped_char == END_OF_INPUT)
             {
                 throw ParsingError("String parsing error");
             }
-            const char escaped_char = *(it);
             switch (escaped_char)
             {
             case 'n':
@@ -270,7 +393,7 @@ void Lexer::ProcessString(std::istream &input)
                 s.push_back('\\');
                 break;
             default:
-                throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                throw ParsingError("Unrecognized escape sequence \\"s + static_cast<char>(escaped_char));
             }
         }
         else if (ch == '\n' || ch == '\r')
@@ -279,109 +402,141 @@ void Lexer::ProcessString(std::istream &input)
         }
         else
         {
-            s.push_back(ch);
+            s.push_back(static_cast<char>(ch));
         }
-        ++it;
     }
-    tokens_.push_back(Token(token_type::String{std::move(s)}));
+    PushOwnedText<token_type::String>(std::move(s));
 }
 
-Lexer::Lexer(std::istream &input)
+Lexer::Lexer(std::istream &input) : input_(&input)
 {
-    ProcessAllTokens(input);
+    ProcessIndent();
+    FillBuffer();
 }
 
-void Lexer::ProcessAllTokens(std::istream &input)
+Lexer::Lexer(std::string_view source) : source_(source)
 {
-    ProcessIndent(input);
-    while (input.good())
+    ProcessIndent();
+    FillBuffer();
+}
+
+bool Lexer::ReadChunk()
+{
+    if (input_ == nullptr || !input_->good())
     {
-        ProcessNextToken(input);
+        return false;
     }
-    if (!tokens_.empty() && !tokens_.back().Is<token_type::Dedent>() &&
-        !tokens_.back().Is<token_type::Newline>())
+    // Непрочитанный остаток буфера сохраняется: лексема может продолжаться в следующей порции
+    const size_t size = chunk_.size();
+    chunk_.resize(size + CHUNK_SIZE);
+    input_->read(chunk_.data() + size, CHUNK_SIZE);
+    chunk_.resize(size + static_cast<size_t>(input_->gcount()));
+    source_ = chunk_;
+    return chunk_.size() > size;
+}
+
+void Lexer::FillBuffer()
+{
+    while (tokens_.empty())
+    {
+        if (input_ != nullptr && pos_ == source_.size())
+        {
+            // Между лексемами прочитанная часть порции больше не нужна
+            chunk_.clear();
+            source_ = chunk_;
+            pos_ = 0;
+        }
+        if (Peek() != END_OF_INPUT)
+        {
+            ProcessNextToken();
+        }
+        else
+        {
+            ProcessEof();
+        }
+    }
+}
+
+void Lexer::ProcessEof()
+{
+    if (has_tokens_ && !last_is_dedent_ && !last_is_newline_)
     {
         ProcessNextLine();
     }
-    tokens_.push_back(Token(token_type::Eof{}));
+    PushToken(Token(token_type::Eof{}));
 }
 
-void Lexer::ProcessNextToken(std::istream &input)
+void Lexer::PushToken(Token token)
 {
-    char c;
-    c = static_cast<char>(input.get());
+    has_tokens_ = true;
+    last_is_newline_ = token.Is<token_type::Newline>();
+    last_is_dedent_ = token.Is<token_type::Dedent>();
+    tokens_.push_back(LocatedToken{std::move(token), line_});
+}
+
+void Lexer::ProcessNextToken()
+{
+    const int c = Get();
     if (c == '\n')
     {
         ProcessNextLine();
-        ProcessIndent(input);
+        ++line_;
+        ProcessIndent();
     }
     else if (c == '"' || c == '\'')
     {
-        input.putback(c);
-        ProcessString(input);
+        --pos_;
+        ProcessString();
     }
     else if (c == '_' || std::isalpha(c))
     {
-        input.putback(c);
-        ProcessWord(input);
+        --pos_;
+        ProcessWord();
     }
     else if (std::isdigit(c))
     {
-        input.putback(c);
-        ProcessNum(input);
+        --pos_;
+        ProcessNum();
     }
     else if (c == '#')
     {
-        IgnoreComment(input);
+        IgnoreComment();
     }
     else if (std::ispunct(c))
     {
-        char second_symbol = static_cast<char>(input.get());
+        const int second_symbol = Peek();
 
-        if (IsComparisonOperator(c, second_symbol))
+        if (second_symbol != END_OF_INPUT && IsComparisonOperator(static_cast<char>(c), static_cast<char>(second_symbol)))
         {
-            ProcessComparisonOperator(c, second_symbol);
+            ++pos_;
+            ProcessComparisonOperator(static_cast<char>(c), static_cast<char>(second_symbol));
         }
         else
         {
-            input.putback(second_symbol);
-            ProcessSymbol(c);
+            ProcessSymbol(static_cast<char>(c));
         }
     }
 }
 
-bool Lexer::IsKeyWord(const std::string &word) const
+const Token &Lexer::CurrentToken() const
 {
-    const static std::set<std::string> USING_KEYWORDS = {"class", "return", "if",  "else", "def",  "print",
-                                                         "or",    "None",   "and", "not",  "True", "False"};
-
-    return USING_KEYWORDS.count(word);
+    return tokens_.front().token;
 }
 
-const Token &Lexer::CurrentToken() const
+size_t Lexer::CurrentLine() const
 {
-    if (current_pos < tokens_.size())
-    {
-        return tokens_[current_pos];
-    }
-    else
-    {
-        const static Token EOF_TOKEN = Token(token_type::Eof{});
-        return EOF_TOKEN;
-    }
+    return tokens_.front().line;
 }
 
 Token Lexer::NextToken()
 {
-    if (current_pos < tokens_.size())
-    {
-        current_pos++;
-        return CurrentToken();
-    }
-    else
+    // Лексема Eof остаётся текущей после окончания потока
+    if (!tokens_.front().token.Is<token_type::Eof>())
     {
-        return Token(token_type::Eof{});
+        tokens_.pop_front();
+        FillBuffer();
     }
+    return CurrentToken();
 }
 
-} // namespace parse
\ No newline at end of file
+} // namespace parse
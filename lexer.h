@@ -1,5 +1,7 @@
 #pragma once
 
+#include "memory_stats.h"
+
 #include <deque>
 #include <iosfwd>
 #include <map>
@@ -8,6 +10,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_set>
 #include <variant>
 #include <vector>
@@ -21,9 +24,12 @@ struct Number
     int value = 0;
 };
 
+// Текст лексем Id и String не копируется: при разборе текста в памяти он указывает в исходный текст
+// и действителен, пока существует текст. Текст строк с escape-последовательностями и лексем, прочитанных
+// из потока, хранится в лексере и действителен, пока лексема остаётся текущей (до вызова NextToken)
 struct Id
 {
-    std::string value = 0;
+    std::string_view value;
 };
 
 struct Char
@@ -33,7 +39,7 @@ struct Char
 
 struct String
 {
-    std::string value;
+    std::string_view value;
 };
 
 struct Class
@@ -146,11 +152,23 @@ public:
     using runtime_error::runtime_error;
 };
 
+/*
+ * Лексический анализатор, выделяющий лексемы по требованию: текст разбирается по мере вызовов
+ * NextToken, в буфере хранятся лишь текущая лексема и лексемы, полученные вместе с ней
+ * (например, несколько Dedent подряд)
+ */
 class Lexer
 {
 public:
+    // Читает текст из потока порциями по CHUNK_SIZE байт. Поток должен существовать, пока используется лексер
     explicit Lexer(std::istream &input);
 
+    // Разбирает текст, уже находящийся в памяти (например, отображённый файл).
+    // Текст не копируется и должен существовать, пока используется лексер
+    explicit Lexer(std::string_view source);
+
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
     // Возвращает ссылку на текущий токен или token_type::Eof, если поток
     // токенов закончился
     [[nodiscard]] const Token &CurrentToken() const;
@@ -159,6 +177,9 @@ public:
     // закончился
     Token NextToken();
 
+    // Номер строки текста (начиная с 1), на которой находится текущий токен
+    [[nodiscard]] size_t CurrentLine() const;
+
     // Если текущий токен имеет тип T, метод возвращает ссылку на него.
     // В противном случае метод выбрасывает исключение LexerError
     template <typename T>
@@ -182,25 +203,77 @@ public:
     void ExpectNext(const U &value);
 
 private:
-    void ProcessAllTokens(std::istream &input);
-    void ProcessNextToken(std::istream &input);
-    void ProcessIndent(std::istream &input);
+    static constexpr int END_OF_INPUT = -1;
+
+    // Возвращает очередной символ текста, не извлекая его, либо END_OF_INPUT
+    int Peek()
+    {
+        if (pos_ == source_.size() && !ReadChunk())
+        {
+            return END_OF_INPUT;
+        }
+        return static_cast<unsigned char>(source_[pos_]);
+    }
+
+    int Get()
+    {
+        const int c = Peek();
+        if (c != END_OF_INPUT)
+        {
+            ++pos_;
+        }
+        return c;
+    }
+
+    // Дописывает в буфер очередную порцию потока. Возвращает false, если текст закончился
+    bool ReadChunk();
+    // Разбирает текст, пока в буфере не появится хотя бы одна лексема
+    void FillBuffer();
+    void ProcessEof();
+    void PushToken(Token token);
+    // Добавляет лексему Id или String с текстом text: при разборе текста в памяти - ссылку на него,
+    // иначе - копию, хранимую вместе с лексемой
+    template <typename T>
+    void PushText(std::string_view text);
+    template <typename T>
+    void PushOwnedText(std::string text);
+    void ProcessNextToken();
+    void ProcessIndent();
     void ProcessNextLine();
-    void ProcessNum(std::istream &input);
+    void ProcessNum();
     void ProcessSymbol(char c);
     void ProcessComparisonOperator(char left, char right);
-    void ProcessWord(std::istream &input);
-    void ProcessKeyWord(const std::string &word);
-    void ProcessString(std::istream &input);
-    void IgnoreComment(std::istream &input);
+    void ProcessWord();
+    void ProcessString();
+    void IgnoreComment();
 
     bool IsComparisonOperator(char left, char right) const;
-    bool IsKeyWord(const std::string &word) const;
 
 private:
-    std::deque<Token> tokens_;
+    // Поток, из которого читается текст, либо nullptr, если весь текст находится в source_
+    std::istream *input_ = nullptr;
+    std::string chunk_;
+    // Разбираемый текст: source, переданный в конструктор, либо прочитанная из потока часть chunk_
+    std::string_view source_;
+    size_t pos_ = 0;
+    struct LocatedToken
+    {
+        Token token;
+        size_t line;
+        // Текст лексемы Id или String, которого нет в source_. Элементы deque не перемещаются,
+        // поэтому ссылка лексемы на этот текст действительна, пока лексема находится в буфере
+        std::string text{};
+    };
+
+    // Текущая лексема и следующие за ней уже прочитанные лексемы
+    std::deque<LocatedToken, memory::TrackingAllocator<LocatedToken, memory::Category::LexerTokens>> tokens_;
+    // Номер строки, которую разбирает лексер
+    size_t line_ = 1;
     size_t prev_indent = 0;
-    size_t current_pos = 0;
+    // Сведения о последней выданной лексеме, необходимые для вставки Newline
+    bool has_tokens_ = false;
+    bool last_is_newline_ = false;
+    bool last_is_dedent_ = false;
 };
 template <typename T>
 const T &Lexer::Expect() const
@@ -1,41 +1,203 @@
-#include "lexer.h"
-#include "parse.h"
-#include "runtime.h"
-#include "statement.h"
+#include "batch.h"
+#include "interpreter.h"
+#include "mapped_file.h"
+#include "memory_stats.h"
+#include "profiler.h"
+#include "serializer.h"
+#include <charconv>
 #include <iostream>
 #include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
 
-void RunMythonProgram(std::istream& input, std::ostream& output) {
-    parse::Lexer lexer(input);
-    auto program = ParseProgram(lexer);
+using namespace std::literals;
 
+// Если mem_stats истинно, по завершении программы выводит в cerr статистику памяти
+void RunMythonProgram(std::string_view source, std::ostream& output, const interpreter::Options& options,
+                      bool mem_stats = false) {
     runtime::SimpleContext context{output};
-    runtime::Closure closure;
-    program->Execute(closure, context);
+    // Образ, записанный --compile, загружается без разбора исходного текста
+    const interpreter::CompiledProgram program =
+        ast::IsProgramImage(source) ? interpreter::Load(source, options) : interpreter::Compile(source, options);
+    runtime::Closure globals;
+    interpreter::Run(program, context, globals);
+    if (mem_stats) {
+        // Дерево программы и её переменные ещё не освобождены
+        memory::WriteReport(std::cerr, memory::GetMemoryStats());
+    }
 }
 
 void PrintUsage() {
-    std::cerr << "Usage : mython <input_file> <output_file> \n";
+    std::cerr << "Usage : mython [--engine=tree|vm] [-O0|-O1] [--recursion-limit <depth>] [--step-limit <steps>] [--time-limit <ms>] [--profile <stacks_file>] [--mem-stats] [--alloc-histogram <histogram_file>] <input_file> <output_file> \n"
+                 "        mython [-O0|-O1] --compile <input_file> <image_file>\n"
+                 "        mython [--engine=tree|vm] [-O0|-O1] [--recursion-limit <depth>] [--step-limit <steps>] [--time-limit <ms>] --batch <manifest_file> [-j <threads>]\n";
+}
+
+// Исполняет задания из manifest_path параллельно и выводит отчёт. Код возврата 3 - часть заданий не выполнена
+int RunBatch(const char* manifest_path, size_t thread_count, const interpreter::Options& options) {
+    std::ifstream manifest(manifest_path);
+    if (!manifest.is_open()) {
+        std::cerr << "Failed to open manifest file: " << manifest_path << std::endl;
+        return 2;
+    }
+    std::vector<batch::Job> jobs;
+    try {
+        jobs = batch::ReadManifest(manifest);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    const auto results = batch::RunJobs(jobs, thread_count, [&options](std::string_view source, std::ostream& output) {
+        RunMythonProgram(source, output, options);
+    });
+    return batch::PrintReport(std::cout, jobs, results) == 0 ? 0 : 3;
 }
 
 int main(int argc, const char** argv) {
-    if(argc != 3){
+    interpreter::Options options;
+    const char* manifest_path = nullptr;
+    size_t thread_count = 0;
+    bool compile_only = false;
+    const char* profile_path = nullptr;
+    bool mem_stats = false;
+    const char* histogram_path = nullptr;
+    int arg_pos = 1;
+    for (; arg_pos < argc && argv[arg_pos][0] == '-'; ++arg_pos) {
+        std::string_view option(argv[arg_pos]);
+        if (option.substr(0, "--engine="sv.size()) == "--engine="sv) {
+            std::string_view name = option.substr("--engine="sv.size());
+            if (name == "vm"sv) {
+                options.engine = interpreter::Engine::Vm;
+            } else if (name != "tree"sv) {
+                PrintUsage();
+                return 1;
+            }
+        } else if (option == "-O0"sv) {
+            options.level = ast::OptimizationLevel::O0;
+        } else if (option == "-O1"sv) {
+            options.level = ast::OptimizationLevel::O1;
+        } else if (option == "--compile"sv) {
+            compile_only = true;
+        } else if (option == "--profile"sv && arg_pos + 1 < argc) {
+            profile_path = argv[++arg_pos];
+        } else if (option == "--mem-stats"sv) {
+            mem_stats = true;
+        } else if (option == "--alloc-histogram"sv && arg_pos + 1 < argc) {
+            histogram_path = argv[++arg_pos];
+        } else if (option == "--batch"sv && arg_pos + 1 < argc) {
+            manifest_path = argv[++arg_pos];
+        } else if (option == "--recursion-limit"sv && arg_pos + 1 < argc) {
+            std::string_view value(argv[++arg_pos]);
+            if (std::from_chars(value.data(), value.data() + value.size(), options.recursion_limit).ec != std::errc{}) {
+                PrintUsage();
+                return 1;
+            }
+        } else if (option == "--step-limit"sv && arg_pos + 1 < argc) {
+            std::string_view value(argv[++arg_pos]);
+            if (std::from_chars(value.data(), value.data() + value.size(), options.step_limit).ec != std::errc{}) {
+                PrintUsage();
+                return 1;
+            }
+        } else if (option == "--time-limit"sv && arg_pos + 1 < argc) {
+            std::string_view value(argv[++arg_pos]);
+            std::chrono::milliseconds::rep milliseconds = 0;
+            if (std::from_chars(value.data(), value.data() + value.size(), milliseconds).ec != std::errc{}) {
+                PrintUsage();
+                return 1;
+            }
+            options.time_limit = std::chrono::milliseconds(milliseconds);
+        } else if (option == "-j"sv && arg_pos + 1 < argc) {
+            std::string_view value(argv[++arg_pos]);
+            if (std::from_chars(value.data(), value.data() + value.size(), thread_count).ec != std::errc{}) {
+                PrintUsage();
+                return 1;
+            }
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    // Профилировщик поддерживает исполнение одной программы обходом дерева
+    if (profile_path != nullptr && (manifest_path != nullptr || compile_only || options.engine != interpreter::Engine::Tree)) {
+        PrintUsage();
+        return 1;
+    }
+    // Статистика памяти собирается для потока, исполняющего одну программу
+    if ((mem_stats || histogram_path != nullptr) && (manifest_path != nullptr || compile_only)) {
+        PrintUsage();
+        return 1;
+    }
+    if (manifest_path != nullptr) {
+        if (arg_pos != argc) {
+            PrintUsage();
+            return 1;
+        }
+        return RunBatch(manifest_path, thread_count, options);
+    }
+    if(argc - arg_pos != 2){
         PrintUsage();
         return 1;
     }
 
-    std::ifstream input_file(argv[1]);
-    if (!input_file.is_open())
+    std::optional<parse::MappedFile> input_file;
+    try
     {
-        std::cerr << "Failed to open input file: " << argv[1]  << std::endl;
+        input_file.emplace(argv[arg_pos]);
+    }
+    catch (const parse::MappedFileError&)
+    {
+        std::cerr << "Failed to open input file: " << argv[arg_pos]  << std::endl;
         return 2;
     }
-    std::ofstream output_file(argv[2]);
+    std::ofstream output_file(argv[arg_pos + 1], compile_only ? std::ios::binary : std::ios::out);
     if (!output_file.is_open())
     {
-        std::cerr << "Failed to open output_file: " << argv[2]  << std::endl;
+        std::cerr << "Failed to open output_file: " << argv[arg_pos + 1]  << std::endl;
         return 2;
     }
-    RunMythonProgram(input_file, output_file);
+    if (compile_only) {
+        try {
+            interpreter::Save(interpreter::Compile(input_file->GetData(), options), output_file);
+        } catch (const std::runtime_error& e) {
+            // Ошибки разбора и программы, которые нельзя сохранить в образ (ast::SerializationError)
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 3;
+        }
+        return 0;
+    }
+    ast::Profiler profiler;
+    if (profile_path != nullptr) {
+        options.profiler = &profiler;
+    }
+    std::ofstream histogram_file;
+    if (histogram_path != nullptr) {
+        histogram_file.open(histogram_path);
+        if (!histogram_file.is_open()) {
+            std::cerr << "Failed to open histogram file: " << histogram_path << std::endl;
+            return 2;
+        }
+        memory::SetAllocationTracing(true);
+    }
+    try {
+        RunMythonProgram(input_file->GetData(), output_file, options, mem_stats);
+    } catch (const std::runtime_error& e) {
+        // Ошибка программы (в том числе превышение глубины рекурсии) завершает интерпретатор с кодом 3
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 3;
+    }
+    if (histogram_path != nullptr) {
+        memory::SetAllocationTracing(false);
+        memory::WriteAllocationHistogram(histogram_file);
+    }
+    if (profile_path != nullptr) {
+        std::ofstream stacks_file(profile_path);
+        if (!stacks_file.is_open()) {
+            std::cerr << "Failed to open profile file: " << profile_path << std::endl;
+            return 2;
+        }
+        profiler.WriteCollapsedStacks(stacks_file);
+        profiler.WriteReport(std::cerr);
+    }
     return 0;
 }
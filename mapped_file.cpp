@@ -0,0 +1,107 @@
+#include "mapped_file.h"
+
+#if __has_include(<sys/mman.h>)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MYTHON_HAS_MMAP 1
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+using namespace std;
+
+namespace parse
+{
+
+#ifdef MYTHON_HAS_MMAP
+
+MappedFile::MappedFile(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw MappedFileError("Failed to open file: "s + path);
+    }
+    struct stat info
+    {
+    };
+    if (::fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        throw MappedFileError("Failed to stat file: "s + path);
+    }
+    // Канал, FIFO или устройство сообщают нулевой размер и не отображаются: их содержимое читается в память
+    if (!S_ISREG(info.st_mode))
+    {
+        char chunk[64 * 1024];
+        ssize_t count = 0;
+        while ((count = ::read(fd, chunk, sizeof(chunk))) != 0)
+        {
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                ::close(fd);
+                throw MappedFileError("Failed to read file: "s + path);
+            }
+            buffer_.append(chunk, static_cast<size_t>(count));
+        }
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        ::close(fd);
+        return;
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    // Пустой файл отобразить нельзя, ему соответствует пустой буфер
+    if (size_ != 0)
+    {
+        void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            throw MappedFileError("Failed to map file: "s + path);
+        }
+        ::madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(data);
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        ::munmap(const_cast<char *>(data_), size_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path)
+{
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open())
+    {
+        throw MappedFileError("Failed to open file: "s + path);
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
+
+std::string_view MappedFile::GetData() const
+{
+    return {data_, size_};
+}
+
+} // namespace parse
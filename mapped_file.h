@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace parse
+{
+
+class MappedFileError : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/*
+ * Файл, отображённый в память только для чтения. Содержимое доступно как непрерывный буфер
+ * и может передаваться в Lexer без копирования.
+ * Каналы, FIFO и устройства, а также файлы на платформах без mmap целиком читаются в память
+ */
+class MappedFile
+{
+public:
+    // Выбрасывает MappedFileError, если файл не удалось открыть или отобразить
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    [[nodiscard]] std::string_view GetData() const;
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    // Содержимое файла, если отображение в память недоступно
+    std::string buffer_;
+};
+
+} // namespace parse
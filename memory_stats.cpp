@@ -0,0 +1,128 @@
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace memory
+{
+
+namespace
+{
+// Число выделений по месту выделения (категория, размер блока)
+struct Histogram
+{
+    mutex lock;
+    map<pair<Category, size_t>, size_t> counts;
+};
+
+Histogram &GetHistogram()
+{
+    // Не разрушается: блоки освобождаются и при разрушении статических объектов
+    static auto *histogram = new Histogram;
+    return *histogram;
+}
+} // namespace
+
+void detail::Trace(Category category, size_t bytes)
+{
+    Histogram &histogram = GetHistogram();
+    lock_guard guard(histogram.lock);
+    ++histogram.counts[{category, bytes}];
+}
+
+string_view GetCategoryName(Category category)
+{
+    switch (category)
+    {
+    case Category::AstNodes:
+        return "ast nodes"sv;
+    case Category::Strings:
+        return "strings"sv;
+    case Category::Classes:
+        return "classes"sv;
+    case Category::Instances:
+        return "instances"sv;
+    case Category::OtherObjects:
+        return "other objects"sv;
+    case Category::StringText:
+        return "string text"sv;
+    case Category::InstanceFields:
+        return "instance fields"sv;
+    case Category::Closures:
+        return "closures"sv;
+    case Category::LexerTokens:
+        return "lexer tokens"sv;
+    }
+    return "unknown"sv;
+}
+
+MemoryStats GetMemoryStats()
+{
+    return MemoryStats{detail::thread_usage};
+}
+
+void ResetPeaks()
+{
+    for (Usage &usage : detail::thread_usage)
+    {
+        usage.peak_count = usage.live_count;
+        usage.peak_bytes = usage.live_bytes;
+    }
+}
+
+void SetAllocationTracing(bool enabled)
+{
+    if (enabled)
+    {
+        Histogram &histogram = GetHistogram();
+        lock_guard guard(histogram.lock);
+        histogram.counts.clear();
+    }
+    detail::tracing.store(enabled, memory_order_relaxed);
+}
+
+void WriteAllocationHistogram(ostream &output)
+{
+    vector<pair<pair<Category, size_t>, size_t>> sites;
+    {
+        Histogram &histogram = GetHistogram();
+        lock_guard guard(histogram.lock);
+        sites.assign(histogram.counts.begin(), histogram.counts.end());
+    }
+    stable_sort(sites.begin(), sites.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.first.second * lhs.second > rhs.first.second * rhs.second;
+    });
+    for (const auto &[site, count] : sites)
+    {
+        output << GetCategoryName(site.first) << ' ' << site.second << ' ' << count << ' ' << site.second * count
+               << '\n';
+    }
+}
+
+void WriteReport(ostream &output, const MemoryStats &stats)
+{
+    output << left << setw(18) << "category" << right << setw(14) << "live objects" << setw(14) << "live bytes"
+           << setw(14) << "peak objects" << setw(14) << "peak bytes" << setw(14) << "allocations" << '\n';
+    Usage total;
+    for (size_t i = 0; i < CATEGORY_COUNT; ++i)
+    {
+        const Usage &usage = stats.categories[i];
+        output << left << setw(18) << GetCategoryName(static_cast<Category>(i)) << right << setw(14)
+               << usage.live_count << setw(14) << usage.live_bytes << setw(14) << usage.peak_count << setw(14)
+               << usage.peak_bytes << setw(14) << usage.allocations << '\n';
+        total.live_count += usage.live_count;
+        total.live_bytes += usage.live_bytes;
+        total.allocations += usage.allocations;
+    }
+    output << left << setw(18) << "total" << right << setw(14) << total.live_count << setw(14) << total.live_bytes
+           << setw(28) << "" << setw(14) << total.allocations << '\n';
+}
+
+} // namespace memory
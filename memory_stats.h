@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+
+namespace memory
+{
+
+// Категория учитываемой памяти
+enum class Category : uint8_t
+{
+    // Узлы синтаксического дерева (ast::Statement)
+    AstNodes,
+    // Блоки объектов runtime в куче (заголовок со счётчиком ссылок и объект) по видам объектов
+    Strings,
+    Classes,
+    Instances,
+    OtherObjects,
+    // Текст строк runtime::String, не поместившийся внутрь std::string
+    StringText,
+    // Массивы значений полей экземпляров классов (runtime::FieldTable)
+    InstanceFields,
+    // Узлы и массивы корзин словарей runtime::Closure и слоты кадров методов
+    Closures,
+    // Очередь прочитанных лексем parse::Lexer
+    LexerTokens,
+};
+
+constexpr size_t CATEGORY_COUNT = static_cast<size_t>(Category::LexerTokens) + 1;
+
+[[nodiscard]] std::string_view GetCategoryName(Category category);
+
+struct Usage
+{
+    // Существующие блоки и их суммарный размер
+    size_t live_count = 0;
+    size_t live_bytes = 0;
+    // Наибольшие значения live_count и live_bytes
+    size_t peak_count = 0;
+    size_t peak_bytes = 0;
+    // Количество выделений
+    size_t allocations = 0;
+};
+
+struct MemoryStats
+{
+    std::array<Usage, CATEGORY_COUNT> categories{};
+
+    [[nodiscard]] const Usage &operator[](Category category) const
+    {
+        return categories[static_cast<size_t>(category)];
+    }
+};
+
+/*
+ * Статистика памяти текущего потока. Блок, освобождённый в другом потоке (например, узел общего
+ * дерева программы), учитывается освободившим его потоком
+ */
+[[nodiscard]] MemoryStats GetMemoryStats();
+
+// Приравнивает наибольшие значения текущего потока текущим
+void ResetPeaks();
+
+namespace detail
+{
+inline thread_local std::array<Usage, CATEGORY_COUNT> thread_usage{};
+inline std::atomic<bool> tracing = false;
+
+void Trace(Category category, size_t bytes);
+} // namespace detail
+
+// Учитывают выделение и освобождение блока размером bytes в статистике текущего потока
+inline void OnAllocate(Category category, size_t bytes)
+{
+    Usage &usage = detail::thread_usage[static_cast<size_t>(category)];
+    ++usage.allocations;
+    usage.peak_count = std::max(usage.peak_count, ++usage.live_count);
+    usage.peak_bytes = std::max(usage.peak_bytes, usage.live_bytes += bytes);
+    if (detail::tracing.load(std::memory_order_relaxed))
+    {
+        detail::Trace(category, bytes);
+    }
+}
+
+inline void OnDeallocate(Category category, size_t bytes)
+{
+    Usage &usage = detail::thread_usage[static_cast<size_t>(category)];
+    --usage.live_count;
+    usage.live_bytes -= bytes;
+}
+
+/*
+ * Трассировка выделений во всех потоках: количество выделений по местам выделения - категории и размеру
+ * блока (размер узла дерева обычно определяет вид узла). Включение очищает накопленную гистограмму.
+ * Запись каждого выделения захватывает мьютекс, поэтому трассировка замедляет исполнение
+ */
+void SetAllocationTracing(bool enabled);
+
+// Выводит гистограмму трассировки строками «категория размер количество байты» по убыванию байтов
+void WriteAllocationHistogram(std::ostream &output);
+
+// Выводит таблицу статистики по категориям
+void WriteReport(std::ostream &output, const MemoryStats &stats);
+
+// Распределитель памяти контейнеров, учитывающий выделенные блоки в категории C
+template <typename T, Category C>
+class TrackingAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = TrackingAllocator<U, C>;
+    };
+
+    TrackingAllocator() noexcept = default;
+
+    template <typename U>
+    TrackingAllocator([[maybe_unused]] const TrackingAllocator<U, C> &other) noexcept
+    {
+    }
+
+    [[nodiscard]] T *allocate(size_t n)
+    {
+        T *block = std::allocator<T>().allocate(n);
+        OnAllocate(C, n * sizeof(T));
+        return block;
+    }
+
+    void deallocate(T *block, size_t n) noexcept
+    {
+        OnDeallocate(C, n * sizeof(T));
+        std::allocator<T>().deallocate(block, n);
+    }
+
+    template <typename U>
+    bool operator==([[maybe_unused]] const TrackingAllocator<U, C> &other) const noexcept
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=([[maybe_unused]] const TrackingAllocator<U, C> &other) const noexcept
+    {
+        return false;
+    }
+};
+
+} // namespace memory
@@ -0,0 +1,177 @@
+#include "optimizer.h"
+
+#include "statement.h"
+
+#include <vector>
+
+namespace ast
+{
+
+using runtime::ObjectHolder;
+
+namespace
+{
+
+bool IsConstant(const Statement &node)
+{
+    return dynamic_cast<const NumericConst *>(&node) != nullptr ||
+           dynamic_cast<const StringConst *>(&node) != nullptr ||
+           dynamic_cast<const BoolConst *>(&node) != nullptr || dynamic_cast<const None *>(&node) != nullptr;
+}
+
+// Создаёт константу со значением value либо возвращает nullptr, если значение не выразимо константой
+std::unique_ptr<Statement> MakeConstant(const ObjectHolder &value)
+{
+    switch (value.GetKind())
+    {
+    case runtime::ObjectKind::None:
+        return std::make_unique<None>();
+    case runtime::ObjectKind::Number:
+        return std::make_unique<NumericConst>(*value.TryAs<runtime::Number>());
+    case runtime::ObjectKind::String:
+        return std::make_unique<StringConst>(*value.TryAs<runtime::String>());
+    case runtime::ObjectKind::Bool:
+        return std::make_unique<BoolConst>(*value.TryAs<runtime::Bool>());
+    default:
+        return nullptr;
+    }
+}
+
+// Значение константы вычисляется без переменных и вывода
+ObjectHolder Evaluate(Statement &node)
+{
+    runtime::Closure closure;
+    runtime::DummyContext context;
+    return node.Execute(closure, context);
+}
+
+std::vector<std::unique_ptr<Statement> *> GetChildren(Statement &node)
+{
+    std::vector<std::unique_ptr<Statement> *> children;
+    node.ForEachChild([&children](std::unique_ptr<Statement> &child) { children.push_back(&child); });
+    return children;
+}
+
+bool IsFoldableOperation(const Statement &node)
+{
+    return dynamic_cast<const Add *>(&node) != nullptr || dynamic_cast<const Sub *>(&node) != nullptr ||
+           dynamic_cast<const Mult *>(&node) != nullptr || dynamic_cast<const Div *>(&node) != nullptr ||
+           dynamic_cast<const Comparison *>(&node) != nullptr || dynamic_cast<const Not *>(&node) != nullptr ||
+           dynamic_cast<const Stringify *>(&node) != nullptr;
+}
+
+class Optimizer
+{
+public:
+    const OptimizationStats &GetStats() const
+    {
+        return stats_;
+    }
+
+    void Visit(std::unique_ptr<Statement> &node)
+    {
+        node->ForEachChild([this](std::unique_ptr<Statement> &child) { Visit(child); });
+
+        if (dynamic_cast<IfElse *>(node.get()) != nullptr)
+        {
+            PruneIfElse(node);
+        }
+        else if (CanFold(*node))
+        {
+            Fold(node);
+        }
+    }
+
+private:
+    static bool CanFold(Statement &node)
+    {
+        const auto children = GetChildren(node);
+        const bool is_or = dynamic_cast<Or *>(&node) != nullptr;
+        if (is_or || dynamic_cast<And *>(&node) != nullptr)
+        {
+            // Если левый операнд определяет результат, правый не вычисляется и может быть любым
+            Statement &lhs = **children[0];
+            if (!IsConstant(lhs))
+            {
+                return false;
+            }
+            const bool lhs_value = runtime::IsTrue(Evaluate(lhs));
+            return lhs_value == is_or || IsConstant(**children[1]);
+        }
+        if (!IsFoldableOperation(node))
+        {
+            return false;
+        }
+        for (const auto *child : children)
+        {
+            if (!IsConstant(**child))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Fold(std::unique_ptr<Statement> &node)
+    {
+        ObjectHolder value;
+        try
+        {
+            value = Evaluate(*node);
+        }
+        catch (const std::exception &)
+        {
+            return;
+        }
+        if (auto constant = MakeConstant(value))
+        {
+            constant->SetLine(node->GetLine());
+            node = std::move(constant);
+            ++stats_.folded_expressions;
+        }
+    }
+
+    // Дочерние узлы IfElse: условие, ветка if и, если есть, ветка else
+    void PruneIfElse(std::unique_ptr<Statement> &node)
+    {
+        const auto children = GetChildren(*node);
+        Statement &condition = **children[0];
+        if (!IsConstant(condition))
+        {
+            return;
+        }
+        std::unique_ptr<Statement> branch;
+        if (runtime::IsTrue(Evaluate(condition)))
+        {
+            branch = std::move(*children[1]);
+        }
+        else if (children.size() > 2)
+        {
+            branch = std::move(*children[2]);
+        }
+        else
+        {
+            branch = std::make_unique<None>();
+            branch->SetLine(node->GetLine());
+        }
+        node = std::move(branch);
+        ++stats_.pruned_branches;
+    }
+
+    OptimizationStats stats_;
+};
+
+} // namespace
+
+OptimizationStats Optimize(std::unique_ptr<Statement> &program, OptimizationLevel level)
+{
+    if (level == OptimizationLevel::O0)
+    {
+        return {};
+    }
+    Optimizer optimizer;
+    optimizer.Visit(program);
+    return optimizer.GetStats();
+}
+
+} // namespace ast
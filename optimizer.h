@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace ast
+{
+
+class Statement;
+
+enum class OptimizationLevel
+{
+    // Дерево исполняется в том виде, в котором его построил ParseProgram
+    O0,
+    // Свёртка константных выражений и удаление недостижимых веток if
+    O1,
+};
+
+struct OptimizationStats
+{
+    // Количество выражений, заменённых константой
+    size_t folded_expressions = 0;
+    // Количество инструкций if, условие которых известно до исполнения
+    size_t pruned_branches = 0;
+};
+
+/*
+ * Упрощает дерево программы, полученное из ParseProgram, включая тела методов объявленных классов.
+ * Выражения Add, Sub, Mult, Div, Comparison, And, Or, Not и Stringify, операнды которых - константы,
+ * вычисляются заранее и заменяются константой. Выражение, вычисление которого завершается ошибкой
+ * (например, деление на ноль), остаётся в дереве, чтобы ошибка возникла при исполнении.
+ * Инструкция if с константным условием заменяется исполняемой веткой
+ */
+OptimizationStats Optimize(std::unique_ptr<Statement> &program, OptimizationLevel level);
+
+} // namespace ast
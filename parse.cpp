@@ -3,6 +3,9 @@
 #include "lexer.h"
 #include "statement.h"
 
+#include <unordered_map>
+#include <vector>
+
 using namespace std;
 
 namespace TokenType = parse::token_type;
@@ -19,8 +22,8 @@ bool operator!=(const parse::Token& token, char c) {
 
 class Parser {
 public:
-    explicit Parser(parse::Lexer& lexer)
-        : lexer_(lexer) {
+    Parser(parse::Lexer& lexer, runtime::Closure& declared_classes)
+        : lexer_(lexer), declared_classes_(declared_classes) {
     }
 
     unique_ptr<ast::Statement> ParseProgram() {
@@ -33,6 +36,37 @@ public:
     }
 
 private:
+    // Локальные переменные разбираемого метода. Каждое новое имя получает следующий номер слота
+    struct Scope {
+        unordered_map<string, size_t> slots;
+        vector<string> names;
+
+        size_t Declare(const string& name) {
+            slots[name] = names.size();
+            names.push_back(name);
+            return names.size() - 1;
+        }
+    };
+
+    // Возвращает номер слота переменной текущего метода либо NO_SLOT на верхнем уровне программы,
+    // где переменные хранятся в словаре по имени
+    size_t ResolveSlot(const string& name) {
+        if (scopes_.empty()) {
+            return ast::NO_SLOT;
+        }
+        Scope& scope = scopes_.back();
+        if (auto it = scope.slots.find(name); it != scope.slots.end()) {
+            return it->second;
+        }
+        return scope.Declare(name);
+    }
+
+    ast::VariableValue MakeVariable(vector<string> dotted_ids) {
+        ast::VariableValue result{std::move(dotted_ids)};
+        result.BindSlot(ResolveSlot(result.GetName()));
+        return result;
+    }
+
     unique_ptr<ast::Statement> ParseSuite()  
     {
         lexer_.Expect<TokenType::Newline>();
@@ -57,14 +91,15 @@ private:
 
         while (lexer_.CurrentToken().Is<TokenType::Def>()) {
             runtime::Method m;
+            const auto def_line = static_cast<uint32_t>(lexer_.CurrentLine());
 
-            m.name = lexer_.ExpectNext<TokenType::Id>().value;
+            m.name = string(lexer_.ExpectNext<TokenType::Id>().value);
             lexer_.ExpectNext<TokenType::Char>('(');
 
             if (lexer_.NextToken().Is<TokenType::Id>()) {
-                m.formal_params.push_back(lexer_.Expect<TokenType::Id>().value);
+                m.formal_params.emplace_back(lexer_.Expect<TokenType::Id>().value);
                 while (lexer_.NextToken() == ',') {
-                    m.formal_params.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+                    m.formal_params.emplace_back(lexer_.ExpectNext<TokenType::Id>().value);
                 }
             }
 
@@ -72,7 +107,19 @@ private:
             lexer_.ExpectNext<TokenType::Char>(':');
             lexer_.NextToken();
 
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());  
+            // Слот 0 - self, затем формальные параметры в порядке объявления
+            Scope& scope = scopes_.emplace_back();
+            scope.Declare("self"s);
+            for (const auto& param : m.formal_params) {
+                scope.Declare(param);
+            }
+            auto suite = ParseSuite();
+            suite->SetLine(def_line);
+            auto body = std::make_unique<ast::MethodBody>(std::move(suite));
+            body->SetLine(def_line);
+            m.body = std::move(body);
+            m.slot_names = std::move(scopes_.back().names);
+            scopes_.pop_back();
 
             result.push_back(std::move(m));
         }
@@ -81,13 +128,13 @@ private:
 
     unique_ptr<ast::Statement> ParseClassDefinition()  
     {
-        string class_name = lexer_.Expect<TokenType::Id>().value;
+        string class_name(lexer_.Expect<TokenType::Id>().value);
 
         lexer_.NextToken();
 
         const runtime::Class* base_class = nullptr;
         if (lexer_.CurrentToken() == '(') {
-            auto name = lexer_.ExpectNext<TokenType::Id>().value;
+            string name(lexer_.ExpectNext<TokenType::Id>().value);
             lexer_.ExpectNext<TokenType::Char>(')');
             lexer_.NextToken();
 
@@ -116,14 +163,16 @@ private:
             throw ParseError("Class "s + class_name + " already exists"s);
         }
 
-        return make_unique<ast::ClassDefinition>(it->second);
+        auto result = make_unique<ast::ClassDefinition>(it->second);
+        result->BindSlot(ResolveSlot(class_name));
+        return result;
     }
 
     vector<string> ParseDottedIds() {
-        vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
+        vector<string> result(1, string(lexer_.Expect<TokenType::Id>().value));
 
         while (lexer_.NextToken() == '.') {
-            result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+            result.emplace_back(lexer_.ExpectNext<TokenType::Id>().value);
         }
 
         return result;
@@ -141,10 +190,14 @@ private:
             lexer_.NextToken();
 
             if (id_list.empty()) {
-                return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                const size_t slot = ResolveSlot(last_name);
+                auto result = make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                result->BindSlot(slot);
+                return result;
             }
-            return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
-                                                     std::move(last_name), ParseTest());
+            auto object = MakeVariable(std::move(id_list));
+            return make_unique<ast::FieldAssignment>(std::move(object), std::move(last_name),
+                                                     ParseTest());
         }
         lexer_.Expect<TokenType::Char>('(');
         lexer_.NextToken();
@@ -160,8 +213,9 @@ private:
         lexer_.Expect<TokenType::Char>(')');
         lexer_.NextToken();
 
-        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
-                                            std::move(last_name), std::move(args));
+        return make_unique<ast::MethodCall>(
+            make_unique<ast::VariableValue>(MakeVariable(std::move(id_list))), std::move(last_name),
+            std::move(args));
     }
 
     unique_ptr<ast::Statement> ParseExpression() 
@@ -215,7 +269,7 @@ private:
             return make_unique<ast::NumericConst>(result);
         }
         if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
-            string result = str->value;
+            string result(str->value);
             lexer_.NextToken();
             return make_unique<ast::StringConst>(std::move(result));
         }
@@ -252,8 +306,8 @@ private:
 
             if (!names.empty()) {
                 return make_unique<ast::MethodCall>(
-                    make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
-                    std::move(args));
+                    make_unique<ast::VariableValue>(MakeVariable(std::move(names))),
+                    std::move(method_name), std::move(args));
             }
             if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
                 return make_unique<ast::NewInstance>(
@@ -267,7 +321,7 @@ private:
             }
             throw ParseError("Unknown call to "s + method_name + "()"s);
         }
-        return make_unique<ast::VariableValue>(std::move(names));
+        return make_unique<ast::VariableValue>(MakeVariable(std::move(names)));
     }
 
     vector<unique_ptr<ast::Statement>> ParseTestList()  
@@ -342,38 +396,50 @@ private:
 
         if (tok == '<') {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Less, std::move(result),
-                                                ParseExpression());
+            return make_unique<ast::StaticComparison<ast::ComparisonOp::Less>>(std::move(result), ParseExpression());
         }
         if (tok == '>') {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
-                                                ParseExpression());
+            return make_unique<ast::StaticComparison<ast::ComparisonOp::Greater>>(std::move(result), ParseExpression());
         }
         if (tok.Is<TokenType::Eq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
-                                                ParseExpression());
+            return make_unique<ast::StaticComparison<ast::ComparisonOp::Equal>>(std::move(result), ParseExpression());
         }
         if (tok.Is<TokenType::NotEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
-                                                ParseExpression());
+            return make_unique<ast::StaticComparison<ast::ComparisonOp::NotEqual>>(std::move(result), ParseExpression());
         }
         if (tok.Is<TokenType::LessOrEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
-                                                ParseExpression());
+            return make_unique<ast::StaticComparison<ast::ComparisonOp::LessOrEqual>>(std::move(result), ParseExpression());
         }
         if (tok.Is<TokenType::GreaterOrEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
-                                                ParseExpression());
+            return make_unique<ast::StaticComparison<ast::ComparisonOp::GreaterOrEqual>>(std::move(result), ParseExpression());
         }
         return result;
     }
 
-    unique_ptr<ast::Statement> ParseStatement()  
+    // Узлы инструкции, строка которых не задана вложенными инструкциями, получают строку начала инструкции
+    unique_ptr<ast::Statement> ParseStatement() {
+        const auto line = static_cast<uint32_t>(lexer_.CurrentLine());
+        auto result = ParseStatementNodes();
+        AssignLine(result, line);
+        return result;
+    }
+
+    static void AssignLine(unique_ptr<ast::Statement>& node, uint32_t line) {
+        if (node->GetLine() != 0) {
+            return;
+        }
+        node->SetLine(line);
+        node->ForEachChild([line](unique_ptr<ast::Statement>& child) {
+            AssignLine(child, line);
+        });
+    }
+
+    unique_ptr<ast::Statement> ParseStatementNodes()  
     {
         const auto& tok = lexer_.CurrentToken();
 
@@ -409,11 +475,22 @@ private:
     }
 
     parse::Lexer& lexer_;
-    runtime::Closure declared_classes_;
+    runtime::Closure& declared_classes_;
+    vector<Scope> scopes_;
 };
 
 }  // namespace
 
-unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
+unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer) {
+    runtime::Closure declared_classes;
+    return ParseProgram(lexer, declared_classes);
+}
+
+unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer, runtime::Closure& declared_classes) {
+    // Все узлы программы размещаются в одной арене и освобождаются вместе с последним из них
+    if (ast::Arena::Active() != nullptr) {
+        return Parser{lexer, declared_classes}.ParseProgram();
+    }
+    ast::ArenaScope arena;
+    return Parser{lexer, declared_classes}.ParseProgram();
 }
\ No newline at end of file
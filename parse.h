@@ -7,12 +7,21 @@ namespace parse {
 class Lexer;
 }
 
+namespace ast {
+class Statement;
+}
+
 namespace runtime {
-class Executable;
+class Closure;
 }
 
 struct ParseError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+std::unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer);
+
+// Классы из declared_classes (имя - класс) объявлены до начала программы:
+// она может создавать их экземпляры и наследовать от них. Классы программы добавляются в declared_classes.
+// Узлы дерева размещаются в новой арене, а если вызывающий открыл ast::ArenaScope, - в его арене
+std::unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer, runtime::Closure& declared_classes);
\ No newline at end of file
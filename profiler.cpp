@@ -0,0 +1,376 @@
+#include "profiler.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+
+namespace ast
+{
+
+namespace
+{
+using runtime::Closure;
+using runtime::Context;
+using runtime::ObjectHolder;
+
+string_view NodeKind(const Statement &node)
+{
+    if (dynamic_cast<const NumericConst *>(&node) != nullptr)
+    {
+        return "NumericConst"sv;
+    }
+    if (dynamic_cast<const StringConst *>(&node) != nullptr)
+    {
+        return "StringConst"sv;
+    }
+    if (dynamic_cast<const BoolConst *>(&node) != nullptr)
+    {
+        return "BoolConst"sv;
+    }
+    if (dynamic_cast<const None *>(&node) != nullptr)
+    {
+        return "None"sv;
+    }
+    if (dynamic_cast<const VariableValue *>(&node) != nullptr)
+    {
+        return "VariableValue"sv;
+    }
+    if (dynamic_cast<const Assignment *>(&node) != nullptr)
+    {
+        return "Assignment"sv;
+    }
+    if (dynamic_cast<const FieldAssignment *>(&node) != nullptr)
+    {
+        return "FieldAssignment"sv;
+    }
+    if (dynamic_cast<const Print *>(&node) != nullptr)
+    {
+        return "Print"sv;
+    }
+    if (dynamic_cast<const MethodCall *>(&node) != nullptr)
+    {
+        return "MethodCall"sv;
+    }
+    if (dynamic_cast<const NewInstance *>(&node) != nullptr)
+    {
+        return "NewInstance"sv;
+    }
+    if (dynamic_cast<const Stringify *>(&node) != nullptr)
+    {
+        return "Stringify"sv;
+    }
+    if (dynamic_cast<const Not *>(&node) != nullptr)
+    {
+        return "Not"sv;
+    }
+    if (dynamic_cast<const Add *>(&node) != nullptr)
+    {
+        return "Add"sv;
+    }
+    if (dynamic_cast<const Sub *>(&node) != nullptr)
+    {
+        return "Sub"sv;
+    }
+    if (dynamic_cast<const Mult *>(&node) != nullptr)
+    {
+        return "Mult"sv;
+    }
+    if (dynamic_cast<const Div *>(&node) != nullptr)
+    {
+        return "Div"sv;
+    }
+    if (dynamic_cast<const Or *>(&node) != nullptr)
+    {
+        return "Or"sv;
+    }
+    if (dynamic_cast<const And *>(&node) != nullptr)
+    {
+        return "And"sv;
+    }
+    if (dynamic_cast<const Comparison *>(&node) != nullptr)
+    {
+        return "Comparison"sv;
+    }
+    if (dynamic_cast<const Compound *>(&node) != nullptr)
+    {
+        return "Compound"sv;
+    }
+    if (dynamic_cast<const MethodBody *>(&node) != nullptr)
+    {
+        return "MethodBody"sv;
+    }
+    if (dynamic_cast<const Return *>(&node) != nullptr)
+    {
+        return "Return"sv;
+    }
+    if (dynamic_cast<const ClassDefinition *>(&node) != nullptr)
+    {
+        return "ClassDefinition"sv;
+    }
+    if (dynamic_cast<const IfElse *>(&node) != nullptr)
+    {
+        return "IfElse"sv;
+    }
+    return "Statement"sv;
+}
+
+// Учитывает исполнение узла, в том числе завершившееся исключением
+class NodeTimer
+{
+public:
+    explicit NodeTimer(Profiler::NodeProfile &profile) : profile_(profile)
+    {
+        ++profile_.depth;
+    }
+
+    ~NodeTimer()
+    {
+        ++profile_.count;
+        if (--profile_.depth == 0)
+        {
+            profile_.total += Profiler::Clock::now() - start_;
+        }
+    }
+
+    NodeTimer(const NodeTimer &) = delete;
+    NodeTimer &operator=(const NodeTimer &) = delete;
+
+private:
+    Profiler::NodeProfile &profile_;
+    Profiler::Clock::time_point start_ = Profiler::Clock::now();
+};
+
+class FrameScope
+{
+public:
+    FrameScope(Profiler &profiler, Profiler::FrameProfile &frame) : profiler_(profiler), frame_(frame)
+    {
+        profiler_.EnterFrame(frame_);
+    }
+
+    ~FrameScope()
+    {
+        profiler_.LeaveFrame(frame_);
+    }
+
+    FrameScope(const FrameScope &) = delete;
+    FrameScope &operator=(const FrameScope &) = delete;
+
+private:
+    Profiler &profiler_;
+    Profiler::FrameProfile &frame_;
+};
+
+// Обёртка, ведущая счётчики исполнений узла
+class ProfiledNode : public Statement
+{
+public:
+    ProfiledNode(std::unique_ptr<Statement> node, Profiler::NodeProfile &profile)
+        : node_(std::move(node)), profile_(profile)
+    {
+        SetLine(node_->GetLine());
+    }
+
+    ObjectHolder Execute(Closure &closure, Context &context) override
+    {
+        NodeTimer timer(profile_);
+        return node_->Execute(closure, context);
+    }
+
+    Completion Run(Closure &closure, Context &context, ObjectHolder &result) override
+    {
+        NodeTimer timer(profile_);
+        return node_->Run(closure, context, result);
+    }
+
+    // Хвостовой вызов обёрнутого узла планируется так же, как без профилировщика
+    bool PrepareTailCall(Closure &closure, Context &context, runtime::TailCall &tail_call,
+                         ObjectHolder &result) override
+    {
+        NodeTimer timer(profile_);
+        return node_->PrepareTailCall(closure, context, tail_call, result);
+    }
+
+    void ForEachChild(const ChildVisitor &visitor) override
+    {
+        visitor(node_);
+    }
+
+private:
+    std::unique_ptr<Statement> node_;
+    Profiler::NodeProfile &profile_;
+};
+
+// Обёртка тела метода либо программы, образующая кадр стека вызовов
+class ProfiledFrame : public Statement
+{
+public:
+    ProfiledFrame(std::unique_ptr<Statement> node, Profiler &profiler, Profiler::FrameProfile &frame)
+        : node_(std::move(node)), profiler_(profiler), frame_(frame)
+    {
+        SetLine(node_->GetLine());
+    }
+
+    ObjectHolder Execute(Closure &closure, Context &context) override
+    {
+        FrameScope scope(profiler_, frame_);
+        return node_->Execute(closure, context);
+    }
+
+    Completion Run(Closure &closure, Context &context, ObjectHolder &result) override
+    {
+        FrameScope scope(profiler_, frame_);
+        return node_->Run(closure, context, result);
+    }
+
+    void ForEachChild(const ChildVisitor &visitor) override
+    {
+        visitor(node_);
+    }
+
+private:
+    std::unique_ptr<Statement> node_;
+    Profiler &profiler_;
+    Profiler::FrameProfile &frame_;
+};
+
+double ToMilliseconds(Profiler::Clock::duration duration)
+{
+    return chrono::duration<double, milli>(duration).count();
+}
+
+// Упорядочивает счётчики по убыванию времени, при равенстве - по номеру строки
+template <typename Profile>
+vector<const Profile *> SortByTime(const deque<Profile> &profiles)
+{
+    vector<const Profile *> result;
+    for (const Profile &profile : profiles)
+    {
+        if (profile.count != 0)
+        {
+            result.push_back(&profile);
+        }
+    }
+    sort(result.begin(), result.end(), [](const Profile *lhs, const Profile *rhs) {
+        return lhs->total != rhs->total ? lhs->total > rhs->total : lhs->line < rhs->line;
+    });
+    return result;
+}
+} // namespace
+
+void Profiler::Instrument(std::unique_ptr<Statement> &program)
+{
+    InstrumentFrame(program, "<module>"s, program->GetLine());
+}
+
+void Profiler::InstrumentNode(std::unique_ptr<Statement> &node)
+{
+    if (auto class_def = dynamic_cast<ClassDefinition *>(node.get()))
+    {
+        // Тело каждого метода образует отдельный кадр
+        const runtime::Class &cls = *class_def->GetClass().TryAs<runtime::Class>();
+        for (const runtime::Method &method : cls.GetMethods())
+        {
+            if (auto body = dynamic_cast<MethodBody *>(method.body.get()))
+            {
+                const string name = cls.GetName() + "."s + method.name;
+                body->ForEachChild(
+                    [this, &name, body](std::unique_ptr<Statement> &child) { InstrumentFrame(child, name, body->GetLine()); });
+            }
+        }
+    }
+    else
+    {
+        node->ForEachChild([this](std::unique_ptr<Statement> &child) { InstrumentNode(child); });
+    }
+
+    NodeProfile &profile = nodes_.emplace_back();
+    profile.kind = NodeKind(*node);
+    profile.line = node->GetLine();
+    node = std::make_unique<ProfiledNode>(std::move(node), profile);
+}
+
+void Profiler::InstrumentFrame(std::unique_ptr<Statement> &node, std::string name, uint32_t line)
+{
+    InstrumentNode(node);
+    FrameProfile &frame = frames_.emplace_back();
+    frame.name = std::move(name);
+    frame.line = line;
+    node = std::make_unique<ProfiledFrame>(std::move(node), *this, frame);
+}
+
+const std::deque<Profiler::NodeProfile> &Profiler::GetNodes() const
+{
+    return nodes_;
+}
+
+const std::deque<Profiler::FrameProfile> &Profiler::GetFrames() const
+{
+    return frames_;
+}
+
+void Profiler::EnterFrame(FrameProfile &frame)
+{
+    ++frame.depth;
+    active_frames_.push_back(ActiveFrame{path_.size(), Clock::now()});
+    if (!path_.empty())
+    {
+        path_ += ';';
+    }
+    path_ += frame.name;
+}
+
+void Profiler::LeaveFrame(FrameProfile &frame)
+{
+    const ActiveFrame active = active_frames_.back();
+    const Clock::duration elapsed = Clock::now() - active.start;
+    // Собственное время кадра - время исполнения за вычетом вложенных вызовов
+    stacks_[path_] += elapsed - active.children;
+    path_.resize(active.path_size);
+    active_frames_.pop_back();
+    if (!active_frames_.empty())
+    {
+        active_frames_.back().children += elapsed;
+    }
+    ++frame.count;
+    if (--frame.depth == 0)
+    {
+        frame.total += elapsed;
+    }
+}
+
+void Profiler::WriteReport(std::ostream &output) const
+{
+    output << fixed << setprecision(3);
+    output << setw(10) << "calls" << setw(12) << "total ms" << setw(8) << "line"
+           << "  method\n";
+    for (const FrameProfile *frame : SortByTime(frames_))
+    {
+        output << setw(10) << frame->count << setw(12) << ToMilliseconds(frame->total) << setw(8) << frame->line << "  "
+               << frame->name << '\n';
+    }
+    output << '\n'
+           << setw(10) << "count" << setw(12) << "total ms" << setw(8) << "line"
+           << "  node\n";
+    for (const NodeProfile *node : SortByTime(nodes_))
+    {
+        output << setw(10) << node->count << setw(12) << ToMilliseconds(node->total) << setw(8) << node->line << "  "
+               << node->kind << '\n';
+    }
+}
+
+void Profiler::WriteCollapsedStacks(std::ostream &output) const
+{
+    vector<pair<string_view, Clock::duration>> stacks(stacks_.begin(), stacks_.end());
+    sort(stacks.begin(), stacks.end());
+    for (const auto &[stack, self_time] : stacks)
+    {
+        output << stack << ' ' << chrono::duration_cast<chrono::nanoseconds>(self_time).count() << '\n';
+    }
+}
+
+} // namespace ast
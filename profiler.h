@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ast
+{
+
+class Statement;
+
+/*
+ * Профилировщик программы. Instrument встраивает в дерево счётчики: каждый узел оборачивается
+ * узлом, который подсчитывает количество и суммарное время исполнений, а тела методов и вся программа,
+ * кроме того, образуют кадры стека вызовов. Дерево без счётчиков исполняется без накладных расходов.
+ * Профилировщик не потокобезопасен и должен существовать, пока исполняется инструментированное дерево
+ */
+class Profiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /*
+     * Счётчики узла дерева. Время включает время дочерних узлов; при рекурсии учитывается
+     * только время внешнего исполнения, чтобы вложенные исполнения не были посчитаны дважды
+     */
+    struct NodeProfile
+    {
+        std::string_view kind;
+        uint32_t line = 0;
+        uint64_t count = 0;
+        Clock::duration total{};
+        // Количество незавершённых исполнений узла
+        uint32_t depth = 0;
+    };
+
+    // Счётчики метода класса либо программы в целом (кадр стека вызовов). Время учитывается так же, как для узла
+    struct FrameProfile
+    {
+        std::string name;
+        uint32_t line = 0;
+        uint64_t count = 0;
+        Clock::duration total{};
+        uint32_t depth = 0;
+    };
+
+    Profiler() = default;
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    // Встраивает счётчики в дерево программы, построенное ParseProgram (и, возможно, Optimize)
+    void Instrument(std::unique_ptr<Statement> &program);
+
+    [[nodiscard]] const std::deque<NodeProfile> &GetNodes() const;
+
+    [[nodiscard]] const std::deque<FrameProfile> &GetFrames() const;
+
+    // Выводит таблицы методов и узлов, упорядоченные по убыванию суммарного времени
+    void WriteReport(std::ostream &output) const;
+
+    /*
+     * Выводит собственное время каждого стека вызовов в наносекундах в формате collapsed stacks
+     * (строки «кадр;кадр;кадр время»), который принимают flamegraph.pl и speedscope
+     */
+    void WriteCollapsedStacks(std::ostream &output) const;
+
+    // Вызываются узлами, встроенными Instrument
+    void EnterFrame(FrameProfile &frame);
+    void LeaveFrame(FrameProfile &frame);
+
+private:
+    struct ActiveFrame
+    {
+        size_t path_size;
+        Clock::time_point start;
+        Clock::duration children{};
+    };
+
+    void InstrumentNode(std::unique_ptr<Statement> &node);
+    void InstrumentFrame(std::unique_ptr<Statement> &node, std::string name, uint32_t line);
+
+    std::deque<NodeProfile> nodes_;
+    std::deque<FrameProfile> frames_;
+
+    // Текущий стек вызовов: имена кадров через ';'
+    std::string path_;
+    std::vector<ActiveFrame> active_frames_;
+    std::unordered_map<std::string, Clock::duration> stacks_;
+};
+
+} // namespace ast
@@ -1,8 +1,11 @@
 #include "runtime.h"
 
+#include <algorithm>
 #include <cassert>
+#include <charconv>
 #include <iostream>
 #include <sstream>
+#include <utility>
 #include <variant>
 
 using namespace std;
@@ -12,21 +15,336 @@ namespace runtime
 
 namespace
 {
-const std::string STR_METHOD = "__str__";
-const std::string LESS_THAN_METHOD = "__lt__";
-const std::string EQUAL_METHOD = "__eq__";
+const Symbol STR_METHOD = "__str__";
+const Symbol LESS_THAN_METHOD = "__lt__";
+const Symbol EQUAL_METHOD = "__eq__";
+const Symbol ADD_METHOD = "__add__";
+
+// Номера классов и форм для кешей; 0 не выдаётся и обозначает пустую запись
+uint64_t NextCacheId()
+{
+    static std::atomic<uint64_t> next_id = 1;
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+memory::Category MemoryCategory(ObjectKind kind)
+{
+    switch (kind)
+    {
+    case ObjectKind::String:
+        return memory::Category::Strings;
+    case ObjectKind::Class:
+        return memory::Category::Classes;
+    case ObjectKind::ClassInstance:
+        return memory::Category::Instances;
+    default:
+        return memory::Category::OtherObjects;
+    }
+}
+
+// Байты текста строки вне объекта std::string (короткие строки хранятся внутри него)
+size_t TextBytes(const std::string &text)
+{
+    return text.capacity() > std::string().capacity() ? text.capacity() + 1 : 0;
+}
+
+// Номер пары типов операндов для диспетчеризации бинарных операций оператором switch
+constexpr size_t KindPair(ObjectKind lhs, ObjectKind rhs)
+{
+    return static_cast<size_t>(lhs) * OBJECT_KIND_COUNT + static_cast<size_t>(rhs);
+}
+
+// Приводит объект к типу T без проверки. Тип объекта должен быть проверен по GetKind()
+template <typename T>
+T &As(const ObjectHolder &object)
+{
+    return *static_cast<T *>(object.Get());
+}
+
+// Достаточно для знака и десяти цифр int
+constexpr size_t NUMBER_BUFFER_SIZE = std::numeric_limits<int>::digits10 + 3;
+
+std::string_view FormatNumber(int value, std::array<char, NUMBER_BUFFER_SIZE> &buffer)
+{
+    const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+    return {buffer.data(), static_cast<size_t>(result.ptr - buffer.data())};
+}
+
+// Возвращает метод name объекта instance с argument_count параметрами либо nullptr
+const Method *FindMethod(const ClassInstance &instance, Symbol name, size_t argument_count)
+{
+    const Method *method = instance.GetClass().GetMethod(name);
+    return method != nullptr && method->formal_params.size() == argument_count ? method : nullptr;
+}
+} // namespace
+
+namespace
+{
+constexpr size_t POOL_SIZE_CLASSES = POOL_MAX_SIZE / POOL_GRANULARITY;
+// Предел длины списка свободных блоков одного класса, чтобы поток не удерживал лишнюю память
+constexpr size_t POOL_MAX_FREE_BLOCKS = 4096;
+
+struct FreeBlock
+{
+    FreeBlock *next;
+};
+
+// Списки свободных блоков потока. Тривиально разрушаемы, поэтому доступны и после завершения
+// деструкторов thread_local объектов потока (тогда блоки освобождаются напрямую)
+struct ThreadPool
+{
+    std::array<FreeBlock *, POOL_SIZE_CLASSES> free_lists;
+    std::array<size_t, POOL_SIZE_CLASSES> free_counts;
+    bool released;
+};
+
+thread_local ThreadPool thread_pool{};
+
+// Возвращает распределителю свободные блоки при завершении потока
+struct ThreadPoolReleaser
+{
+    ~ThreadPoolReleaser()
+    {
+        for (FreeBlock *&head : thread_pool.free_lists)
+        {
+            while (head != nullptr)
+            {
+                FreeBlock *next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+        thread_pool.released = true;
+    }
+};
+
+thread_local ThreadPoolReleaser thread_pool_releaser;
+
+size_t SizeClass(size_t size)
+{
+    return (size - 1) / POOL_GRANULARITY;
+}
 } // namespace
 
-ObjectHolder::ObjectHolder(std::shared_ptr<Object> data) : data_(std::move(data)) {}
+void *PoolAllocate(size_t size)
+{
+    if (size == 0 || size > POOL_MAX_SIZE)
+    {
+        return ::operator new(size);
+    }
+    const size_t size_class = SizeClass(size);
+    FreeBlock *head = thread_pool.free_lists[size_class];
+    if (head == nullptr)
+    {
+        return ::operator new((size_class + 1) * POOL_GRANULARITY);
+    }
+    thread_pool.free_lists[size_class] = head->next;
+    --thread_pool.free_counts[size_class];
+    return head;
+}
+
+void PoolDeallocate(void *block, size_t size)
+{
+    if (size == 0 || size > POOL_MAX_SIZE)
+    {
+        ::operator delete(block);
+        return;
+    }
+    const size_t size_class = SizeClass(size);
+    if (thread_pool.released || thread_pool.free_counts[size_class] == POOL_MAX_FREE_BLOCKS)
+    {
+        ::operator delete(block);
+        return;
+    }
+    // Обращение к thread_pool_releaser регистрирует его деструктор для текущего потока
+    static_cast<void>(&thread_pool_releaser);
+    thread_pool.free_lists[size_class] = new (block) FreeBlock{thread_pool.free_lists[size_class]};
+    ++thread_pool.free_counts[size_class];
+}
+
+/*
+ * Куча потока: статистика и двусвязный список экземпляров классов для сборщика циклических ссылок.
+ * Тривиально разрушаема, как и ThreadPool, поэтому доступна и объектам, освобождаемым при завершении потока
+ */
+struct InstanceHeap
+{
+    HeapStats stats;
+    ClassInstance *head;
+    size_t threshold;
+    // Количество экземпляров, при котором запускается следующая автоматическая сборка
+    size_t next_collection;
+    bool collecting;
+
+    static InstanceHeap &Current()
+    {
+        thread_local InstanceHeap heap{{}, nullptr, DEFAULT_COLLECTION_THRESHOLD, DEFAULT_COLLECTION_THRESHOLD, false};
+        return heap;
+    }
+
+    void Track(ClassInstance &instance)
+    {
+        instance.tracked_ = true;
+        instance.heap_prev_ = nullptr;
+        instance.heap_next_ = head;
+        if (head != nullptr)
+        {
+            head->heap_prev_ = &instance;
+        }
+        head = &instance;
+        ++stats.instances;
+        if (threshold != 0 && stats.instances >= next_collection)
+        {
+            Collect();
+        }
+    }
+
+    void Untrack(ClassInstance &instance)
+    {
+        if (instance.heap_prev_ != nullptr)
+        {
+            instance.heap_prev_->heap_next_ = instance.heap_next_;
+        }
+        else
+        {
+            head = instance.heap_next_;
+        }
+        if (instance.heap_next_ != nullptr)
+        {
+            instance.heap_next_->heap_prev_ = instance.heap_prev_;
+        }
+        instance.tracked_ = false;
+        instance.heap_prev_ = nullptr;
+        instance.heap_next_ = nullptr;
+        --stats.instances;
+    }
+
+    // Экземпляр, учитываемый сборщиком, которым владеет value, либо nullptr
+    static ClassInstance *TrackedInstance(const ObjectHolder &value)
+    {
+        if (value.GetHeader() == nullptr || value.GetKind() != ObjectKind::ClassInstance)
+        {
+            return nullptr;
+        }
+        auto *instance = static_cast<ClassInstance *>(value.Get());
+        return instance->tracked_ ? instance : nullptr;
+    }
+
+    size_t Collect()
+    {
+        if (collecting)
+        {
+            return 0;
+        }
+        collecting = true;
+
+        // Остаток счётчика - ссылки на экземпляр не из полей других экземпляров
+        for (ClassInstance *instance = head; instance != nullptr; instance = instance->heap_next_)
+        {
+            const auto *header = reinterpret_cast<const ObjectHolder::HeapHeader *>(static_cast<Object *>(instance)) - 1;
+            instance->gc_refs_ = header->ref_count.load(std::memory_order_relaxed);
+            instance->reachable_ = false;
+        }
+        for (ClassInstance *instance = head; instance != nullptr; instance = instance->heap_next_)
+        {
+            for (size_t i = 0; i < instance->fields_.size(); ++i)
+            {
+                if (ClassInstance *target = TrackedInstance(instance->fields_.GetValue(i)))
+                {
+                    --target->gc_refs_;
+                }
+            }
+        }
+
+        // Экземпляры, достижимые извне, и всё, что достижимо из них по полям
+        std::vector<ClassInstance *> stack;
+        for (ClassInstance *instance = head; instance != nullptr; instance = instance->heap_next_)
+        {
+            if (instance->gc_refs_ != 0)
+            {
+                instance->reachable_ = true;
+                stack.push_back(instance);
+            }
+        }
+        while (!stack.empty())
+        {
+            ClassInstance *instance = stack.back();
+            stack.pop_back();
+            for (size_t i = 0; i < instance->fields_.size(); ++i)
+            {
+                ClassInstance *target = TrackedInstance(instance->fields_.GetValue(i));
+                if (target != nullptr && !target->reachable_)
+                {
+                    target->reachable_ = true;
+                    stack.push_back(target);
+                }
+            }
+        }
+
+        // Недостижимые экземпляры удерживаются до очистки полей всех остальных, затем освобождаются
+        std::vector<ObjectHolder> garbage;
+        for (ClassInstance *instance = head; instance != nullptr; instance = instance->heap_next_)
+        {
+            if (!instance->reachable_)
+            {
+                garbage.push_back(ObjectHolder::Retain(*instance));
+            }
+        }
+        for (const ObjectHolder &holder : garbage)
+        {
+            FieldTable &fields = static_cast<ClassInstance *>(holder.Get())->fields_;
+            for (size_t i = 0; i < fields.size(); ++i)
+            {
+                fields.GetValue(i) = ObjectHolder::None();
+            }
+        }
+        const size_t collected = garbage.size();
+        garbage.clear();
+
+        ++stats.collections;
+        stats.collected += collected;
+        next_collection = std::max(threshold, stats.instances * 2);
+        collecting = false;
+        return collected;
+    }
+};
+
+HeapStats GetHeapStats()
+{
+    return InstanceHeap::Current().stats;
+}
+
+size_t CollectCycles()
+{
+    return InstanceHeap::Current().Collect();
+}
+
+void SetCollectionThreshold(size_t threshold)
+{
+    InstanceHeap &heap = InstanceHeap::Current();
+    heap.threshold = threshold;
+    heap.next_collection = std::max(threshold, heap.stats.instances * 2);
+}
+
+void ObjectHolder::OnAllocate(Object &object, uint32_t size)
+{
+    memory::OnAllocate(MemoryCategory(object.GetKind()), size);
+    InstanceHeap &heap = InstanceHeap::Current();
+    ++heap.stats.objects;
+    heap.stats.bytes += size;
+    if (object.GetKind() == ObjectKind::ClassInstance)
+    {
+        heap.Track(static_cast<ClassInstance &>(object));
+    }
+}
 
 void ObjectHolder::AssertIsValid() const
 {
-    assert(data_ != nullptr);
+    assert(Get() != nullptr);
 }
 
 ObjectHolder ObjectHolder::Share(Object &object)
 {
-    return ObjectHolder(std::shared_ptr<Object>(&object, [](auto * /*p*/) { /* do nothing */ }));
+    return ObjectHolder(Data(std::in_place_type<Pointer>, Pointer{&object, false}));
 }
 
 ObjectHolder ObjectHolder::None()
@@ -46,43 +364,293 @@ Object *ObjectHolder::operator->() const
     return Get();
 }
 
-Object *ObjectHolder::Get() const
+ObjectHolder::operator bool() const
+{
+    return Get() != nullptr;
+}
+
+bool ObjectHolder::IsUnique() const
 {
-    return data_.get();
+    const HeapHeader *header = GetHeader();
+    return header != nullptr && header->ref_count.load(std::memory_order_acquire) == 1;
 }
 
-ObjectHolder::operator bool() const
+void ObjectHolder::ShareBetweenThreads() const
 {
-    return Get() != nullptr;
+    HeapHeader *header = GetHeader();
+    if (header == nullptr || header->thread_shared)
+    {
+        return;
+    }
+    header->thread_shared = true;
+    // Объект может быть освобождён в другом потоке, поэтому больше не учитывается в куче текущего
+    InstanceHeap &heap = InstanceHeap::Current();
+    --heap.stats.objects;
+    heap.stats.bytes -= header->size;
+    if (auto *instance = TryAs<ClassInstance>(); instance != nullptr && instance->tracked_)
+    {
+        heap.Untrack(*instance);
+    }
 }
 
-bool IsTrue(const ObjectHolder &object)
+void ObjectHolder::Destroy(HeapHeader *header)
+{
+    Object *object = std::get_if<Pointer>(&data_)->object;
+    data_ = Data{};
+    const uint32_t size = header->size;
+    memory::OnDeallocate(MemoryCategory(object->GetKind()), size);
+    if (!header->thread_shared)
+    {
+        InstanceHeap &heap = InstanceHeap::Current();
+        --heap.stats.objects;
+        heap.stats.bytes -= size;
+    }
+    object->~Object();
+    header->~HeapHeader();
+    PoolDeallocate(header, size);
+}
+
+Closure Closure::Frame(size_t slot_count)
+{
+    Closure frame;
+    frame.slots_.resize(slot_count);
+    return frame;
+}
+
+ObjectHolder *Closure::FindSlot(size_t slot)
+{
+    std::optional<ObjectHolder> &value = slots_[slot];
+    return value.has_value() ? &*value : nullptr;
+}
+
+void Closure::SetSlot(size_t slot, ObjectHolder value)
+{
+    slots_[slot] = std::move(value);
+}
+
+size_t Closure::SlotCount() const
+{
+    return slots_.size();
+}
+
+void Closure::Reset(size_t slot_count)
+{
+    clear();
+    slots_.assign(slot_count, std::nullopt);
+}
+
+Shape::Shape() : id_(NextCacheId()) {}
+
+size_t Shape::FindOffset(Symbol name) const
+{
+    auto iter = offsets_.find(name);
+    return iter != offsets_.end() ? iter->second : NO_OFFSET;
+}
+
+const Shape &Shape::AddField(Symbol name) const
+{
+    std::lock_guard guard(transitions_mutex_);
+    std::unique_ptr<Shape> &next = transitions_[name];
+    if (next == nullptr)
+    {
+        next = std::make_unique<Shape>();
+        next->names_ = names_;
+        next->names_.push_back(name);
+        next->offsets_ = offsets_;
+        next->offsets_[name] = names_.size();
+    }
+    return *next;
+}
+
+size_t Shape::FieldCount() const
+{
+    return names_.size();
+}
+
+const std::string &Shape::GetFieldName(size_t offset) const
+{
+    return names_[offset].GetName();
+}
+
+FieldTable::FieldTable(const Shape &shape) : shape_(&shape) {}
+
+ObjectHolder &FieldTable::operator[](Symbol name)
+{
+    const size_t offset = shape_->FindOffset(name);
+    if (offset != Shape::NO_OFFSET)
+    {
+        return values_[offset];
+    }
+    Extend(shape_->AddField(name));
+    return values_.back();
+}
+
+ObjectHolder &FieldTable::at(Symbol name)
+{
+    const size_t offset = shape_->FindOffset(name);
+    if (offset == Shape::NO_OFFSET)
+    {
+        throw std::runtime_error("Field "s + name.GetName() + " not found"s);
+    }
+    return values_[offset];
+}
+
+const ObjectHolder &FieldTable::at(Symbol name) const
+{
+    return const_cast<FieldTable &>(*this).at(name);
+}
+
+FieldTable::iterator FieldTable::find(Symbol name)
+{
+    const size_t offset = shape_->FindOffset(name);
+    return offset != Shape::NO_OFFSET ? iterator(this, offset) : end();
+}
+
+FieldTable::const_iterator FieldTable::find(Symbol name) const
+{
+    const size_t offset = shape_->FindOffset(name);
+    return offset != Shape::NO_OFFSET ? const_iterator(this, offset) : end();
+}
+
+FieldTable::iterator FieldTable::begin()
+{
+    return iterator(this, 0);
+}
+
+FieldTable::iterator FieldTable::end()
+{
+    return iterator(this, values_.size());
+}
+
+FieldTable::const_iterator FieldTable::begin() const
+{
+    return const_iterator(this, 0);
+}
+
+FieldTable::const_iterator FieldTable::end() const
+{
+    return const_iterator(this, values_.size());
+}
+
+size_t FieldTable::count(Symbol name) const
+{
+    return shape_->FindOffset(name) != Shape::NO_OFFSET ? 1 : 0;
+}
+
+size_t FieldTable::size() const
+{
+    return values_.size();
+}
+
+bool FieldTable::empty() const
+{
+    return values_.empty();
+}
+
+const Shape &FieldTable::GetShape() const
+{
+    return *shape_;
+}
+
+ObjectHolder &FieldTable::GetValue(size_t offset)
+{
+    return values_[offset];
+}
+
+const ObjectHolder &FieldTable::GetValue(size_t offset) const
+{
+    return values_[offset];
+}
+
+void FieldTable::Extend(const Shape &shape)
+{
+    shape_ = &shape;
+    values_.resize(shape.FieldCount());
+}
+
+const FieldCache::Entry *FieldCache::Lookup(const Shape &shape) const
 {
-#define CONVERT_TO_BOOL(type)                                                                                \
-    {                                                                                                        \
-        auto obj_ptr = dynamic_cast<type *>(object.Get());                                                   \
-        if (obj_ptr)                                                                                         \
-            return obj_ptr->GetValue();                                                                      \
+    const size_t size = size_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (entries_[i].shape_id == shape.GetId())
+        {
+            return &entries_[i];
+        }
     }
-    CONVERT_TO_BOOL(Bool);
-    CONVERT_TO_BOOL(Number);
+    return nullptr;
+}
 
-#undef CONVERT_TO_BOOL
+void FieldCache::Insert(const Entry &entry)
+{
+    std::lock_guard guard(mutex_);
+    const size_t size = size_.load(std::memory_order_relaxed);
+    if (size < CAPACITY)
+    {
+        entries_[size] = entry;
+        size_.store(size + 1, std::memory_order_release);
+    }
+}
 
-    auto string_ptr = dynamic_cast<String *>(object.Get());
-    if (string_ptr != nullptr)
+ObjectHolder *FieldCache::Find(FieldTable &fields, Symbol name)
+{
+    const Shape &shape = fields.GetShape();
+    if (const Entry *entry = Lookup(shape))
+    {
+        return &fields.GetValue(entry->offset);
+    }
+    const size_t offset = shape.FindOffset(name);
+    if (offset == Shape::NO_OFFSET)
     {
-        return !string_ptr->GetValue().empty();
+        return nullptr;
     }
+    Insert(Entry{shape.GetId(), offset, &shape});
+    return &fields.GetValue(offset);
+}
 
-    return false;
+ObjectHolder &FieldCache::Assign(FieldTable &fields, Symbol name)
+{
+    const Shape &shape = fields.GetShape();
+    if (const Entry *entry = Lookup(shape))
+    {
+        if (entry->next != &shape)
+        {
+            fields.Extend(*entry->next);
+        }
+        return fields.GetValue(entry->offset);
+    }
+    size_t offset = shape.FindOffset(name);
+    const Shape *next = &shape;
+    if (offset == Shape::NO_OFFSET)
+    {
+        next = &shape.AddField(name);
+        offset = shape.FieldCount();
+        fields.Extend(*next);
+    }
+    Insert(Entry{shape.GetId(), offset, next});
+    return fields.GetValue(offset);
+}
+
+bool IsTrue(const ObjectHolder &object)
+{
+    switch (object.GetKind())
+    {
+    case ObjectKind::Bool:
+        return As<Bool>(object).GetValue();
+    case ObjectKind::Number:
+        return As<Number>(object).GetValue() != 0;
+    case ObjectKind::String:
+        return As<String>(object).GetSize() != 0;
+    default:
+        return false;
+    }
 }
 
 void ClassInstance::Print(std::ostream &os, Context &context)
 {
-    if (this->HasMethod(STR_METHOD, 0U))
+    if (const Method *method = FindMethod(*this, STR_METHOD, 0U))
     {
-        this->Call(STR_METHOD, {}, context)->Print(os, context);
+        this->Call(*method, {}, context)->Print(os, context);
     }
     else
     {
@@ -90,62 +658,229 @@ void ClassInstance::Print(std::ostream &os, Context &context)
     }
 }
 
-bool ClassInstance::HasMethod(const std::string &method_name, size_t argument_count) const
+bool ClassInstance::HasMethod(Symbol method_name, size_t argument_count) const
 {
     const Method *method = class_.GetMethod(method_name);
     return method != nullptr && method->formal_params.size() == argument_count;
 }
 
-Closure &ClassInstance::Fields()
+FieldTable &ClassInstance::Fields()
 {
     return fields_;
 }
 
-const Closure &ClassInstance::Fields() const
+const FieldTable &ClassInstance::Fields() const
 {
     return fields_;
 }
 
-ClassInstance::ClassInstance(const Class &cls) : class_(cls) {}
+const Class &ClassInstance::GetClass() const
+{
+    return class_;
+}
+
+ClassInstance::ClassInstance(const Class &cls)
+    : Object(ObjectKind::ClassInstance), class_(cls), fields_(cls.GetInstanceShape())
+{
+}
+
+ClassInstance::ClassInstance(const ClassInstance &other)
+    : Object(other), class_(other.class_), fields_(other.fields_)
+{
+}
+
+ClassInstance::ClassInstance(ClassInstance &&other) noexcept
+    : Object(other), class_(other.class_), fields_(std::move(other.fields_))
+{
+}
+
+ClassInstance::~ClassInstance()
+{
+    if (tracked_)
+    {
+        InstanceHeap::Current().Untrack(*this);
+    }
+}
+
+namespace
+{
+const char *LimitMessage(ExecutionLimit limit)
+{
+    switch (limit)
+    {
+    case ExecutionLimit::Steps:
+        return "Step limit exceeded";
+    case ExecutionLimit::Deadline:
+        return "Deadline exceeded";
+    case ExecutionLimit::Cancelled:
+        return "Execution cancelled";
+    }
+    return "Execution limit exceeded";
+}
+} // namespace
+
+ExecutionLimitError::ExecutionLimitError(ExecutionLimit limit) : std::runtime_error(LimitMessage(limit)), limit_(limit)
+{
+}
+
+void Context::SetStepLimit(uint64_t limit)
+{
+    step_limit_ = limit;
+    checked_steps_ = 0;
+    StartBatch();
+}
+
+void Context::SetDeadline(std::optional<std::chrono::steady_clock::time_point> deadline)
+{
+    checked_steps_ = GetStepCount();
+    deadline_ = deadline;
+    StartBatch();
+}
+
+void Context::SetCancellationFlag(const std::atomic<bool> *flag)
+{
+    checked_steps_ = GetStepCount();
+    cancellation_flag_ = flag;
+    StartBatch();
+}
+
+void Context::StartBatch()
+{
+    batch_size_ = std::numeric_limits<uint64_t>::max();
+    if (deadline_ || cancellation_flag_ != nullptr)
+    {
+        batch_size_ = LIMIT_CHECK_INTERVAL;
+    }
+    if (step_limit_ != 0)
+    {
+        // Серия завершается на шаге, следующем за последним разрешённым
+        batch_size_ = std::min(batch_size_, step_limit_ + 1 - std::min(checked_steps_, step_limit_));
+    }
+    steps_until_check_ = batch_size_;
+}
+
+void Context::CheckLimits()
+{
+    checked_steps_ += batch_size_;
+    std::optional<ExecutionLimit> exceeded;
+    if (step_limit_ != 0 && checked_steps_ > step_limit_)
+    {
+        exceeded = ExecutionLimit::Steps;
+    }
+    else if (cancellation_flag_ != nullptr && cancellation_flag_->load(std::memory_order_relaxed))
+    {
+        exceeded = ExecutionLimit::Cancelled;
+    }
+    else if (deadline_ && std::chrono::steady_clock::now() >= *deadline_)
+    {
+        exceeded = ExecutionLimit::Deadline;
+    }
+    if (exceeded)
+    {
+        // Каждый следующий шаг снова сообщает о превышении, пока ограничения не изменены
+        batch_size_ = 1;
+        steps_until_check_ = 1;
+        throw ExecutionLimitError(*exceeded);
+    }
+    StartBatch();
+}
+
+ClassInstance::CallScope::CallScope(Context &context)
+    : context_(context), tail_call_(context.tail_call_)
+{
+    if (context_.call_depth_ >= context_.recursion_limit_)
+    {
+        throw RecursionLimitError("Maximum recursion depth exceeded"s);
+    }
+    ++context_.call_depth_;
+}
+
+ClassInstance::CallScope::~CallScope()
+{
+    --context_.call_depth_;
+    context_.tail_call_ = tail_call_;
+}
 
-ObjectHolder ClassInstance::Call(const std::string &method_name, const std::vector<ObjectHolder> &actual_args,
+ObjectHolder ClassInstance::Call(Symbol method_name, const std::vector<ObjectHolder> &actual_args,
                                  Context &context)
 {
-    if (!HasMethod(method_name, actual_args.size()))
+    const Method *method = class_.GetMethod(method_name);
+    if (method == nullptr || method->formal_params.size() != actual_args.size())
     {
         throw std::runtime_error("Cannot call method");
     }
-    const Method *method = class_.GetMethod(method_name);
-    Closure args;
-    args["self"] = ObjectHolder::Share(*this);
-    for (size_t i = 0; i < method->formal_params.size(); i++)
+    return Call(*method, actual_args, context);
+}
+
+ObjectHolder ClassInstance::Call(const Method &method, const std::vector<ObjectHolder> &actual_args,
+                                 Context &context)
+{
+    CallScope scope(context);
+    TailCall tail_call;
+    ObjectHolder self = ObjectHolder::Share(*this);
+    const Method *current = &method;
+    const std::vector<ObjectHolder> *args = &actual_args;
+    std::vector<ObjectHolder> tail_args;
+    Closure frame;
+    while (true)
     {
-        args[method->formal_params[i]] = actual_args[i];
+        context.Step();
+        if (current->native)
+        {
+            return current->native(*self.TryAs<ClassInstance>(), *args, context);
+        }
+        if (!current->slot_names.empty())
+        {
+            // Слот 0 - self, далее формальные параметры в порядке объявления
+            frame.Reset(current->slot_names.size());
+            frame.SetSlot(0, std::move(self));
+            for (size_t i = 0; i < args->size(); i++)
+            {
+                frame.SetSlot(i + 1, (*args)[i]);
+            }
+        }
+        else
+        {
+            frame.Reset(0);
+            frame["self"] = std::move(self);
+            for (size_t i = 0; i < current->formal_params.size(); i++)
+            {
+                frame[current->formal_params[i]] = (*args)[i];
+            }
+        }
+
+        context.tail_call_ = &tail_call;
+        ObjectHolder result = current->body->Execute(frame, context);
+        if (tail_call.method == nullptr)
+        {
+            return result;
+        }
+        // Тело запланировало хвостовой вызов: кадр используется повторно, глубина рекурсии не меняется
+        current = std::exchange(tail_call.method, nullptr);
+        self = std::move(tail_call.self);
+        tail_args = std::move(tail_call.args);
+        args = &tail_args;
     }
-    return method->body.get()->Execute(args, context);
 }
 
 Class::Class(std::string name, std::vector<Method> methods, const Class *parent)
-    : name_(name), methods_(std::move(methods)), parent_(parent)
+    : Object(ObjectKind::Class), id_(NextCacheId()), name_(name), methods_(std::move(methods)), parent_(parent),
+      instance_shape_(std::make_unique<Shape>())
 {
+    if (parent_ != nullptr)
+    {
+        metod_name_to_ptr_ = parent_->metod_name_to_ptr_;
+    }
     for (const auto &method : methods_)
     {
         metod_name_to_ptr_[method.name] = &method;
     }
 }
 
-const Method *Class::GetMethod(const std::string &name) const
+const Method *Class::GetMethod(Symbol name) const
 {
     auto iter = metod_name_to_ptr_.find(name);
-    if (iter != metod_name_to_ptr_.end())
-    {
-        return iter->second;
-    }
-    else if (parent_ != nullptr)
-    {
-        return parent_->GetMethod(name);
-    }
-    return nullptr;
+    return iter != metod_name_to_ptr_.end() ? iter->second : nullptr;
 }
 
 [[nodiscard]] const std::string &Class::GetName() const
@@ -153,78 +888,243 @@ const Method *Class::GetMethod(const std::string &name) const
     return name_;
 }
 
+const std::vector<Method> &Class::GetMethods() const
+{
+    return methods_;
+}
+
+const Class *Class::GetParent() const
+{
+    return parent_;
+}
+
+const Shape &Class::GetInstanceShape() const
+{
+    return *instance_shape_;
+}
+
 void Class::Print(ostream &os, [[maybe_unused]] Context &context)
 {
     os << "Class " << name_;
 }
 
+Bool::Bool(bool v) : ValueObject<bool>(v, ObjectKind::Bool) {}
+
 void Bool::Print(std::ostream &os, [[maybe_unused]] Context &context)
 {
     os << (GetValue() ? "True"sv : "False"sv);
 }
 
-bool Equal(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
+String::String(std::string value) : Object(ObjectKind::String), value_(std::move(value)), size_(value_.size())
+{
+    OnTextAllocated();
+}
+
+String::String(const String &other) : Object(ObjectKind::String), value_(other.GetValue()), size_(other.size_)
+{
+    OnTextAllocated();
+}
+
+String::String(String &&other) noexcept
+    : Object(ObjectKind::String), value_(std::move(other.value_)), size_(other.size_), lhs_(std::move(other.lhs_)),
+      rhs_(std::move(other.rhs_))
+{
+    other.size_ = other.value_.size();
+}
+
+String::String(ObjectHolder lhs, ObjectHolder rhs, size_t size)
+    : Object(ObjectKind::String), size_(size), lhs_(std::move(lhs)), rhs_(std::move(rhs))
 {
-    if (lhs.Get() == nullptr && rhs.Get() == nullptr)
+}
+
+String::~String()
+{
+    if (const size_t bytes = TextBytes(value_); bytes != 0)
     {
-        return true;
+        memory::OnDeallocate(memory::Category::StringText, bytes);
     }
+    if (!IsConcatenation())
+    {
+        return;
+    }
+    // Рекурсивное разрушение длинной цепочки s = s + x переполнило бы стек: узлы, которыми больше никто
+    // не владеет, разбираются явно, и каждый из них разрушается уже без слагаемых
+    std::vector<ObjectHolder> pending;
+    pending.push_back(std::move(lhs_));
+    pending.push_back(std::move(rhs_));
+    while (!pending.empty())
+    {
+        ObjectHolder node = std::move(pending.back());
+        pending.pop_back();
+        if (node.IsUnique())
+        {
+            auto &str = As<String>(node);
+            if (str.IsConcatenation())
+            {
+                pending.push_back(std::move(str.lhs_));
+                pending.push_back(std::move(str.rhs_));
+            }
+        }
+    }
+}
 
-    auto lhs_class_ptr = dynamic_cast<ClassInstance *>(lhs.Get());
-    if (lhs_class_ptr != nullptr)
+ObjectHolder String::Concat(const ObjectHolder &lhs, const ObjectHolder &rhs)
+{
+    const auto &left = As<String>(lhs);
+    const auto &right = As<String>(rhs);
+    const size_t size = left.size_ + right.size_;
+    // Строки из узлов дерева программы (StringConst) не должны переживать программу внутри результата
+    const auto owned = [](const ObjectHolder &holder, const String &str) {
+        return holder.IsShared() ? ObjectHolder::Own(String(str)) : holder;
+    };
+    if (right.size_ == 0)
+    {
+        return owned(lhs, left);
+    }
+    if (left.size_ == 0)
+    {
+        return owned(rhs, right);
+    }
+    if (size < ROPE_MIN_SIZE)
+    {
+        std::string value;
+        value.reserve(size);
+        value += left.GetValue();
+        value += right.GetValue();
+        return ObjectHolder::Own(String(std::move(value)));
+    }
+    return ObjectHolder::Own(String(owned(lhs, left), owned(rhs, right), size));
+}
+
+const std::string &String::GetValue() const
+{
+    if (IsConcatenation())
+    {
+        Flatten();
+    }
+    return value_;
+}
+
+void String::Flatten() const
+{
+    value_.reserve(size_);
+    // Обход слагаемых слева направо без рекурсии: глубина дерева равна числу сложений
+    std::vector<const String *> pending = {&As<String>(rhs_), &As<String>(lhs_)};
+    while (!pending.empty())
     {
-        if (lhs_class_ptr->HasMethod(EQUAL_METHOD, 1U))
+        const String *node = pending.back();
+        pending.pop_back();
+        if (node->IsConcatenation())
         {
-            return IsTrue(lhs_class_ptr->Call(EQUAL_METHOD, {rhs}, context));
+            pending.push_back(&As<String>(node->rhs_));
+            pending.push_back(&As<String>(node->lhs_));
         }
         else
         {
-            throw std::runtime_error("Cannot compare objects for equality"s);
+            value_ += node->value_;
+        }
+    }
+    OnTextAllocated();
+    // Собранной строке слагаемые больше не нужны
+    ObjectHolder lhs = std::move(lhs_);
+    ObjectHolder rhs = std::move(rhs_);
+}
+
+void String::OnTextAllocated() const
+{
+    if (const size_t bytes = TextBytes(value_); bytes != 0)
+    {
+        memory::OnAllocate(memory::Category::StringText, bytes);
+    }
+}
+
+void String::Print(std::ostream &os, [[maybe_unused]] Context &context)
+{
+    os << GetValue();
+}
+
+const Method *MethodCache::Find(const Class &cls, Symbol name, size_t argument_count)
+{
+    const size_t size = size_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (entries_[i].class_id == cls.GetId())
+        {
+            return entries_[i].method;
         }
     }
 
-#define COMPARABLE_VALUE(type)                                                                               \
-    {                                                                                                        \
-        auto lhs_ptr = dynamic_cast<type *>(lhs.Get());                                                      \
-        auto rhs_ptr = dynamic_cast<type *>(rhs.Get());                                                      \
-        if (lhs_ptr && rhs_ptr)                                                                              \
-            return lhs_ptr->GetValue() == rhs_ptr->GetValue();                                               \
+    const Method *method = cls.GetMethod(name);
+    if (method == nullptr || method->formal_params.size() != argument_count)
+    {
+        return nullptr;
     }
-    COMPARABLE_VALUE(Bool);
-    COMPARABLE_VALUE(Number);
-    COMPARABLE_VALUE(String);
 
-#undef COMPARABLE_VALUE
+    std::lock_guard guard(mutex_);
+    const size_t current_size = size_.load(std::memory_order_relaxed);
+    if (current_size < CAPACITY)
+    {
+        entries_[current_size] = Entry{cls.GetId(), method};
+        size_.store(current_size + 1, std::memory_order_release);
+    }
+    return method;
+}
 
-    throw std::runtime_error("Cannot compare objects for equality"s);
+bool Equal(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
+{
+    if (lhs.GetKind() == ObjectKind::ClassInstance)
+    {
+        auto &instance = As<ClassInstance>(lhs);
+        if (const Method *method = FindMethod(instance, EQUAL_METHOD, 1U))
+        {
+            return IsTrue(instance.Call(*method, {rhs}, context));
+        }
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    }
+
+    switch (KindPair(lhs.GetKind(), rhs.GetKind()))
+    {
+    case KindPair(ObjectKind::None, ObjectKind::None):
+        return true;
+    case KindPair(ObjectKind::Bool, ObjectKind::Bool):
+        return As<Bool>(lhs).GetValue() == As<Bool>(rhs).GetValue();
+    case KindPair(ObjectKind::Number, ObjectKind::Number):
+        return As<Number>(lhs).GetValue() == As<Number>(rhs).GetValue();
+    case KindPair(ObjectKind::String, ObjectKind::String):
+    {
+        const auto &left = As<String>(lhs);
+        const auto &right = As<String>(rhs);
+        // Строки разной длины не равны: собирать узлы конкатенации не требуется
+        return left.GetSize() == right.GetSize() && left.GetValue() == right.GetValue();
+    }
+    default:
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    }
 }
 
 bool Less(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
 {
-    auto lhs_class_ptr = dynamic_cast<ClassInstance *>(lhs.Get());
-    if (lhs_class_ptr != nullptr)
+    if (lhs.GetKind() == ObjectKind::ClassInstance)
     {
-        if (lhs_class_ptr->HasMethod(LESS_THAN_METHOD, 1U))
+        auto &instance = As<ClassInstance>(lhs);
+        if (const Method *method = FindMethod(instance, LESS_THAN_METHOD, 1U))
         {
-            return IsTrue(lhs_class_ptr->Call(LESS_THAN_METHOD, {rhs}, context));
+            return IsTrue(instance.Call(*method, {rhs}, context));
         }
         throw std::runtime_error("Cannot compare objects for less"s);
     }
 
-#define COMPARABLE_VALUE(type)                                                                               \
-    {                                                                                                        \
-        auto lhs_ptr = dynamic_cast<type *>(lhs.Get());                                                      \
-        auto rhs_ptr = dynamic_cast<type *>(rhs.Get());                                                      \
-        if (lhs_ptr && rhs_ptr)                                                                              \
-            return lhs_ptr->GetValue() < rhs_ptr->GetValue();                                                \
+    switch (KindPair(lhs.GetKind(), rhs.GetKind()))
+    {
+    case KindPair(ObjectKind::Bool, ObjectKind::Bool):
+        return As<Bool>(lhs).GetValue() < As<Bool>(rhs).GetValue();
+    case KindPair(ObjectKind::Number, ObjectKind::Number):
+        return As<Number>(lhs).GetValue() < As<Number>(rhs).GetValue();
+    case KindPair(ObjectKind::String, ObjectKind::String):
+        return As<String>(lhs).GetValue() < As<String>(rhs).GetValue();
+    default:
+        throw std::runtime_error("Cannot compare objects for less"s);
     }
-    COMPARABLE_VALUE(Bool);
-    COMPARABLE_VALUE(Number);
-    COMPARABLE_VALUE(String);
-
-#undef COMPARABLE_VALUE
-
-    throw std::runtime_error("Cannot compare objects for less"s);
 }
 
 bool NotEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
@@ -247,4 +1147,163 @@ bool GreaterOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &c
     return !(Less(lhs, rhs, context));
 }
 
-} // namespace runtime
\ No newline at end of file
+ObjectHolder Add(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context)
+{
+    switch (KindPair(lhs.GetKind(), rhs.GetKind()))
+    {
+    case KindPair(ObjectKind::Number, ObjectKind::Number):
+        return ObjectHolder::Own(Number(As<Number>(lhs).GetValue() + As<Number>(rhs).GetValue()));
+    case KindPair(ObjectKind::String, ObjectKind::String):
+        return String::Concat(lhs, rhs);
+    default:
+        break;
+    }
+
+    if (lhs.GetKind() == ObjectKind::ClassInstance)
+    {
+        auto &instance = As<ClassInstance>(lhs);
+        if (const Method *method = FindMethod(instance, ADD_METHOD, 1U))
+        {
+            return instance.Call(*method, {rhs}, context);
+        }
+    }
+
+    throw std::runtime_error("Failed to Add::Execute ");
+}
+
+ObjectHolder Sub(const ObjectHolder &lhs, const ObjectHolder &rhs)
+{
+    if (KindPair(lhs.GetKind(), rhs.GetKind()) == KindPair(ObjectKind::Number, ObjectKind::Number))
+    {
+        return ObjectHolder::Own(Number(As<Number>(lhs).GetValue() - As<Number>(rhs).GetValue()));
+    }
+
+    throw std::runtime_error("Failed to Sub::Execute ");
+}
+
+ObjectHolder Mult(const ObjectHolder &lhs, const ObjectHolder &rhs)
+{
+    if (KindPair(lhs.GetKind(), rhs.GetKind()) == KindPair(ObjectKind::Number, ObjectKind::Number))
+    {
+        return ObjectHolder::Own(Number(As<Number>(lhs).GetValue() * As<Number>(rhs).GetValue()));
+    }
+
+    throw std::runtime_error("Failed to Mult::Execute ");
+}
+
+ObjectHolder Div(const ObjectHolder &lhs, const ObjectHolder &rhs)
+{
+    if (KindPair(lhs.GetKind(), rhs.GetKind()) != KindPair(ObjectKind::Number, ObjectKind::Number))
+    {
+        throw std::runtime_error("Failed to Div::Execute ");
+    }
+    const int divisor = As<Number>(rhs).GetValue();
+    if (divisor == 0)
+    {
+        throw std::runtime_error("Сannot be divided by 0 ");
+    }
+    return ObjectHolder::Own(Number(As<Number>(lhs).GetValue() / divisor));
+}
+
+OutputBuffer::OutputBuffer(std::ostream &output, size_t capacity) : output_(output), capacity_(capacity)
+{
+    buffer_.reserve(capacity_);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    Flush();
+}
+
+void OutputBuffer::AppendNumber(int value)
+{
+    std::array<char, NUMBER_BUFFER_SIZE> buffer;
+    Append(FormatNumber(value, buffer));
+}
+
+void OutputBuffer::Flush()
+{
+    if (!buffer_.empty())
+    {
+        output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+}
+
+void OutputBuffer::AppendSlow(std::string_view data)
+{
+    Flush();
+    // Данные, не помещающиеся в пустой буфер, передаются в поток без копирования
+    if (data.size() >= capacity_)
+    {
+        output_.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    else
+    {
+        buffer_.append(data);
+    }
+}
+
+void PrintValue(const ObjectHolder &object, Context &context)
+{
+    OutputBuffer &output = context.GetOutputBuffer();
+    switch (object.GetKind())
+    {
+    case ObjectKind::None:
+        output.Append("None"sv);
+        return;
+    case ObjectKind::Number:
+        output.AppendNumber(As<Number>(object).GetValue());
+        return;
+    case ObjectKind::String:
+        output.Append(As<String>(object).GetValue());
+        return;
+    case ObjectKind::Bool:
+        output.Append(As<Bool>(object).GetValue() ? "True"sv : "False"sv);
+        return;
+    case ObjectKind::ClassInstance: {
+        auto &instance = As<ClassInstance>(object);
+        if (const Method *method = FindMethod(instance, STR_METHOD, 0U))
+        {
+            PrintValue(instance.Call(*method, {}, context), context);
+            return;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    object->Print(context.GetOutputStream(), context);
+}
+
+std::string ToString(const ObjectHolder &object, Context &context)
+{
+    switch (object.GetKind())
+    {
+    case ObjectKind::None:
+        return "None"s;
+    case ObjectKind::Number: {
+        std::array<char, NUMBER_BUFFER_SIZE> buffer;
+        return std::string(FormatNumber(As<Number>(object).GetValue(), buffer));
+    }
+    case ObjectKind::String:
+        return As<String>(object).GetValue();
+    case ObjectKind::Bool:
+        return As<Bool>(object).GetValue() ? "True"s : "False"s;
+    case ObjectKind::ClassInstance: {
+        auto &instance = As<ClassInstance>(object);
+        if (const Method *method = FindMethod(instance, STR_METHOD, 0U))
+        {
+            return ToString(instance.Call(*method, {}, context), context);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    std::ostringstream output;
+    object->Print(output, context);
+    return output.str();
+}
+
+} // namespace runtime
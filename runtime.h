@@ -1,45 +1,432 @@
 #pragma once
 
+#include "memory_stats.h"
+#include "symbol.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace runtime
 {
+
+/*
+ * Буфер вывода программы. Данные накапливаются в памяти и передаются в поток одним вызовом write,
+ * когда буфер заполнен, при вызове Flush и при разрушении буфера. Буфер нулевой ёмкости
+ * передаёт данные в поток сразу, минуя форматирование iostream
+ */
+class OutputBuffer
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    explicit OutputBuffer(std::ostream &output, size_t capacity = DEFAULT_CAPACITY);
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    void Append(std::string_view data)
+    {
+        if (data.size() <= capacity_ - buffer_.size())
+        {
+            buffer_.append(data);
+        }
+        else
+        {
+            AppendSlow(data);
+        }
+    }
+
+    void Append(char c)
+    {
+        Append(std::string_view(&c, 1));
+    }
+
+    // Записывает десятичное представление числа без обращения к локали потока
+    void AppendNumber(int value);
+
+    // Передаёт накопленные данные в поток
+    void Flush();
+
+private:
+    void AppendSlow(std::string_view data);
+
+    std::ostream &output_;
+    size_t capacity_;
+    std::string buffer_;
+};
+
+// Глубина вложенных вызовов методов превысила ограничение контекста
+class RecursionLimitError : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Ограничение исполнения, заданное в контексте
+enum class ExecutionLimit
+{
+    Steps,
+    Deadline,
+    Cancelled,
+};
+
+// Исполнение прервано ограничением контекста: исчерпан бюджет шагов, наступил срок либо исполнение отменено
+class ExecutionLimitError : public std::runtime_error
+{
+public:
+    explicit ExecutionLimitError(ExecutionLimit limit);
+
+    [[nodiscard]] ExecutionLimit GetLimit() const
+    {
+        return limit_;
+    }
+
+private:
+    ExecutionLimit limit_;
+};
+
+// Количество шагов исполнения между проверками срока и флага отмены
+constexpr uint64_t LIMIT_CHECK_INTERVAL = 1024;
+
+// Глубина вызовов по умолчанию не ограничена: запас стека C++ на один уровень рекурсии зависит от сборки
+// и программы, поэтому ограничение задаётся явно (SetRecursionLimit, --recursion-limit)
+constexpr size_t NO_RECURSION_LIMIT = std::numeric_limits<size_t>::max();
+
+struct TailCall;
+
 class Context
 {
 public:
+    // Поток вывода. Данные, накопленные в буфере GetOutputBuffer(), передаются в поток до возврата из метода
     virtual std::ostream &GetOutputStream() = 0;
 
+    // Буфер, через который выводит значения инструкция print
+    virtual OutputBuffer &GetOutputBuffer() = 0;
+
+    // Наибольшая глубина вложенных вызовов методов: вызовов ClassInstance::Call, каждый из которых занимает
+    // стек C++, и кадров регистровой машины. Более глубокий вызов выбрасывает RecursionLimitError.
+    // Хвостовые вызовы (return self.method(...)) глубину не увеличивают
+    void SetRecursionLimit(size_t limit)
+    {
+        recursion_limit_ = limit;
+    }
+
+    [[nodiscard]] size_t GetRecursionLimit() const
+    {
+        return recursion_limit_;
+    }
+
+    // Количество незавершённых вызовов методов
+    [[nodiscard]] size_t GetCallDepth() const
+    {
+        return call_depth_;
+    }
+
+    // Хвостовой вызов, который может запланировать исполняемое сейчас тело метода, либо nullptr вне методов
+    [[nodiscard]] TailCall *GetTailCall() const
+    {
+        return tail_call_;
+    }
+
+    /*
+     * Ограничения исполнения недоверенных программ. Шаг - вход в метод либо инструкция составной инструкции
+     * (на регистровой машине - вызов метода либо инструкция print). Превышение бюджета шагов, наступление срока
+     * и установка флага отмены прерывают исполнение исключением ExecutionLimitError. Срок и флаг проверяются
+     * раз в LIMIT_CHECK_INTERVAL шагов, поэтому учёт шага - лишь уменьшение счётчика.
+     * SetStepLimit сбрасывает счётчик шагов; 0 снимает ограничение
+     */
+    void SetStepLimit(uint64_t limit);
+
+    [[nodiscard]] uint64_t GetStepLimit() const
+    {
+        return step_limit_;
+    }
+
+    // Количество шагов после последнего вызова SetStepLimit
+    [[nodiscard]] uint64_t GetStepCount() const
+    {
+        return checked_steps_ + batch_size_ - steps_until_check_;
+    }
+
+    void SetDeadline(std::optional<std::chrono::steady_clock::time_point> deadline);
+
+    // Флаг, установка которого из любого потока отменяет исполнение. Должен существовать, пока он задан в контексте
+    void SetCancellationFlag(const std::atomic<bool> *flag);
+
+    // Учитывает шаг исполнения
+    void Step()
+    {
+        if (--steps_until_check_ == 0)
+        {
+            CheckLimits();
+        }
+    }
+
 protected:
     ~Context() = default;
+
+private:
+    friend class ClassInstance;
+
+    // Учитывает завершённую серию шагов, проверяет ограничения и начинает следующую серию
+    void CheckLimits();
+    void StartBatch();
+
+    size_t recursion_limit_ = NO_RECURSION_LIMIT;
+    size_t call_depth_ = 0;
+    TailCall *tail_call_ = nullptr;
+
+    uint64_t step_limit_ = 0;
+    std::optional<std::chrono::steady_clock::time_point> deadline_;
+    const std::atomic<bool> *cancellation_flag_ = nullptr;
+    // Шаги до завершённых серий, размер текущей серии и остаток её шагов
+    uint64_t checked_steps_ = 0;
+    uint64_t batch_size_ = std::numeric_limits<uint64_t>::max();
+    uint64_t steps_until_check_ = std::numeric_limits<uint64_t>::max();
 };
 
+// Тип объекта для диспетчеризации без RTTI. Other - объекты, определённые вне runtime
+enum class ObjectKind : uint8_t
+{
+    None,
+    Number,
+    String,
+    Bool,
+    Class,
+    ClassInstance,
+    Other,
+};
+
+constexpr size_t OBJECT_KIND_COUNT = static_cast<size_t>(ObjectKind::Other) + 1;
+
 class Object
 {
 public:
+    explicit Object(ObjectKind kind = ObjectKind::Other) : kind_(kind) {}
+
     virtual ~Object() = default;
 
     virtual void Print(std::ostream &os, Context &context) = 0;
+
+    [[nodiscard]] ObjectKind GetKind() const
+    {
+        return kind_;
+    }
+
+private:
+    ObjectKind kind_;
 };
 
+class Bool;
+class Class;
+class ClassInstance;
+
+// Тип, которым помечены объекты класса T, либо Other, если T проверяется через dynamic_cast
+template <typename T>
+inline constexpr ObjectKind KIND_OF = ObjectKind::Other;
+
+template <typename T>
+class ValueObject : public Object
+{
+public:
+    ValueObject(T v) 
+        : Object(KIND_OF<ValueObject<T>>), value_(v)
+    {
+    }
+
+    ValueObject(T v, ObjectKind kind)
+        : Object(kind), value_(v)
+    {
+    }
+
+    void Print(std::ostream &os, [[maybe_unused]] Context &context) override
+    {
+        os << value_;
+    }
+
+    [[nodiscard]] const T &GetValue() const
+    {
+        return value_;
+    }
+
+private:
+    T value_;
+};
+
+class String;
+using Number = ValueObject<int>;
+
+class Bool : public ValueObject<bool>
+{
+public:
+    Bool(bool v);
+
+    void Print(std::ostream &os, Context &context) override;
+};
+
+template <>
+inline constexpr ObjectKind KIND_OF<Number> = ObjectKind::Number;
+template <>
+inline constexpr ObjectKind KIND_OF<String> = ObjectKind::String;
+template <>
+inline constexpr ObjectKind KIND_OF<Bool> = ObjectKind::Bool;
+template <>
+inline constexpr ObjectKind KIND_OF<Class> = ObjectKind::Class;
+template <>
+inline constexpr ObjectKind KIND_OF<ClassInstance> = ObjectKind::ClassInstance;
+
+/*
+ * Пул памяти для объектов в куче. Блоки размером до POOL_MAX_SIZE байт распределены по классам размеров
+ * с шагом POOL_GRANULARITY; освобождённые блоки попадают в список свободных блоков текущего потока
+ * и переиспользуются без обращения к общему распределителю памяти. Блок можно освободить
+ * в любом потоке. Более крупные блоки выделяются operator new.
+ */
+constexpr size_t POOL_GRANULARITY = 16;
+constexpr size_t POOL_MAX_SIZE = 256;
+
+[[nodiscard]] void *PoolAllocate(size_t size);
+
+void PoolDeallocate(void *block, size_t size);
+
+// Статистика кучи текущего потока
+struct HeapStats
+{
+    // Объекты в куче, созданные в потоке и ещё не освобождённые (кроме переданных другим потокам), и их блоки
+    size_t objects = 0;
+    size_t bytes = 0;
+    // Экземпляры классов, за которыми следит сборщик циклических ссылок
+    size_t instances = 0;
+    // Количество сборок и освобождённых ими экземпляров
+    size_t collections = 0;
+    size_t collected = 0;
+};
+
+[[nodiscard]] HeapStats GetHeapStats();
+
+/*
+ * Сборщик циклических ссылок. Счётчики ссылок не освобождают экземпляры классов, ссылающиеся друг на друга
+ * через поля, поэтому экземпляры в куче потока учитываются сборщиком. Сборка - пробное удаление (trial deletion):
+ * из счётчика ссылок каждого экземпляра вычитаются ссылки из полей других экземпляров. Экземпляр с ненулевым
+ * остатком достижим извне - из глобальных переменных, кадров вызовов или временных значений, - как и всё,
+ * что достижимо из него по полям. Поля остальных экземпляров очищаются, и экземпляры освобождаются
+ * счётчиками ссылок. Невладеющие ссылки (Share) корнями не считаются: экземпляр, метод которого исполняется,
+ * удерживает вызывающий код. Возвращает количество освобождённых экземпляров
+ */
+size_t CollectCycles();
+
+/*
+ * Сборка запускается автоматически при создании экземпляра, когда число учитываемых экземпляров
+ * достигает threshold либо удвоенного числа экземпляров, переживших предыдущую сборку.
+ * Значение 0 отключает автоматическую сборку. Порог задаётся для текущего потока
+ */
+constexpr size_t DEFAULT_COLLECTION_THRESHOLD = 1000;
+
+void SetCollectionThreshold(size_t threshold);
+
+/*
+ * Значение Mython. Числа и логические значения хранятся непосредственно внутри ObjectHolder,
+ * None - пустой указатель. Строки, классы и экземпляры классов размещаются в куче.
+ *
+ * Объект в куче предваряется заголовком со счётчиком ссылок (HeapHeader) в том же блоке пула.
+ * Счётчик изменяется неатомарно: объекты, созданные при исполнении программы, принадлежат одному потоку.
+ * Передать объект другим потокам можно, лишь явно разрешив это вызовом ShareBetweenThreads,
+ * после которого счётчик объекта изменяется атомарно
+ */
 class ObjectHolder
 {
 public:
     ObjectHolder() = default;
 
+    ObjectHolder(const ObjectHolder &other) : data_(other.data_)
+    {
+        AddRef();
+    }
+
+    ObjectHolder(ObjectHolder &&other) noexcept : data_(other.data_)
+    {
+        other.Reset();
+    }
+
+    ObjectHolder &operator=(const ObjectHolder &other)
+    {
+        if (this != &other)
+        {
+            other.AddRef();
+            Release();
+            data_ = other.data_;
+        }
+        return *this;
+    }
+
+    ObjectHolder &operator=(ObjectHolder &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Release();
+            data_ = other.data_;
+            other.Reset();
+        }
+        return *this;
+    }
+
+    ~ObjectHolder()
+    {
+        Release();
+    }
+
     // Возвращает ObjectHolder, владеющий объектом типа T
     // Тип T - конкретный класс-наследник Object.
-    // object копируется или перемещается в кучу
+    // Number и Bool копируются внутрь ObjectHolder, остальные объекты копируются или перемещаются
+    // в блок пула памяти вслед за заголовком со счётчиком ссылок
     template <typename T>
     [[nodiscard]] static ObjectHolder Own(T &&object)
     {
-        return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+        using Type = std::decay_t<T>;
+        if constexpr (std::is_same_v<Type, Number> || std::is_same_v<Type, Bool>)
+        {
+            return ObjectHolder(Data(std::in_place_type<Type>, std::forward<T>(object)));
+        }
+        else
+        {
+            static_assert(alignof(Type) <= sizeof(HeapHeader));
+            void *block = PoolAllocate(sizeof(HeapHeader) + sizeof(Type));
+            auto *header = new (block) HeapHeader;
+            header->size = sizeof(HeapHeader) + sizeof(Type);
+            Type *value = nullptr;
+            try
+            {
+                value = new (header + 1) Type(std::forward<T>(object));
+            }
+            catch (...)
+            {
+                PoolDeallocate(block, header->size);
+                throw;
+            }
+            ObjectHolder holder(Data(std::in_place_type<Pointer>, Pointer{value, true}));
+            OnAllocate(*value, header->size);
+            return holder;
+        }
     }
 
-    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
+    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки). Счётчик ссылок не используется
     [[nodiscard]] static ObjectHolder Share(Object &object);
 
     // Создаёт пустой ObjectHolder, соответствующий значению None
@@ -49,99 +436,505 @@ public:
 
     Object *operator->() const;
 
-    [[nodiscard]] Object *Get() const;
+    // Для чисел и логических значений возвращает указатель на объект внутри ObjectHolder,
+    // который действителен, пока жив и не изменён сам ObjectHolder
+    [[nodiscard]] Object *Get() const
+    {
+        switch (data_.index())
+        {
+        case NUMBER_INDEX:
+            return std::get_if<Number>(&data_);
+        case BOOL_INDEX:
+            return std::get_if<Bool>(&data_);
+        default:
+            return std::get_if<Pointer>(&data_)->object;
+        }
+    }
+
+    // Тип хранимого объекта; для пустого ObjectHolder - ObjectKind::None
+    [[nodiscard]] ObjectKind GetKind() const
+    {
+        switch (data_.index())
+        {
+        case NUMBER_INDEX:
+            return ObjectKind::Number;
+        case BOOL_INDEX:
+            return ObjectKind::Bool;
+        default: {
+            const Object *object = std::get_if<Pointer>(&data_)->object;
+            return object != nullptr ? object->GetKind() : ObjectKind::None;
+        }
+        }
+    }
 
     // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
-    // объект данного типа
+    // объект данного типа. Для типов runtime проверяется тег ObjectKind, для остальных - dynamic_cast
     template <typename T>
     [[nodiscard]] T *TryAs() const
     {
-        return dynamic_cast<T *>(this->Get());
+        if constexpr (std::is_same_v<T, Number> || std::is_same_v<T, Bool>)
+        {
+            if (auto *value = std::get_if<T>(&data_))
+            {
+                return value;
+            }
+        }
+        Object *object = this->Get();
+        if constexpr (KIND_OF<T> != ObjectKind::Other)
+        {
+            return object != nullptr && object->GetKind() == KIND_OF<T> ? static_cast<T *>(object) : nullptr;
+        }
+        else if constexpr (std::is_same_v<T, Object>)
+        {
+            return object;
+        }
+        else
+        {
+            return dynamic_cast<T *>(object);
+        }
     }
 
     explicit operator bool() const;
 
+    // Возвращает true, если ObjectHolder - единственный владелец объекта в куче
+    [[nodiscard]] bool IsUnique() const;
+
+    // Возвращает true для непустого ObjectHolder, созданного Share: объектом владеет вызывающий код
+    [[nodiscard]] bool IsShared() const
+    {
+        const Pointer *pointer = std::get_if<Pointer>(&data_);
+        return pointer != nullptr && pointer->object != nullptr && !pointer->owned;
+    }
+
+    /*
+     * Разрешает передавать объект в куче другим потокам: с этого момента его счётчик ссылок изменяется атомарно.
+     * Вызывается до того, как копии ObjectHolder станут доступны другим потокам. Поля объекта
+     * по-прежнему не синхронизированы. Для чисел, логических значений и невладеющих ObjectHolder ничего не делает
+     */
+    void ShareBetweenThreads() const;
+
 private:
-    explicit ObjectHolder(std::shared_ptr<Object> data);
+    friend struct InstanceHeap;
+
+    // Заголовок блока пула, предшествующий объекту в куче
+    struct alignas(POOL_GRANULARITY) HeapHeader
+    {
+        std::atomic<uint32_t> ref_count = 1;
+        // Размер блока вместе с заголовком
+        uint32_t size = 0;
+        bool thread_shared = false;
+    };
+
+    // Пустой ObjectHolder хранит Pointer{nullptr, false}
+    struct Pointer
+    {
+        Object *object;
+        // Для Share - false: объектом владеет вызывающий код
+        bool owned;
+    };
+
+    using Data = std::variant<Pointer, Number, Bool>;
+    static constexpr size_t NUMBER_INDEX = 1;
+    static constexpr size_t BOOL_INDEX = 2;
+
+    explicit ObjectHolder(Data data) : data_(data) {}
     void AssertIsValid() const;
 
-    std::shared_ptr<Object> data_;
+    [[nodiscard]] HeapHeader *GetHeader() const
+    {
+        const Pointer *pointer = std::get_if<Pointer>(&data_);
+        return pointer != nullptr && pointer->owned ? reinterpret_cast<HeapHeader *>(pointer->object) - 1 : nullptr;
+    }
+
+    void AddRef() const
+    {
+        if (HeapHeader *header = GetHeader())
+        {
+            if (header->thread_shared)
+            {
+                header->ref_count.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                // Без атомарной операции чтения-записи: объект принадлежит одному потоку
+                header->ref_count.store(header->ref_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Release()
+    {
+        if (HeapHeader *header = GetHeader())
+        {
+            const uint32_t count = header->thread_shared
+                                       ? header->ref_count.fetch_sub(1, std::memory_order_acq_rel) - 1
+                                       : header->ref_count.load(std::memory_order_relaxed) - 1;
+            if (count == 0)
+            {
+                Destroy(header);
+            }
+            else if (!header->thread_shared)
+            {
+                header->ref_count.store(count, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Оставляет перемещённый ObjectHolder пустым, не освобождая объект. Числа и логические значения не изменяются
+    void Reset()
+    {
+        if (auto *pointer = std::get_if<Pointer>(&data_))
+        {
+            *pointer = Pointer{nullptr, false};
+        }
+    }
+
+    // Разрушает объект и освобождает его блок
+    void Destroy(HeapHeader *header);
+
+    // Учитывает созданный объект в статистике кучи, экземпляр класса - в сборщике циклических ссылок
+    static void OnAllocate(Object &object, uint32_t size);
+
+    // Создаёт ещё одного владельца объекта, размещённого Own
+    [[nodiscard]] static ObjectHolder Retain(Object &object)
+    {
+        ObjectHolder holder(Data(std::in_place_type<Pointer>, Pointer{&object, true}));
+        holder.AddRef();
+        return holder;
+    }
+
+    // mutable: Get() и TryAs() константны, но выдают изменяемый указатель на хранимое значение
+    mutable Data data_;
 };
 
-template <typename T>
-class ValueObject : public Object
+/*
+ * Неизменяемая строка. Результат сложения длинных строк - узел конкатенации (rope), который ссылается
+ * на слагаемые и не копирует их байты, поэтому построение строки по частям (s = s + x) занимает линейное время.
+ * Байты узла собираются при первом обращении к GetValue, после чего ссылки на слагаемые освобождаются.
+ * Короткие результаты сложения копируются сразу. Как и поля объектов, строка не синхронизирована:
+ * её нельзя одновременно читать из нескольких потоков, пока она не собрана
+ */
+class String : public Object
 {
 public:
-    ValueObject(T v) 
-        : value_(v)
+    String(std::string value);
+
+    // Копия строки всегда собрана и не ссылается на слагаемые оригинала
+    String(const String &other);
+    String(String &&other) noexcept;
+    String &operator=(const String &) = delete;
+    String &operator=(String &&) = delete;
+
+    // Освобождает цепочку узлов конкатенации без рекурсии
+    ~String() override;
+
+    // Возвращает строку lhs + rhs. Аргументы должны содержать объекты String. Результат владеет своими
+    // слагаемыми: строки, на которые аргументы лишь ссылаются (Share), копируются
+    [[nodiscard]] static ObjectHolder Concat(const ObjectHolder &lhs, const ObjectHolder &rhs);
+
+    // Байты строки; узел конкатенации собирается при первом вызове
+    [[nodiscard]] const std::string &GetValue() const;
+
+    // Длина строки, известная без сборки узла конкатенации
+    [[nodiscard]] size_t GetSize() const
     {
+        return size_;
     }
 
-    void Print(std::ostream &os, [[maybe_unused]] Context &context) override
+    void Print(std::ostream &os, Context &context) override;
+
+    // Результаты сложения короче ROPE_MIN_SIZE байт не образуют узел конкатенации
+    static constexpr size_t ROPE_MIN_SIZE = 128;
+
+private:
+    String(ObjectHolder lhs, ObjectHolder rhs, size_t size);
+
+    [[nodiscard]] bool IsConcatenation() const
     {
-        os << value_;
+        return lhs_.Get() != nullptr;
     }
 
-    [[nodiscard]] const T &GetValue() const
+    void Flatten() const;
+
+    // Учитывает текст value_ в статистике памяти. Перемещённый текст уже учтён, а у исходной строки
+    // после перемещения текст пуст
+    void OnTextAllocated() const;
+
+    mutable std::string value_;
+    size_t size_;
+    // Слагаемые несобранного узла конкатенации; у собранной строки пусты
+    mutable ObjectHolder lhs_;
+    mutable ObjectHolder rhs_;
+};
+
+/*
+ * Область видимости. Глобальные переменные, поля объектов и параметры методов, не прошедших
+ * разрешение имён, хранятся в словаре по имени.
+ * Локальные переменные методов, разобранных парсером, хранятся в слотах: номер слота каждой
+ * переменной известен на этапе разбора, поэтому обращение к ней не требует хеширования имени.
+ */
+class Closure
+    : public std::unordered_map<
+          std::string, ObjectHolder, std::hash<std::string>, std::equal_to<std::string>,
+          memory::TrackingAllocator<std::pair<const std::string, ObjectHolder>, memory::Category::Closures>>
+{
+public:
+    using unordered_map::unordered_map;
+
+    // Создаёт кадр метода с slot_count неинициализированными слотами
+    [[nodiscard]] static Closure Frame(size_t slot_count);
+
+    // Возвращает значение слота либо nullptr, если слоту ещё ничего не присвоено
+    [[nodiscard]] ObjectHolder *FindSlot(size_t slot);
+
+    void SetSlot(size_t slot, ObjectHolder value);
+
+    [[nodiscard]] size_t SlotCount() const;
+
+    // Очищает кадр для повторного использования: slot_count неинициализированных слотов и пустой словарь
+    void Reset(size_t slot_count);
+
+private:
+    std::vector<std::optional<ObjectHolder>,
+                memory::TrackingAllocator<std::optional<ObjectHolder>, memory::Category::Closures>>
+        slots_;
+};
+
+/*
+ * Форма (скрытый класс) экземпляров: упорядоченный набор имён полей и их номера в массиве значений.
+ * Формы образуют дерево: добавление поля переводит объект в дочернюю форму, общую для всех объектов,
+ * получивших те же поля в том же порядке. Формы неизменяемы, кроме таблицы переходов,
+ * которая защищена мьютексом.
+ */
+class Shape
+{
+public:
+    static constexpr size_t NO_OFFSET = std::numeric_limits<size_t>::max();
+
+    Shape();
+    Shape(const Shape &) = delete;
+    Shape &operator=(const Shape &) = delete;
+
+    // Номер формы, не повторяющийся за время работы процесса (см. FieldCache)
+    [[nodiscard]] uint64_t GetId() const
     {
-        return value_;
+        return id_;
     }
 
+    // Номер поля name либо NO_OFFSET, если поля нет
+    [[nodiscard]] size_t FindOffset(Symbol name) const;
+
+    // Форма с добавленным в конец полем name. Поле не должно присутствовать в текущей форме
+    [[nodiscard]] const Shape &AddField(Symbol name) const;
+
+    [[nodiscard]] size_t FieldCount() const;
+
+    [[nodiscard]] const std::string &GetFieldName(size_t offset) const;
+
 private:
-    T value_;
+    uint64_t id_;
+    std::vector<Symbol> names_;
+    std::unordered_map<Symbol, size_t> offsets_;
+    mutable std::unordered_map<Symbol, std::unique_ptr<Shape>> transitions_;
+    mutable std::mutex transitions_mutex_;
 };
 
-using Closure = std::unordered_map<std::string, ObjectHolder>;
+template <typename Table, typename Value>
+class FieldIterator
+{
+public:
+    FieldIterator(Table *table, size_t offset) : table_(table), offset_(offset) {}
 
-// Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
-bool IsTrue(const ObjectHolder &object);
+    std::pair<const std::string &, Value &> operator*() const
+    {
+        return {table_->GetShape().GetFieldName(offset_), table_->GetValue(offset_)};
+    }
 
-class Executable
+    FieldIterator &operator++()
+    {
+        ++offset_;
+        return *this;
+    }
+
+    bool operator==(const FieldIterator &other) const
+    {
+        return table_ == other.table_ && offset_ == other.offset_;
+    }
+
+    bool operator!=(const FieldIterator &other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    Table *table_;
+    size_t offset_;
+};
+
+/*
+ * Поля экземпляра класса: форма и плотный массив значений в порядке номеров полей формы.
+ * Интерфейс повторяет используемую часть интерфейса словаря.
+ */
+class FieldTable
 {
 public:
-    virtual ~Executable() = default;
+    using iterator = FieldIterator<FieldTable, ObjectHolder>;
+    using const_iterator = FieldIterator<const FieldTable, const ObjectHolder>;
 
-    virtual ObjectHolder Execute(Closure &closure, Context &context) = 0;
+    explicit FieldTable(const Shape &shape);
+
+    // Возвращает значение поля name, добавляя поле со значением None при его отсутствии
+    ObjectHolder &operator[](Symbol name);
+
+    // Возвращает значение поля name. Если поля нет, выбрасывает исключение runtime_error
+    ObjectHolder &at(Symbol name);
+    [[nodiscard]] const ObjectHolder &at(Symbol name) const;
+
+    [[nodiscard]] iterator find(Symbol name);
+    [[nodiscard]] const_iterator find(Symbol name) const;
+
+    [[nodiscard]] iterator begin();
+    [[nodiscard]] iterator end();
+    [[nodiscard]] const_iterator begin() const;
+    [[nodiscard]] const_iterator end() const;
+
+    [[nodiscard]] size_t count(Symbol name) const;
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+
+    [[nodiscard]] const Shape &GetShape() const;
+
+    [[nodiscard]] ObjectHolder &GetValue(size_t offset);
+    [[nodiscard]] const ObjectHolder &GetValue(size_t offset) const;
+
+    // Переводит таблицу в форму shape, полученную из текущей добавлением одного поля
+    void Extend(const Shape &shape);
+
+private:
+    const Shape *shape_;
+    std::vector<ObjectHolder, memory::TrackingAllocator<ObjectHolder, memory::Category::InstanceFields>> values_;
 };
 
-using String = ValueObject<std::string>;
-using Number = ValueObject<int>;
+/*
+ * Кеш обращения к полю name в месте программы. Хранит до CAPACITY пар (форма, номер поля),
+ * а для присваивания - ещё и форму после добавления поля, поэтому повторное обращение
+ * к объекту уже встречавшейся формы не ищет поле по имени.
+ * Кеш только дополняется, его можно читать из нескольких потоков. Копия кеша пуста.
+ * Записи ссылаются на формы по номерам: форма, созданная на месте освобождённой (например, при повторном
+ * разборе класса в IncrementalParser), не совпадает с записью освобождённой формы
+ */
+class FieldCache
+{
+public:
+    FieldCache() = default;
+    FieldCache(const FieldCache & /*other*/) {}
+    FieldCache &operator=(const FieldCache & /*other*/)
+    {
+        return *this;
+    }
 
-class Bool : public ValueObject<bool>
+    // Возвращает значение поля name либо nullptr, если поля нет
+    [[nodiscard]] ObjectHolder *Find(FieldTable &fields, Symbol name);
+
+    // Возвращает значение поля name для присваивания, добавляя поле при его отсутствии
+    [[nodiscard]] ObjectHolder &Assign(FieldTable &fields, Symbol name);
+
+private:
+    static constexpr size_t CAPACITY = 4;
+
+    struct Entry
+    {
+        uint64_t shape_id = 0;
+        size_t offset = Shape::NO_OFFSET;
+        // Форма после присваивания (совпадает с shape, если поле уже было)
+        const Shape *next = nullptr;
+    };
+
+    const Entry *Lookup(const Shape &shape) const;
+    void Insert(const Entry &entry);
+
+    std::array<Entry, CAPACITY> entries_;
+    std::atomic<size_t> size_ = 0;
+    std::mutex mutex_;
+};
+
+// Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
+bool IsTrue(const ObjectHolder &object);
+
+class Executable
 {
 public:
-    using ValueObject<bool>::ValueObject;
+    virtual ~Executable() = default;
 
-    void Print(std::ostream &os, Context &context) override;
+    virtual ObjectHolder Execute(Closure &closure, Context &context) = 0;
 };
 
+// Метод, реализованный функцией C++. Получает объект self и фактические параметры, количество которых
+// совпадает с количеством формальных параметров метода
+using NativeMethod =
+    std::function<ObjectHolder(ClassInstance &self, const std::vector<ObjectHolder> &args, Context &context)>;
+
 struct Method
 {
     std::string name;
     std::vector<std::string> formal_params;
     std::unique_ptr<Executable> body;
+    // Имена слотов кадра метода: self, формальные параметры, затем остальные локальные переменные.
+    // Пустой список означает, что имена в теле метода не разрешены и кадр строится по именам
+    std::vector<std::string> slot_names{};
+    // Если задан, метод исполняется этой функцией без кадра и тела body
+    NativeMethod native{};
+};
+
+/*
+ * Вызов метода в хвостовой позиции (return obj.method(...)). Тело метода записывает его в Context::GetTailCall()
+ * и завершается, а ClassInstance::Call исполняет запланированный метод в том же кадре стека C++
+ */
+struct TailCall
+{
+    // Объект, у которого вызывается метод; владение сохраняет объект, пока исполняется метод
+    ObjectHolder self;
+    const Method *method = nullptr;
+    std::vector<ObjectHolder> args;
 };
 
 class Class : public Object
 {
 public:
     // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
-    // Если parent равен nullptr, то создаётся базовый класс
+    // Если parent равен nullptr, то создаётся базовый класс.
+    // Таблица методов класса включает унаследованные методы, поэтому поиск метода не обходит родителей
     explicit Class(std::string name, std::vector<Method> methods, const Class *parent);
 
     // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-    [[nodiscard]] const Method *GetMethod(const std::string &name) const;
+    [[nodiscard]] const Method *GetMethod(Symbol name) const;
 
     [[nodiscard]] const std::string &GetName() const;
 
+    // Собственные методы класса (без унаследованных)
+    [[nodiscard]] const std::vector<Method> &GetMethods() const;
+
+    // Родительский класс либо nullptr для базового класса
+    [[nodiscard]] const Class *GetParent() const;
+
+    // Форма только что созданного экземпляра класса (без полей)
+    [[nodiscard]] const Shape &GetInstanceShape() const;
+
+    // Номер класса, не повторяющийся за время работы процесса (см. MethodCache)
+    [[nodiscard]] uint64_t GetId() const
+    {
+        return id_;
+    }
+
     void Print(std::ostream &os, Context &context) override;
 
 private:
+    uint64_t id_;
     std::string name_;
     std::vector<Method> methods_;
     const Class *parent_ = nullptr;
-    std::unordered_map<std::string, const Method *> metod_name_to_ptr_;
-    Closure arguments_;
+    std::unordered_map<Symbol, const Method *> metod_name_to_ptr_;
+    std::unique_ptr<Shape> instance_shape_;
 };
 
 class ClassInstance : public Object
@@ -149,6 +942,12 @@ class ClassInstance : public Object
 public:
     explicit ClassInstance(const Class &cls);
 
+    // Копия не наследует учёт оригинала сборщиком циклических ссылок
+    ClassInstance(const ClassInstance &other);
+    ClassInstance(ClassInstance &&other) noexcept;
+    ClassInstance &operator=(const ClassInstance &) = delete;
+    ~ClassInstance() override;
+
     /*
      * Если у объекта есть метод __str__, выводит в os результат, возвращённый этим методом.
      * В противном случае в os выводится адрес объекта.
@@ -159,20 +958,82 @@ public:
      * Вызывает у объекта метод method, передавая ему actual_args параметров.
      * Параметр context задаёт контекст для выполнения метода.
      * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
-     * runtime_error
+     * runtime_error. Если вызов превышает ограничение глубины рекурсии контекста, выбрасывается RecursionLimitError
      */
-    ObjectHolder Call(const std::string &method, const std::vector<ObjectHolder> &actual_args,
+    ObjectHolder Call(Symbol method, const std::vector<ObjectHolder> &actual_args,
                       Context &context);
 
-    [[nodiscard]] bool HasMethod(const std::string &method, size_t argument_count) const;
+    // Вызывает уже найденный метод класса объекта. Количество actual_args должно совпадать
+    // с количеством формальных параметров метода
+    ObjectHolder Call(const Method &method, const std::vector<ObjectHolder> &actual_args, Context &context);
+
+    [[nodiscard]] bool HasMethod(Symbol method, size_t argument_count) const;
+
+    [[nodiscard]] FieldTable &Fields();
 
-    [[nodiscard]] Closure &Fields();
+    [[nodiscard]] const FieldTable &Fields() const;
 
-    [[nodiscard]] const Closure &Fields() const;
+    [[nodiscard]] const Class &GetClass() const;
 
 private:
+    friend class ObjectHolder;
+    friend struct InstanceHeap;
+
+    // Учитывает вызов в глубине рекурсии контекста и восстанавливает хвостовой вызов вызывающего метода
+    class CallScope
+    {
+    public:
+        explicit CallScope(Context &context);
+        ~CallScope();
+
+        CallScope(const CallScope &) = delete;
+        CallScope &operator=(const CallScope &) = delete;
+
+    private:
+        Context &context_;
+        TailCall *tail_call_;
+    };
+
     const Class &class_;
-    Closure fields_;
+    FieldTable fields_;
+
+    // Экземпляр входит в список сборщика циклических ссылок текущего потока
+    bool tracked_ = false;
+    bool reachable_ = false;
+    // Остаток счётчика ссылок при пробном удалении
+    uint32_t gc_refs_ = 0;
+    ClassInstance *heap_prev_ = nullptr;
+    ClassInstance *heap_next_ = nullptr;
+};
+
+/*
+ * Кеш поиска метода в месте вызова. Хранит до CAPACITY пар (класс, метод), поэтому повторный вызов
+ * метода у объекта уже встречавшегося класса не выполняет поиск по имени.
+ * Записи только добавляются и не меняются, поэтому кеш можно читать из нескольких потоков.
+ * Записи ссылаются на классы по номерам, поэтому освобождённый класс не оставляет в кеше действительной записи
+ */
+class MethodCache
+{
+public:
+    MethodCache() = default;
+    MethodCache(const MethodCache &) = delete;
+    MethodCache &operator=(const MethodCache &) = delete;
+
+    // Возвращает метод name класса cls с argument_count формальными параметрами либо nullptr
+    [[nodiscard]] const Method *Find(const Class &cls, Symbol name, size_t argument_count);
+
+private:
+    static constexpr size_t CAPACITY = 4;
+
+    struct Entry
+    {
+        uint64_t class_id = 0;
+        const Method *method = nullptr;
+    };
+
+    std::array<Entry, CAPACITY> entries_;
+    std::atomic<size_t> size_ = 0;
+    std::mutex mutex_;
 };
 
 /*
@@ -199,6 +1060,30 @@ bool LessOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &cont
 
 bool GreaterOrEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
 
+/*
+ * Поддерживается сложение чисел, строк, а также объектов, у которых есть метод __add__(rhs).
+ * В остальных случаях функция выбрасывает исключение runtime_error.
+ */
+ObjectHolder Add(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context);
+
+// Вычитание, умножение и деление определены только для чисел.
+// В остальных случаях, а также при делении на 0, выбрасывается исключение runtime_error
+ObjectHolder Sub(const ObjectHolder &lhs, const ObjectHolder &rhs);
+
+ObjectHolder Mult(const ObjectHolder &lhs, const ObjectHolder &rhs);
+
+ObjectHolder Div(const ObjectHolder &lhs, const ObjectHolder &rhs);
+
+/*
+ * Выводит значение object в буфер вывода контекста так же, как Object::Print, а пустое значение - как None.
+ * Числа, строки и логические значения, а также результат __str__ выводятся без обращения к iostream
+ */
+void PrintValue(const ObjectHolder &object, Context &context);
+
+// Строковое представление значения, совпадающее с выводом PrintValue
+[[nodiscard]] std::string ToString(const ObjectHolder &object, Context &context);
+
+// Контекст для тестов: вывод без буферизации попадает в output
 struct DummyContext : Context
 {
     std::ostream &GetOutputStream() override
@@ -206,21 +1091,38 @@ struct DummyContext : Context
         return output;
     }
 
+    OutputBuffer &GetOutputBuffer() override
+    {
+        return buffer;
+    }
+
     std::ostringstream output;
+    OutputBuffer buffer{output, 0};
 };
 
+// Буферизованный вывод в поток output. Буфер сбрасывается в поток при разрушении контекста
 class SimpleContext : public runtime::Context
 {
 public:
-    explicit SimpleContext(std::ostream &output) : output_(output) {}
+    explicit SimpleContext(std::ostream &output, size_t buffer_capacity = OutputBuffer::DEFAULT_CAPACITY)
+        : output_(output), buffer_(output, buffer_capacity)
+    {
+    }
 
     std::ostream &GetOutputStream() override
     {
+        buffer_.Flush();
         return output_;
     }
 
+    OutputBuffer &GetOutputBuffer() override
+    {
+        return buffer_;
+    }
+
 private:
     std::ostream &output_;
+    OutputBuffer buffer_;
 };
 
 } // namespace runtime
\ No newline at end of file
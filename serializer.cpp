@@ -0,0 +1,659 @@
+#include "serializer.h"
+
+#include "statement.h"
+
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace ast
+{
+
+namespace
+{
+constexpr uint32_t IMAGE_VERSION = 2;
+
+enum class NodeTag : uint8_t
+{
+    NumericConst,
+    StringConst,
+    BoolConst,
+    None,
+    VariableValue,
+    Assignment,
+    FieldAssignment,
+    Print,
+    MethodCall,
+    NewInstance,
+    Stringify,
+    Not,
+    Add,
+    Sub,
+    Mult,
+    Div,
+    Or,
+    And,
+    Comparison,
+    Compound,
+    MethodBody,
+    Return,
+    ClassDefinition,
+    IfElse,
+};
+
+constexpr uint8_t LAST_TAG = static_cast<uint8_t>(NodeTag::IfElse);
+
+// Сравнение хранится в образе номером ComparisonOp
+constexpr uint8_t LAST_COMPARISON = static_cast<uint8_t>(ComparisonOp::GreaterOrEqual);
+
+// Номер слота хранится со сдвигом на единицу, 0 означает NO_SLOT
+uint64_t EncodeSlot(size_t slot)
+{
+    return slot == NO_SLOT ? 0 : static_cast<uint64_t>(slot) + 1;
+}
+
+size_t DecodeSlot(uint64_t value)
+{
+    return value == 0 ? NO_SLOT : static_cast<size_t>(value - 1);
+}
+
+class ImageWriter
+{
+public:
+    void WriteProgram(const Statement &program, ostream &output)
+    {
+        WriteNode(program);
+
+        string header(IMAGE_MAGIC);
+        swap(header, body_);
+        WriteVarint(IMAGE_VERSION);
+        WriteVarint(strings_.size());
+        for (const string_view str : strings_)
+        {
+            WriteVarint(str.size());
+            body_.append(str);
+        }
+        swap(header, body_);
+
+        output.write(header.data(), static_cast<streamsize>(header.size()));
+        output.write(body_.data(), static_cast<streamsize>(body_.size()));
+    }
+
+private:
+    void WriteVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            body_.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        body_.push_back(static_cast<char>(value));
+    }
+
+    void WriteTag(NodeTag tag)
+    {
+        body_.push_back(static_cast<char>(tag));
+    }
+
+    void WriteString(const string &str)
+    {
+        auto [iter, inserted] = string_index_.emplace(str, strings_.size());
+        if (inserted)
+        {
+            strings_.push_back(iter->first);
+        }
+        WriteVarint(iter->second);
+    }
+
+    void WriteStrings(const vector<string> &strings)
+    {
+        WriteVarint(strings.size());
+        for (const string &str : strings)
+        {
+            WriteString(str);
+        }
+    }
+
+    void WriteNodes(const vector<unique_ptr<Statement>> &nodes)
+    {
+        WriteVarint(nodes.size());
+        for (const auto &node : nodes)
+        {
+            WriteNode(*node);
+        }
+    }
+
+    void WriteVariable(const VariableValue &var)
+    {
+        WriteVarint(var.GetDottedIds().size() + 1);
+        WriteString(var.GetName());
+        for (const runtime::Symbol &id : var.GetDottedIds())
+        {
+            WriteString(string(id.GetName()));
+        }
+        WriteVarint(EncodeSlot(var.GetSlot()));
+    }
+
+    void WriteClassRef(const runtime::Class &cls)
+    {
+        auto iter = class_index_.find(&cls);
+        if (iter == class_index_.end())
+        {
+            throw SerializationError("Class "s + cls.GetName() + " is not defined by the program before its use"s);
+        }
+        WriteVarint(iter->second);
+    }
+
+    void WriteClass(const runtime::Class &cls)
+    {
+        WriteString(cls.GetName());
+        if (const runtime::Class *parent = cls.GetParent())
+        {
+            WriteVarint(1);
+            WriteClassRef(*parent);
+        }
+        else
+        {
+            WriteVarint(0);
+        }
+
+        WriteVarint(cls.GetMethods().size());
+        for (const runtime::Method &method : cls.GetMethods())
+        {
+            auto body = dynamic_cast<const MethodBody *>(method.body.get());
+            if (body == nullptr)
+            {
+                throw SerializationError("Method "s + cls.GetName() + "."s + method.name + " has no syntax tree"s);
+            }
+            WriteString(method.name);
+            WriteStrings(method.formal_params);
+            WriteStrings(method.slot_names);
+            WriteNode(*body);
+        }
+        // Номер классу назначается после его методов, так же как при чтении
+        class_index_.emplace(&cls, class_index_.size());
+    }
+
+    void WriteBinary(NodeTag tag, const BinaryOperation &node)
+    {
+        WriteTag(tag);
+        WriteNode(node.GetLhs());
+        WriteNode(node.GetRhs());
+    }
+
+    // Узел записывается номером строки, тегом и содержимым
+    void WriteNode(const Statement &node)
+    {
+        WriteVarint(node.GetLine());
+        WriteNodeContents(node);
+    }
+
+    void WriteNodeContents(const Statement &node)
+    {
+        if (auto num = dynamic_cast<const NumericConst *>(&node))
+        {
+            WriteTag(NodeTag::NumericConst);
+            // Число хранится в зигзаг-кодировке, чтобы небольшие отрицательные значения были короткими
+            const auto value = static_cast<int64_t>(num->GetValue().GetValue());
+            WriteVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+        else if (auto str = dynamic_cast<const StringConst *>(&node))
+        {
+            WriteTag(NodeTag::StringConst);
+            WriteString(str->GetValue().GetValue());
+        }
+        else if (auto boolean = dynamic_cast<const BoolConst *>(&node))
+        {
+            WriteTag(NodeTag::BoolConst);
+            WriteVarint(boolean->GetValue().GetValue() ? 1 : 0);
+        }
+        else if (dynamic_cast<const None *>(&node) != nullptr)
+        {
+            WriteTag(NodeTag::None);
+        }
+        else if (auto var = dynamic_cast<const VariableValue *>(&node))
+        {
+            WriteTag(NodeTag::VariableValue);
+            WriteVariable(*var);
+        }
+        else if (auto assign = dynamic_cast<const Assignment *>(&node))
+        {
+            WriteTag(NodeTag::Assignment);
+            WriteString(assign->GetVarName());
+            WriteVarint(EncodeSlot(assign->GetSlot()));
+            WriteNode(assign->GetRightValue());
+        }
+        else if (auto field_assign = dynamic_cast<const FieldAssignment *>(&node))
+        {
+            WriteTag(NodeTag::FieldAssignment);
+            WriteVariable(field_assign->GetObject());
+            WriteString(field_assign->GetFieldName());
+            WriteNode(field_assign->GetRightValue());
+        }
+        else if (auto print = dynamic_cast<const Print *>(&node))
+        {
+            WriteTag(NodeTag::Print);
+            WriteNodes(print->GetArgs());
+        }
+        else if (auto call = dynamic_cast<const MethodCall *>(&node))
+        {
+            WriteTag(NodeTag::MethodCall);
+            WriteNode(call->GetObject());
+            WriteString(call->GetMethodName());
+            WriteNodes(call->GetArgs());
+        }
+        else if (auto new_instance = dynamic_cast<const NewInstance *>(&node))
+        {
+            WriteTag(NodeTag::NewInstance);
+            WriteClassRef(new_instance->GetClass());
+            WriteNodes(new_instance->GetArgs());
+        }
+        else if (auto stringify = dynamic_cast<const Stringify *>(&node))
+        {
+            WriteTag(NodeTag::Stringify);
+            WriteNode(stringify->GetArgument());
+        }
+        else if (auto not_op = dynamic_cast<const Not *>(&node))
+        {
+            WriteTag(NodeTag::Not);
+            WriteNode(not_op->GetArgument());
+        }
+        else if (auto add = dynamic_cast<const Add *>(&node))
+        {
+            WriteBinary(NodeTag::Add, *add);
+        }
+        else if (auto sub = dynamic_cast<const Sub *>(&node))
+        {
+            WriteBinary(NodeTag::Sub, *sub);
+        }
+        else if (auto mult = dynamic_cast<const Mult *>(&node))
+        {
+            WriteBinary(NodeTag::Mult, *mult);
+        }
+        else if (auto div = dynamic_cast<const Div *>(&node))
+        {
+            WriteBinary(NodeTag::Div, *div);
+        }
+        else if (auto or_op = dynamic_cast<const Or *>(&node))
+        {
+            WriteBinary(NodeTag::Or, *or_op);
+        }
+        else if (auto and_op = dynamic_cast<const And *>(&node))
+        {
+            WriteBinary(NodeTag::And, *and_op);
+        }
+        else if (auto comparison = dynamic_cast<const Comparison *>(&node))
+        {
+            const optional<ComparisonOp> op = comparison->GetOp();
+            if (!op)
+            {
+                throw SerializationError("Cannot serialize a custom comparison"s);
+            }
+            WriteBinary(NodeTag::Comparison, *comparison);
+            WriteVarint(static_cast<uint64_t>(*op));
+        }
+        else if (auto compound = dynamic_cast<const Compound *>(&node))
+        {
+            WriteTag(NodeTag::Compound);
+            WriteNodes(compound->GetStatements());
+        }
+        else if (auto body = dynamic_cast<const MethodBody *>(&node))
+        {
+            WriteTag(NodeTag::MethodBody);
+            WriteNode(body->GetBody());
+        }
+        else if (auto ret = dynamic_cast<const Return *>(&node))
+        {
+            WriteTag(NodeTag::Return);
+            WriteNode(ret->GetStatement());
+        }
+        else if (auto class_def = dynamic_cast<const ClassDefinition *>(&node))
+        {
+            WriteTag(NodeTag::ClassDefinition);
+            WriteClass(*class_def->GetClass().TryAs<runtime::Class>());
+            WriteVarint(EncodeSlot(class_def->GetSlot()));
+        }
+        else if (auto if_else = dynamic_cast<const IfElse *>(&node))
+        {
+            WriteTag(NodeTag::IfElse);
+            WriteNode(if_else->GetCondition());
+            WriteNode(if_else->GetIfBody());
+            const Statement *else_body = if_else->GetElseBody();
+            WriteVarint(else_body != nullptr ? 1 : 0);
+            if (else_body != nullptr)
+            {
+                WriteNode(*else_body);
+            }
+        }
+        else
+        {
+            throw SerializationError("Cannot serialize an unknown syntax tree node"s);
+        }
+    }
+
+    string body_;
+    unordered_map<string, size_t> string_index_;
+    // Строки в порядке номеров. Ключи unordered_map не перемещаются при вставке
+    vector<string_view> strings_;
+    unordered_map<const runtime::Class *, size_t> class_index_;
+};
+
+class ImageReader
+{
+public:
+    explicit ImageReader(string_view image) : image_(image) {}
+
+    unique_ptr<Statement> ReadProgram()
+    {
+        if (!IsProgramImage(image_))
+        {
+            throw SerializationError("Not a Mython program image"s);
+        }
+        pos_ = IMAGE_MAGIC.size();
+        if (ReadVarint() != IMAGE_VERSION)
+        {
+            throw SerializationError("Unsupported program image version"s);
+        }
+
+        const size_t string_count = ReadCount();
+        strings_.reserve(string_count);
+        for (size_t i = 0; i < string_count; ++i)
+        {
+            const size_t size = ReadCount();
+            strings_.push_back(image_.substr(pos_, size));
+            pos_ += size;
+        }
+
+        auto program = ReadNode();
+        if (pos_ != image_.size())
+        {
+            Corrupted();
+        }
+        return program;
+    }
+
+private:
+    [[noreturn]] static void Corrupted()
+    {
+        throw SerializationError("Corrupted program image"s);
+    }
+
+    uint64_t ReadVarint()
+    {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos_ >= image_.size())
+            {
+                Corrupted();
+            }
+            const auto byte = static_cast<uint8_t>(image_[pos_++]);
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return result;
+            }
+        }
+        Corrupted();
+    }
+
+    // Количество элементов не может превышать размер оставшейся части образа
+    size_t ReadCount()
+    {
+        const uint64_t count = ReadVarint();
+        if (count > image_.size() - pos_)
+        {
+            Corrupted();
+        }
+        return static_cast<size_t>(count);
+    }
+
+    string ReadString()
+    {
+        return string(ReadStringView());
+    }
+
+    string_view ReadStringView()
+    {
+        const uint64_t index = ReadVarint();
+        if (index >= strings_.size())
+        {
+            Corrupted();
+        }
+        return strings_[index];
+    }
+
+    vector<string> ReadStrings()
+    {
+        vector<string> result(ReadCount());
+        for (string &str : result)
+        {
+            str = ReadString();
+        }
+        return result;
+    }
+
+    vector<unique_ptr<Statement>> ReadNodes()
+    {
+        vector<unique_ptr<Statement>> result(ReadCount());
+        for (auto &node : result)
+        {
+            node = ReadNode();
+        }
+        return result;
+    }
+
+    // Слоты есть только у кадров методов, поэтому номер слота не может превышать число слотов метода
+    size_t ReadSlot()
+    {
+        const size_t slot = DecodeSlot(ReadVarint());
+        if (slot != NO_SLOT && slot >= slot_count_)
+        {
+            Corrupted();
+        }
+        return slot;
+    }
+
+    VariableValue ReadVariable()
+    {
+        const size_t id_count = ReadCount();
+        if (id_count == 0)
+        {
+            Corrupted();
+        }
+        vector<string> dotted_ids(id_count);
+        for (string &id : dotted_ids)
+        {
+            id = ReadString();
+        }
+        VariableValue result(std::move(dotted_ids));
+        result.BindSlot(ReadSlot());
+        return result;
+    }
+
+    const runtime::Class &ReadClassRef()
+    {
+        const uint64_t index = ReadVarint();
+        if (index >= classes_.size())
+        {
+            Corrupted();
+        }
+        return *classes_[index].TryAs<runtime::Class>();
+    }
+
+    runtime::ObjectHolder ReadClass()
+    {
+        string name = ReadString();
+        const runtime::Class *parent = ReadVarint() != 0 ? &ReadClassRef() : nullptr;
+
+        vector<runtime::Method> methods(ReadCount());
+        for (runtime::Method &method : methods)
+        {
+            method.name = ReadString();
+            method.formal_params = ReadStrings();
+            method.slot_names = ReadStrings();
+            const size_t outer_slot_count = slot_count_;
+            slot_count_ = method.slot_names.size();
+            auto body = ReadNode();
+            slot_count_ = outer_slot_count;
+            if (dynamic_cast<MethodBody *>(body.get()) == nullptr)
+            {
+                Corrupted();
+            }
+            method.body = std::move(body);
+        }
+        classes_.push_back(runtime::ObjectHolder::Own(runtime::Class(std::move(name), std::move(methods), parent)));
+        return classes_.back();
+    }
+
+    template <typename Node>
+    unique_ptr<Statement> ReadBinary()
+    {
+        auto lhs = ReadNode();
+        auto rhs = ReadNode();
+        return make_unique<Node>(std::move(lhs), std::move(rhs));
+    }
+
+    unique_ptr<Statement> ReadNode()
+    {
+        const uint64_t line = ReadVarint();
+        if (line > numeric_limits<uint32_t>::max())
+        {
+            Corrupted();
+        }
+        auto node = ReadNodeContents();
+        node->SetLine(static_cast<uint32_t>(line));
+        return node;
+    }
+
+    unique_ptr<Statement> ReadNodeContents()
+    {
+        if (pos_ >= image_.size() || static_cast<uint8_t>(image_[pos_]) > LAST_TAG)
+        {
+            Corrupted();
+        }
+        switch (static_cast<NodeTag>(image_[pos_++]))
+        {
+        case NodeTag::NumericConst: {
+            const uint64_t value = ReadVarint();
+            const auto decoded = static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+            return make_unique<NumericConst>(runtime::Number(static_cast<int>(decoded)));
+        }
+        case NodeTag::StringConst:
+            return make_unique<StringConst>(runtime::String(ReadString()));
+        case NodeTag::BoolConst:
+            return make_unique<BoolConst>(runtime::Bool(ReadVarint() != 0));
+        case NodeTag::None:
+            return make_unique<None>();
+        case NodeTag::VariableValue:
+            return make_unique<VariableValue>(ReadVariable());
+        case NodeTag::Assignment: {
+            string var = ReadString();
+            const size_t slot = ReadSlot();
+            auto result = make_unique<Assignment>(std::move(var), ReadNode());
+            result->BindSlot(slot);
+            return result;
+        }
+        case NodeTag::FieldAssignment: {
+            VariableValue object = ReadVariable();
+            string field_name = ReadString();
+            return make_unique<FieldAssignment>(std::move(object), std::move(field_name), ReadNode());
+        }
+        case NodeTag::Print:
+            return make_unique<Print>(ReadNodes());
+        case NodeTag::MethodCall: {
+            auto object = ReadNode();
+            string method = ReadString();
+            return make_unique<MethodCall>(std::move(object), std::move(method), ReadNodes());
+        }
+        case NodeTag::NewInstance: {
+            const runtime::Class &cls = ReadClassRef();
+            return make_unique<NewInstance>(cls, ReadNodes());
+        }
+        case NodeTag::Stringify:
+            return make_unique<Stringify>(ReadNode());
+        case NodeTag::Not:
+            return make_unique<Not>(ReadNode());
+        case NodeTag::Add:
+            return ReadBinary<Add>();
+        case NodeTag::Sub:
+            return ReadBinary<Sub>();
+        case NodeTag::Mult:
+            return ReadBinary<Mult>();
+        case NodeTag::Div:
+            return ReadBinary<Div>();
+        case NodeTag::Or:
+            return ReadBinary<Or>();
+        case NodeTag::And:
+            return ReadBinary<And>();
+        case NodeTag::Comparison: {
+            auto lhs = ReadNode();
+            auto rhs = ReadNode();
+            const uint64_t op = ReadVarint();
+            if (op > LAST_COMPARISON)
+            {
+                Corrupted();
+            }
+            return MakeComparison(static_cast<ComparisonOp>(op), std::move(lhs), std::move(rhs));
+        }
+        case NodeTag::Compound: {
+            auto result = make_unique<Compound>();
+            const size_t count = ReadCount();
+            for (size_t i = 0; i < count; ++i)
+            {
+                result->AddStatement(ReadNode());
+            }
+            return result;
+        }
+        case NodeTag::MethodBody:
+            return make_unique<MethodBody>(ReadNode());
+        case NodeTag::Return:
+            return make_unique<Return>(ReadNode());
+        case NodeTag::ClassDefinition: {
+            auto result = make_unique<ClassDefinition>(ReadClass());
+            result->BindSlot(ReadSlot());
+            return result;
+        }
+        case NodeTag::IfElse: {
+            auto condition = ReadNode();
+            auto if_body = ReadNode();
+            auto else_body = ReadVarint() != 0 ? ReadNode() : nullptr;
+            return make_unique<IfElse>(std::move(condition), std::move(if_body), std::move(else_body));
+        }
+        }
+        Corrupted();
+    }
+
+    string_view image_;
+    size_t pos_ = 0;
+    vector<string_view> strings_;
+    // Классы в порядке номеров. Объекты классов принадлежат узлам ClassDefinition и этому списку
+    vector<runtime::ObjectHolder> classes_;
+    // Число слотов метода, тело которого читается сейчас; вне методов слотов нет
+    size_t slot_count_ = 0;
+};
+} // namespace
+
+bool IsProgramImage(string_view data)
+{
+    return data.substr(0, IMAGE_MAGIC.size()) == IMAGE_MAGIC;
+}
+
+void SerializeProgram(const Statement &program, ostream &output)
+{
+    ImageWriter().WriteProgram(program, output);
+}
+
+unique_ptr<Statement> DeserializeProgram(string_view image)
+{
+    // Как и в ParseProgram, узлы размещаются в одной арене
+    ArenaScope arena;
+    return ImageReader(image).ReadProgram();
+}
+
+} // namespace ast
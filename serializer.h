@@ -0,0 +1,40 @@
+#pragma once
+
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+
+namespace ast
+{
+
+class Statement;
+
+class SerializationError : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/*
+ * Двоичный образ программы (файл .myc). Образ начинается с сигнатуры IMAGE_MAGIC и номера версии,
+ * за которыми следуют таблица строк (идентификаторы и строковые константы) и узлы дерева
+ * с номерами строк исходного текста в прямом порядке обхода. Узлы ссылаются на строки и классы по номерам в таблицах,
+ * поэтому загрузка образа - однократный проход по буферу без лексического и синтаксического разбора
+ */
+constexpr std::string_view IMAGE_MAGIC = "\x7fMYC";
+
+// Проверяет, начинаются ли данные с сигнатуры образа программы
+[[nodiscard]] bool IsProgramImage(std::string_view data);
+
+/*
+ * Записывает в output образ дерева программы, построенного ParseProgram (и, возможно, Optimize).
+ * Узлы и методы, созданные не парсером (например, с пользовательским компаратором),
+ * не сериализуются: выбрасывается SerializationError
+ */
+void SerializeProgram(const Statement &program, std::ostream &output);
+
+// Восстанавливает дерево программы из образа. Повреждённый образ сообщается SerializationError
+std::unique_ptr<Statement> DeserializeProgram(std::string_view image);
+
+} // namespace ast
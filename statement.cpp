@@ -1,7 +1,6 @@
 #include "statement.h"
 
 #include <iostream>
-#include <sstream>
 
 using namespace std;
 
@@ -14,19 +13,50 @@ using runtime::ObjectHolder;
 
 namespace
 {
-const string ADD_METHOD = "__add__"s;
-const string INIT_METHOD = "__init__"s;
+const runtime::Symbol INIT_METHOD = "__init__";
 } // namespace
 
 ObjectHolder Assignment::Execute(Closure &closure, Context &context)
 {
-    closure[var_] = rv_->Execute(closure, context);
-    return closure.at(var_);
+    if (slot_ != NO_SLOT)
+    {
+        ObjectHolder value = rv_->Execute(closure, context);
+        closure.SetSlot(slot_, value);
+        return value;
+    }
+    ObjectHolder value = rv_->Execute(closure, context);
+    closure[var_.GetName()] = value;
+    return value;
 }
 
 Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv)
-    : var_(std::move(var)), rv_(std::move(rv))
+    : var_(var), rv_(std::move(rv))
+{
+}
+
+const std::string &Assignment::GetVarName() const
+{
+    return var_.GetName();
+}
+
+const Statement &Assignment::GetRightValue() const
+{
+    return *rv_;
+}
+
+void Assignment::ForEachChild(const ChildVisitor &visitor)
+{
+    visitor(rv_);
+}
+
+void Assignment::BindSlot(size_t slot)
+{
+    slot_ = slot;
+}
+
+size_t Assignment::GetSlot() const
 {
+    return slot_;
 }
 
 VariableValue::VariableValue(const std::string &var_name) : var_name_(var_name) {}
@@ -37,27 +67,57 @@ VariableValue::VariableValue(std::vector<std::string> dotted_ids)
     {
         return;
     }
-    var_name_ = std::move(dotted_ids[0]);
-    dotted_ids_.reserve(dotted_ids.size() - 1);
-    for (size_t i = 1; i < dotted_ids.size(); i++)
-    {
-        dotted_ids_.push_back(std::move(dotted_ids[i]));
-    }
+    var_name_ = dotted_ids[0];
+    dotted_ids_.assign(dotted_ids.begin() + 1, dotted_ids.end());
+    field_caches_.resize(dotted_ids_.size());
+}
+
+const std::string &VariableValue::GetName() const
+{
+    return var_name_.GetName();
+}
+
+const std::vector<runtime::Symbol> &VariableValue::GetDottedIds() const
+{
+    return dotted_ids_;
+}
+
+void VariableValue::BindSlot(size_t slot)
+{
+    slot_ = slot;
+}
+
+size_t VariableValue::GetSlot() const
+{
+    return slot_;
 }
 
 ObjectHolder VariableValue::Execute(Closure &closure, [[maybe_unused]] Context &context)
 {
-    auto iter = closure.find(var_name_);
-    if (iter != closure.end())
+    const ObjectHolder *value = nullptr;
+    if (slot_ != NO_SLOT)
+    {
+        value = closure.FindSlot(slot_);
+    }
+    else if (auto iter = closure.find(var_name_.GetName()); iter != closure.end())
     {
-        ObjectHolder current_object = iter->second;
+        value = &iter->second;
+    }
+
+    if (value != nullptr)
+    {
+        ObjectHolder current_object = *value;
         for (size_t i = 0; i < dotted_ids_.size(); i++)
         {
             runtime::ClassInstance *current_ptr = current_object.TryAs<runtime::ClassInstance>();
             if (current_ptr != nullptr)
             {
-                Closure &fields = current_ptr->Fields();
-                current_object = fields.at(dotted_ids_[i]);
+                ObjectHolder *field = field_caches_[i].Find(current_ptr->Fields(), dotted_ids_[i]);
+                if (field == nullptr)
+                {
+                    throw std::runtime_error("Field "s + dotted_ids_[i].GetName() + " not found"s);
+                }
+                current_object = *field;
             }
         }
         return current_object;
@@ -80,35 +140,79 @@ Print::Print(unique_ptr<Statement> argument)
 
 Print::Print(vector<unique_ptr<Statement>> args) : args_(std::move(args)) {}
 
+const std::vector<std::unique_ptr<Statement>> &Print::GetArgs() const
+{
+    return args_;
+}
+
+void Print::ForEachChild(const ChildVisitor &visitor)
+{
+    for (auto &arg : args_)
+    {
+        visitor(arg);
+    }
+}
+
 ObjectHolder Print::Execute(Closure &closure, Context &context)
 {
     bool is_first = true;
-    std::ostream &cur_output_stream = context.GetOutputStream();
     for (const auto &arg : args_)
     {
         if (!is_first)
         {
-            cur_output_stream << ' ';
+            context.GetOutputBuffer().Append(' ');
         }
         is_first = false;
-        ObjectHolder object = arg->Execute(closure, context);
-        if (object.Get() != nullptr)
-        {
-            object.Get()->Print(cur_output_stream, context);
-        }
-        else
-        {
-            cur_output_stream << "None";
-        }
+        runtime::PrintValue(arg->Execute(closure, context), context);
     }
-    cur_output_stream << '\n';
+    context.GetOutputBuffer().Append('\n');
     return {};
 }
 
 MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
                        std::vector<std::unique_ptr<Statement>> args)
-    : object_(std::move(object)), method_(std::move(method)), args_(std::move(args))
+    : object_(std::move(object)), method_(method), args_(std::move(args))
+{
+}
+
+const Statement &MethodCall::GetObject() const
 {
+    return *object_;
+}
+
+const std::string &MethodCall::GetMethodName() const
+{
+    return method_.GetName();
+}
+
+const std::vector<std::unique_ptr<Statement>> &MethodCall::GetArgs() const
+{
+    return args_;
+}
+
+void MethodCall::ForEachChild(const ChildVisitor &visitor)
+{
+    visitor(object_);
+    for (auto &arg : args_)
+    {
+        visitor(arg);
+    }
+}
+
+const runtime::Method &MethodCall::FindMethod(const runtime::ClassInstance &instance, std::vector<ObjectHolder> &args,
+                                              Closure &closure, Context &context)
+{
+    args.reserve(args_.size());
+    for (size_t i = 0; i < args_.size(); i++)
+    {
+        args.push_back(args_[i]->Execute(closure, context));
+    }
+    const runtime::Method *method = cache_.Find(instance.GetClass(), method_, args.size());
+    if (method == nullptr)
+    {
+        throw std::runtime_error("Cannot call method");
+    }
+    return *method;
 }
 
 ObjectHolder MethodCall::Execute(Closure &closure, Context &context)
@@ -118,151 +222,213 @@ ObjectHolder MethodCall::Execute(Closure &closure, Context &context)
     if (class_ptr != nullptr)
     {
         std::vector<ObjectHolder> method_args;
-        method_args.reserve(args_.size());
-        for (size_t i = 0; i < args_.size(); i++)
-        {
-            method_args.push_back(args_[i]->Execute(closure, context));
-        }
-        return class_ptr->Call(method_, method_args, context);
+        const runtime::Method &method = FindMethod(*class_ptr, method_args, closure, context);
+        return class_ptr->Call(method, method_args, context);
     }
     return ObjectHolder::None();
 }
 
-ObjectHolder Stringify::Execute(Closure &closure, Context &context)
+bool MethodCall::PrepareTailCall(Closure &closure, Context &context, runtime::TailCall &tail_call,
+                                 ObjectHolder &result)
 {
-    auto executed_arg = argument_->Execute(closure, context);
-    std::ostringstream result_str;
-    if (executed_arg.Get() != nullptr)
+    ObjectHolder current_object = object_->Execute(closure, context);
+    auto class_ptr = current_object.TryAs<runtime::ClassInstance>();
+    if (class_ptr == nullptr)
     {
-        executed_arg->Print(result_str, context);
-        return ObjectHolder::Own(runtime::String(result_str.str()));
+        result = ObjectHolder::None();
+        return false;
     }
-    else
-        return ObjectHolder::Own(runtime::String("None"));
+    tail_call.args.clear();
+    tail_call.method = &FindMethod(*class_ptr, tail_call.args, closure, context);
+    tail_call.self = std::move(current_object);
+    return true;
+}
+
+ObjectHolder Stringify::Execute(Closure &closure, Context &context)
+{
+    return ObjectHolder::Own(runtime::String(runtime::ToString(argument_->Execute(closure, context), context)));
 }
 
 ObjectHolder Add::Execute(Closure &closure, Context &context)
 {
     ObjectHolder lhs = lhs_->Execute(closure, context);
     ObjectHolder rhs = rhs_->Execute(closure, context);
-
-    auto class_ptr = lhs.TryAs<runtime::ClassInstance>();
-    if (class_ptr != nullptr)
+    switch (feedback_.Get())
     {
-        if (class_ptr->HasMethod(ADD_METHOD, 1U))
+    case OperandTypes::Numbers: {
+        const auto *left = lhs.TryAs<runtime::Number>();
+        const auto *right = rhs.TryAs<runtime::Number>();
+        if (left != nullptr && right != nullptr)
         {
-            return class_ptr->Call(ADD_METHOD, {rhs}, context);
+            return ObjectHolder::Own(runtime::Number(left->GetValue() + right->GetValue()));
         }
+        break;
     }
-
-#define ADDABLE_VALUE(type)                                                                                  \
-    {                                                                                                        \
-        auto lhs_ptr = lhs.TryAs<type>();                                                                    \
-        auto rhs_ptr = rhs.TryAs<type>();                                                                    \
-        if (lhs_ptr != nullptr && rhs_ptr != nullptr)                                                        \
-        {                                                                                                    \
-            return ObjectHolder::Own(type(lhs_ptr->GetValue() + rhs_ptr->GetValue()));                       \
-        }                                                                                                    \
+    case OperandTypes::Strings:
+        if (lhs.GetKind() == runtime::ObjectKind::String && rhs.GetKind() == runtime::ObjectKind::String)
+        {
+            return runtime::String::Concat(lhs, rhs);
+        }
+        break;
+    case OperandTypes::Unknown:
+        feedback_.Record(OperandFeedback::Classify(lhs, rhs));
+        [[fallthrough]];
+    case OperandTypes::Generic:
+        return runtime::Add(lhs, rhs, context);
     }
-
-    ADDABLE_VALUE(runtime::String);
-    ADDABLE_VALUE(runtime::Number);
-
-#undef ADDABLE_VALUE
-
-    throw std::runtime_error("Failed to Add::Execute ");
+    // Типы операндов отличаются от наблюдавшихся ранее
+    feedback_.Record(OperandTypes::Generic);
+    return runtime::Add(lhs, rhs, context);
 }
 
 ObjectHolder Sub::Execute(Closure &closure, Context &context)
 {
     ObjectHolder lhs = lhs_->Execute(closure, context);
     ObjectHolder rhs = rhs_->Execute(closure, context);
-    auto number_lhs_ptr = lhs.TryAs<runtime::Number>();
-    auto number_rhs_ptr = rhs.TryAs<runtime::Number>();
-
-    if (number_lhs_ptr != nullptr && number_rhs_ptr != nullptr)
-    {
-        return ObjectHolder::Own(runtime::Number(number_lhs_ptr->GetValue() - number_rhs_ptr->GetValue()));
-    }
-
-    throw std::runtime_error("Failed to Sub::Execute ");
+    return runtime::Sub(lhs, rhs);
 }
 
 ObjectHolder Mult::Execute(Closure &closure, Context &context)
 {
     ObjectHolder lhs = lhs_->Execute(closure, context);
     ObjectHolder rhs = rhs_->Execute(closure, context);
-    auto number_lhs_ptr = lhs.TryAs<runtime::Number>();
-    auto number_rhs_ptr = rhs.TryAs<runtime::Number>();
-
-    if (number_lhs_ptr != nullptr && number_rhs_ptr != nullptr)
-    {
-        return ObjectHolder::Own(runtime::Number(number_lhs_ptr->GetValue() * number_rhs_ptr->GetValue()));
-    }
-
-    throw std::runtime_error("Failed to Mult::Execute ");
+    return runtime::Mult(lhs, rhs);
 }
 
 ObjectHolder Div::Execute(Closure &closure, Context &context)
 {
     ObjectHolder lhs = lhs_->Execute(closure, context);
     ObjectHolder rhs = rhs_->Execute(closure, context);
-    auto number_lhs_ptr = lhs.TryAs<runtime::Number>();
-    auto number_rhs_ptr = rhs.TryAs<runtime::Number>();
+    return runtime::Div(lhs, rhs);
+}
 
-    if (number_lhs_ptr != nullptr && number_rhs_ptr != nullptr)
+ObjectHolder Compound::Execute(Closure &closure, Context &context)
+{
+    ObjectHolder result;
+    return Run(closure, context, result) == Completion::Return ? result : ObjectHolder::None();
+}
+
+Completion Compound::Run(Closure &closure, Context &context, ObjectHolder &result)
+{
+    for (const auto &arg : args_)
     {
-        if (number_rhs_ptr->GetValue() != 0)
+        context.Step();
+        if (arg->Run(closure, context, result) == Completion::Return)
         {
-            int result = number_lhs_ptr->GetValue() / number_rhs_ptr->GetValue();
-            return ObjectHolder::Own(runtime::Number(result));
-        }
-        else
-        {
-            throw std::runtime_error("Сannot be divided by 0 ");
+            return Completion::Return;
         }
     }
-    else
-    {
-        throw std::runtime_error("Failed to Div::Execute ");
-    }
+    result = ObjectHolder::None();
+    return Completion::Normal;
 }
 
-ObjectHolder Compound::Execute(Closure &closure, Context &context)
+Return::Return(std::unique_ptr<Statement> statement)
+    : statement_(std::move(statement))
 {
-    for (const auto &arg : args_)
+}
+
+ObjectHolder Return::Execute(Closure &closure, Context &context)
+{
+    return statement_->Execute(closure, context);
+}
+
+Completion Return::Run(Closure &closure, Context &context, ObjectHolder &result)
+{
+    runtime::TailCall *pending = context.GetTailCall();
+    if (pending == nullptr)
     {
-        arg->Execute(closure, context);
+        result = statement_->Execute(closure, context);
     }
-    return {};
+    else if (statement_->PrepareTailCall(closure, context, *pending, result))
+    {
+        // Значение хвостового вызова вычислит ClassInstance::Call
+        result = ObjectHolder::None();
+    }
+    return Completion::Return;
 }
 
-ObjectHolder Return::Execute(Closure &closure, Context &context)
+void Return::ForEachChild(const ChildVisitor &visitor)
 {
-    throw statement_->Execute(closure, context);
+    visitor(statement_);
 }
 
-ClassDefinition::ClassDefinition(ObjectHolder cls) : cls_(std::move(cls)) {}
+ClassDefinition::ClassDefinition(ObjectHolder cls) : cls_(std::move(cls))
+{
+    // Дерево может исполняться одновременно из нескольких потоков, и каждый запуск копирует ссылку на класс
+    cls_.ShareBetweenThreads();
+}
+
+const ObjectHolder &ClassDefinition::GetClass() const
+{
+    return cls_;
+}
+
+void ClassDefinition::BindSlot(size_t slot)
+{
+    slot_ = slot;
+}
+
+size_t ClassDefinition::GetSlot() const
+{
+    return slot_;
+}
+
+void ClassDefinition::ForEachChild(const ChildVisitor &visitor)
+{
+    // Унаследованные методы принадлежат родительскому классу и обходятся вместе с его определением
+    for (const runtime::Method &method : cls_.TryAs<runtime::Class>()->GetMethods())
+    {
+        if (auto body = dynamic_cast<MethodBody *>(method.body.get()))
+        {
+            body->ForEachChild(visitor);
+        }
+    }
+}
 
 ObjectHolder ClassDefinition::Execute(Closure &closure, [[maybe_unused]] Context &context)
 {
+    if (slot_ != NO_SLOT)
+    {
+        closure.SetSlot(slot_, cls_);
+        return {};
+    }
     closure[cls_.TryAs<runtime::Class>()->GetName()] = cls_;
     return {};
 }
 
 FieldAssignment::FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv)
-    : object_(std::move(object)), field_name_(std::move(field_name)), rv_(std::move(rv))
+    : object_(std::move(object)), field_name_(field_name), rv_(std::move(rv))
 {
 }
 
+const VariableValue &FieldAssignment::GetObject() const
+{
+    return object_;
+}
+
+const std::string &FieldAssignment::GetFieldName() const
+{
+    return field_name_.GetName();
+}
+
+const Statement &FieldAssignment::GetRightValue() const
+{
+    return *rv_;
+}
+
+void FieldAssignment::ForEachChild(const ChildVisitor &visitor)
+{
+    visitor(rv_);
+}
+
 ObjectHolder FieldAssignment::Execute(Closure &closure, Context &context)
 {
     auto class_ptr = object_.Execute(closure, context).TryAs<runtime::ClassInstance>();
     if (class_ptr != nullptr)
     {
-        Closure &fields = class_ptr->Fields();
-        fields[field_name_] = rv_->Execute(closure, context);
-        return fields.at(field_name_);
+        ObjectHolder value = rv_->Execute(closure, context);
+        field_cache_.Assign(class_ptr->Fields(), field_name_) = value;
+        return value;
     }
     else
     {
@@ -276,17 +442,50 @@ IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement>
 {
 }
 
+const Statement &IfElse::GetCondition() const
+{
+    return *condition_;
+}
+
+const Statement &IfElse::GetIfBody() const
+{
+    return *if_body_;
+}
+
+const Statement *IfElse::GetElseBody() const
+{
+    return else_body_.get();
+}
+
+void IfElse::ForEachChild(const ChildVisitor &visitor)
+{
+    visitor(condition_);
+    visitor(if_body_);
+    if (else_body_ != nullptr)
+    {
+        visitor(else_body_);
+    }
+}
+
 ObjectHolder IfElse::Execute(Closure &closure, Context &context)
+{
+    ObjectHolder result;
+    Run(closure, context, result);
+    return result;
+}
+
+Completion IfElse::Run(Closure &closure, Context &context, ObjectHolder &result)
 {
     if (runtime::IsTrue(condition_->Execute(closure, context)))
     {
-        return if_body_->Execute(closure, context);
+        return if_body_->Run(closure, context, result);
     }
     else if (else_body_ != nullptr)
     {
-        return else_body_->Execute(closure, context);
+        return else_body_->Run(closure, context, result);
     }
-    return {};
+    result = ObjectHolder::None();
+    return Completion::Normal;
 }
 
 ObjectHolder Or::Execute(Closure &closure, Context &context)
@@ -321,26 +520,77 @@ ObjectHolder Not::Execute(Closure &closure, Context &context)
 }
 
 Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
-    : BinaryOperation(std::move(lhs), std::move(rhs)), comparator_(std::move(cmp))
+    : BinaryOperation(std::move(lhs), std::move(rhs)), comparator_(make_unique<const Comparator>(std::move(cmp)))
+{
+}
+
+Comparison::Comparison(ComparisonOp op, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
+    : BinaryOperation(std::move(lhs), std::move(rhs)), op_(op)
+{
+}
+
+Comparison::Comparator Comparison::GetComparator() const
 {
+    return *comparator_;
 }
 
 ObjectHolder Comparison::Execute(Closure &closure, Context &context)
 {
-    return ObjectHolder::Own(runtime::Bool(
-        comparator_(lhs_->Execute(closure, context), rhs_->Execute(closure, context), context)));
+    ObjectHolder lhs = lhs_->Execute(closure, context);
+    ObjectHolder rhs = rhs_->Execute(closure, context);
+    return ObjectHolder::Own(runtime::Bool((*comparator_)(lhs, rhs, context)));
+}
+
+unique_ptr<Comparison> MakeComparison(ComparisonOp op, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
+{
+    switch (op)
+    {
+    case ComparisonOp::Equal:
+        return make_unique<StaticComparison<ComparisonOp::Equal>>(std::move(lhs), std::move(rhs));
+    case ComparisonOp::NotEqual:
+        return make_unique<StaticComparison<ComparisonOp::NotEqual>>(std::move(lhs), std::move(rhs));
+    case ComparisonOp::Less:
+        return make_unique<StaticComparison<ComparisonOp::Less>>(std::move(lhs), std::move(rhs));
+    case ComparisonOp::Greater:
+        return make_unique<StaticComparison<ComparisonOp::Greater>>(std::move(lhs), std::move(rhs));
+    case ComparisonOp::LessOrEqual:
+        return make_unique<StaticComparison<ComparisonOp::LessOrEqual>>(std::move(lhs), std::move(rhs));
+    case ComparisonOp::GreaterOrEqual:
+        return make_unique<StaticComparison<ComparisonOp::GreaterOrEqual>>(std::move(lhs), std::move(rhs));
+    }
+    throw std::invalid_argument("Unknown comparison"s);
 }
 
 NewInstance::NewInstance(const runtime::Class &_class, std::vector<std::unique_ptr<Statement>> args)
-    : class_instance_(_class), args_(std::move(args))
+    : class_(_class), args_(std::move(args))
 {
 }
 
-NewInstance::NewInstance(const runtime::Class &_class) : class_instance_(_class) {}
+NewInstance::NewInstance(const runtime::Class &_class) : class_(_class) {}
+
+const runtime::Class &NewInstance::GetClass() const
+{
+    return class_;
+}
+
+const std::vector<std::unique_ptr<Statement>> &NewInstance::GetArgs() const
+{
+    return args_;
+}
+
+void NewInstance::ForEachChild(const ChildVisitor &visitor)
+{
+    for (auto &arg : args_)
+    {
+        visitor(arg);
+    }
+}
 
 ObjectHolder NewInstance::Execute(Closure &closure, Context &context)
 {
-    if (class_instance_.HasMethod(INIT_METHOD, args_.size()))
+    ObjectHolder instance = ObjectHolder::Own(runtime::ClassInstance(class_));
+    const runtime::Method *init = class_.GetMethod(INIT_METHOD);
+    if (init != nullptr && init->formal_params.size() == args_.size())
     {
         std::vector<ObjectHolder> tmp_args;
         tmp_args.reserve(args_.size());
@@ -348,27 +598,23 @@ ObjectHolder NewInstance::Execute(Closure &closure, Context &context)
         {
             tmp_args.push_back(arg->Execute(closure, context));
         }
-        class_instance_.Call(INIT_METHOD, tmp_args, context);
+        instance.TryAs<runtime::ClassInstance>()->Call(*init, tmp_args, context);
     }
-    return ObjectHolder::Share(class_instance_);
+    return instance;
 }
 
 MethodBody::MethodBody(std::unique_ptr<Statement> &&body) : body_(std::move(body)) {}
 
+const Statement &MethodBody::GetBody() const
+{
+    return *body_;
+}
+
 ObjectHolder MethodBody::Execute(Closure &closure, Context &context)
 {
-    try
-    {
-        return body_->Execute(closure, context);
-    }
-    catch (ObjectHolder &obj)
-    {
-        return obj;
-    }
-    catch (...)
-    {
-        throw std::runtime_error("MethodBody::Catched undefined object");
-    }
+    ObjectHolder result;
+    body_->Run(closure, context, result);
+    return result;
 }
 
 } // namespace ast
\ No newline at end of file
@@ -1,13 +1,90 @@
 #pragma once
 
+#include "arena.h"
 #include "runtime.h"
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <limits>
+#include <optional>
 
 namespace ast
 {
 
-using Statement = runtime::Executable;
+// Способ завершения инструкции: обычное либо выполнением инструкции return
+enum class Completion
+{
+    Normal,
+    Return,
+};
+
+/*
+ * Узел синтаксического дерева. Узлы, созданные внутри ArenaScope (например, в ParseProgram),
+ * размещаются в арене и освобождаются вместе с ней
+ */
+class Statement : public runtime::Executable
+{
+public:
+    using ChildVisitor = std::function<void(std::unique_ptr<Statement> &)>;
+
+    static void *operator new(size_t size)
+    {
+        void *node = AllocateNode(size);
+        memory::OnAllocate(memory::Category::AstNodes, size);
+        return node;
+    }
+
+    // Размер удаляемого узла известен благодаря виртуальному деструктору
+    static void operator delete(void *node, size_t size)
+    {
+        memory::OnDeallocate(memory::Category::AstNodes, size);
+        FreeNode(node);
+    }
+
+    /*
+     * Исполняет инструкцию, записывая её значение в result.
+     * Если внутри инструкции была выполнена инструкция return, возвращает Completion::Return,
+     * а result содержит возвращаемое значение. Исключения используются только для ошибок времени выполнения
+     */
+    virtual Completion Run(runtime::Closure &closure, runtime::Context &context, runtime::ObjectHolder &result)
+    {
+        result = Execute(closure, context);
+        return Completion::Normal;
+    }
+
+    /*
+     * Исполняет инструкцию в хвостовой позиции метода (return <инструкция>). Вызов метода экземпляра класса
+     * не исполняется, а записывается в tail_call, и возвращается true. Иначе значение инструкции
+     * записывается в result и возвращается false
+     */
+    virtual bool PrepareTailCall(runtime::Closure &closure, runtime::Context &context,
+                                 [[maybe_unused]] runtime::TailCall &tail_call, runtime::ObjectHolder &result)
+    {
+        result = Execute(closure, context);
+        return false;
+    }
+
+    // Передаёт visitor каждый непосредственный дочерний узел. Посетитель может заменить узел
+    virtual void ForEachChild([[maybe_unused]] const ChildVisitor &visitor) {}
+
+    // Номер строки исходного текста, на которой начинается инструкция, либо 0, если он неизвестен
+    [[nodiscard]] uint32_t GetLine() const
+    {
+        return line_;
+    }
+
+    void SetLine(uint32_t line)
+    {
+        line_ = line;
+    }
+
+private:
+    uint32_t line_ = 0;
+};
+
+// Номер слота переменной, имя которой не разрешено на этапе разбора (поиск ведётся по имени)
+constexpr size_t NO_SLOT = std::numeric_limits<size_t>::max();
 
 template <typename T>
 class ValueStatement : public Statement
@@ -17,7 +94,20 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure & /*closure*/, runtime::Context & /*context*/) override
     {
-        return runtime::ObjectHolder::Share(value_);
+        // Числа и логические значения хранятся внутри ObjectHolder, на узел ссылаются только строки
+        if constexpr (std::is_same_v<T, runtime::Number> || std::is_same_v<T, runtime::Bool>)
+        {
+            return runtime::ObjectHolder::Own(T(value_.GetValue()));
+        }
+        else
+        {
+            return runtime::ObjectHolder::Share(value_);
+        }
+    }
+
+    [[nodiscard]] const T &GetValue() const
+    {
+        return value_;
     }
 
 private:
@@ -40,9 +130,23 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    // Имя переменной (первый идентификатор цепочки)
+    [[nodiscard]] const std::string &GetName() const;
+
+    // Имена полей, следующие за именем переменной
+    [[nodiscard]] const std::vector<runtime::Symbol> &GetDottedIds() const;
+
+    // Связывает переменную со слотом кадра метода
+    void BindSlot(size_t slot);
+
+    [[nodiscard]] size_t GetSlot() const;
+
 private:
-    std::string var_name_;
-    std::vector<std::string> dotted_ids_;
+    runtime::Symbol var_name_;
+    std::vector<runtime::Symbol> dotted_ids_;
+    // Кеши обращения к полям, по одному на каждый элемент dotted_ids_
+    std::vector<runtime::FieldCache> field_caches_;
+    size_t slot_ = NO_SLOT;
 };
 
 // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
@@ -53,9 +157,21 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    [[nodiscard]] const std::string &GetVarName() const;
+
+    [[nodiscard]] const Statement &GetRightValue() const;
+
+    // Связывает переменную со слотом кадра метода
+    void BindSlot(size_t slot);
+
+    [[nodiscard]] size_t GetSlot() const;
+
+    void ForEachChild(const ChildVisitor &visitor) override;
+
 private:
-    std::string var_;
+    runtime::Symbol var_;
     std::unique_ptr<Statement> rv_;
+    size_t slot_ = NO_SLOT;
 };
 
 // Присваивает полю object.field_name значение выражения rv
@@ -66,10 +182,19 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    [[nodiscard]] const VariableValue &GetObject() const;
+
+    [[nodiscard]] const std::string &GetFieldName() const;
+
+    [[nodiscard]] const Statement &GetRightValue() const;
+
+    void ForEachChild(const ChildVisitor &visitor) override;
+
 private:
     VariableValue object_;
-    std::string field_name_;
+    runtime::Symbol field_name_;
     std::unique_ptr<Statement> rv_;
+    runtime::FieldCache field_cache_;
 };
 
 class None : public Statement
@@ -94,6 +219,10 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>> &GetArgs() const;
+
+    void ForEachChild(const ChildVisitor &visitor) override;
+
 private:
     std::vector<std::unique_ptr<Statement>> args_;
 };
@@ -107,14 +236,32 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    [[nodiscard]] const Statement &GetObject() const;
+
+    [[nodiscard]] const std::string &GetMethodName() const;
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>> &GetArgs() const;
+
+    void ForEachChild(const ChildVisitor &visitor) override;
+
+    // Вычисляет объект и параметры вызова и записывает вызов в tail_call вместо его исполнения.
+    // Если объект - не экземпляр класса, вызов не планируется (значение вызова - None)
+    bool PrepareTailCall(runtime::Closure &closure, runtime::Context &context, runtime::TailCall &tail_call,
+                         runtime::ObjectHolder &result) override;
+
 private:
+    // Вычисляет параметры вызова и находит метод объекта instance
+    const runtime::Method &FindMethod(const runtime::ClassInstance &instance, std::vector<runtime::ObjectHolder> &args,
+                                      runtime::Closure &closure, runtime::Context &context);
+
     std::unique_ptr<Statement> object_;
-    std::string method_;
+    runtime::Symbol method_;
     std::vector<std::unique_ptr<Statement>> args_;
+    runtime::MethodCache cache_;
 };
 
 /*
-Создаёт новый экземпляр класса class_, передавая его конструктору набор параметров args.
+Создаёт новый экземпляр класса class_ при каждом выполнении, передавая его конструктору набор параметров args.
 Если в классе отсутствует метод __init__ с заданным количеством аргументов,
 то экземпляр класса создаётся без вызова конструктора (поля объекта не будут проинициализированы):
 */
@@ -126,8 +273,14 @@ public:
     NewInstance(const runtime::Class &_class, std::vector<std::unique_ptr<Statement>> args);
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    [[nodiscard]] const runtime::Class &GetClass() const;
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>> &GetArgs() const;
+
+    void ForEachChild(const ChildVisitor &visitor) override;
+
 private:
-    runtime::ClassInstance class_instance_;
+    const runtime::Class &class_;
     std::vector<std::unique_ptr<Statement>> args_;
 };
 
@@ -136,6 +289,16 @@ class UnaryOperation : public Statement
 public:
     explicit UnaryOperation(std::unique_ptr<Statement> argument) : argument_(std::move(argument)) {}
 
+    [[nodiscard]] const Statement &GetArgument() const
+    {
+        return *argument_;
+    }
+
+    void ForEachChild(const ChildVisitor &visitor) override
+    {
+        visitor(argument_);
+    }
+
 protected:
     std::unique_ptr<Statement> argument_;
 };
@@ -156,11 +319,80 @@ public:
     {
     }
 
+    [[nodiscard]] const Statement &GetLhs() const
+    {
+        return *lhs_;
+    }
+
+    [[nodiscard]] const Statement &GetRhs() const
+    {
+        return *rhs_;
+    }
+
+    void ForEachChild(const ChildVisitor &visitor) override
+    {
+        visitor(lhs_);
+        visitor(rhs_);
+    }
+
 protected:
     std::unique_ptr<Statement> lhs_;
     std::unique_ptr<Statement> rhs_;
 };
 
+// Типы операндов, которые наблюдал узел операции
+enum class OperandTypes : uint8_t
+{
+    // Узел ещё не исполнялся
+    Unknown,
+    Numbers,
+    Strings,
+    // Операнды других типов либо разных пар типов
+    Generic,
+};
+
+/*
+ * Специализация узла под типы операндов (quickening). Первое исполнение узла запоминает пару типов
+ * операндов, а последующие выполняют операцию над ними напрямую, лишь проверяя типы. Если проверка
+ * не проходит, узел навсегда переходит к общему пути. Состояние атомарно, поэтому дерево по-прежнему
+ * можно исполнять одновременно из нескольких потоков
+ */
+class OperandFeedback
+{
+public:
+    [[nodiscard]] OperandTypes Get() const
+    {
+        return types_.load(std::memory_order_relaxed);
+    }
+
+    void Record(OperandTypes types)
+    {
+        types_.store(types, std::memory_order_relaxed);
+    }
+
+    // Пара типов операндов при первом исполнении узла
+    [[nodiscard]] static OperandTypes Classify(const runtime::ObjectHolder &lhs, const runtime::ObjectHolder &rhs)
+    {
+        const runtime::ObjectKind kind = lhs.GetKind();
+        if (kind != rhs.GetKind())
+        {
+            return OperandTypes::Generic;
+        }
+        switch (kind)
+        {
+        case runtime::ObjectKind::Number:
+            return OperandTypes::Numbers;
+        case runtime::ObjectKind::String:
+            return OperandTypes::Strings;
+        default:
+            return OperandTypes::Generic;
+        }
+    }
+
+private:
+    std::atomic<OperandTypes> types_ = OperandTypes::Unknown;
+};
+
 class Add : public BinaryOperation
 {
 public:
@@ -172,6 +404,14 @@ public:
     //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
     // В противном случае при вычислении выбрасывается runtime_error
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
+
+    [[nodiscard]] OperandTypes GetOperandTypes() const
+    {
+        return feedback_.Get();
+    }
+
+private:
+    OperandFeedback feedback_;
 };
 
 class Sub : public BinaryOperation
@@ -261,8 +501,25 @@ public:
         args_.push_back(std::move(stmt));
     }
 
+    // Возвращает значение инструкции return, если она была выполнена, иначе None
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    Completion Run(runtime::Closure &closure, runtime::Context &context,
+                            runtime::ObjectHolder &result) override;
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>> &GetStatements() const
+    {
+        return args_;
+    }
+
+    void ForEachChild(const ChildVisitor &visitor) override
+    {
+        for (auto &stmt : args_)
+        {
+            visitor(stmt);
+        }
+    }
+
 private:
     std::vector<std::unique_ptr<Statement>> args_;
 };
@@ -278,6 +535,13 @@ public:
     // В противном случае возвращает None
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    [[nodiscard]] const Statement &GetBody() const;
+
+    void ForEachChild(const ChildVisitor &visitor) override
+    {
+        visitor(body_);
+    }
+
 private:
     std::unique_ptr<Statement> body_;
 };
@@ -285,10 +549,26 @@ private:
 class Return : public Statement
 {
 public:
-    explicit Return(std::unique_ptr<Statement> statement) : statement_(std::move(statement)) {}
+    explicit Return(std::unique_ptr<Statement> statement);
 
+    // Вычисляет возвращаемое значение
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    /*
+     * Вычисляет возвращаемое значение и сообщает о завершении метода.
+     * Вызов метода (return obj.method(...)) внутри метода не исполняется рекурсивно,
+     * а планируется как хвостовой вызов в кадре вызывающего ClassInstance::Call
+     */
+    Completion Run(runtime::Closure &closure, runtime::Context &context,
+                            runtime::ObjectHolder &result) override;
+
+    [[nodiscard]] const Statement &GetStatement() const
+    {
+        return *statement_;
+    }
+
+    void ForEachChild(const ChildVisitor &visitor) override;
+
 private:
     std::unique_ptr<Statement> statement_;
 };
@@ -300,8 +580,19 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    [[nodiscard]] const runtime::ObjectHolder &GetClass() const;
+
+    // Связывает имя класса со слотом кадра метода, если класс объявлен внутри метода
+    void BindSlot(size_t slot);
+
+    [[nodiscard]] size_t GetSlot() const;
+
+    // Обходит тела методов класса
+    void ForEachChild(const ChildVisitor &visitor) override;
+
 private:
     runtime::ObjectHolder cls_;
+    size_t slot_ = NO_SLOT;
 };
 
 class IfElse : public Statement
@@ -312,15 +603,40 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    Completion Run(runtime::Closure &closure, runtime::Context &context,
+                            runtime::ObjectHolder &result) override;
+
+    [[nodiscard]] const Statement &GetCondition() const;
+
+    [[nodiscard]] const Statement &GetIfBody() const;
+
+    // Возвращает nullptr, если ветка else отсутствует
+    [[nodiscard]] const Statement *GetElseBody() const;
+
+    void ForEachChild(const ChildVisitor &visitor) override;
+
 private:
     std::unique_ptr<Statement> condition_;
     std::unique_ptr<Statement> if_body_;
     std::unique_ptr<Statement> else_body_;
 };
 
+// Сравнения языка
+enum class ComparisonOp : uint8_t
+{
+    Equal,
+    NotEqual,
+    Less,
+    Greater,
+    LessOrEqual,
+    GreaterOrEqual,
+};
+
+// Сравнение произвольной функцией. Сравнения языка создаются как StaticComparison
 class Comparison : public BinaryOperation
 {
 public:
+    using Function = bool (*)(const runtime::ObjectHolder &, const runtime::ObjectHolder &, runtime::Context &);
     using Comparator =
         std::function<bool(const runtime::ObjectHolder &, const runtime::ObjectHolder &, runtime::Context &)>;
 
@@ -328,8 +644,130 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override;
 
+    // Функция сравнения. У сравнений языка это GetComparisonFunction(*GetOp())
+    [[nodiscard]] virtual Comparator GetComparator() const;
+
+    // Сравнение языка, которое выполняет узел, либо nullopt для произвольной функции
+    [[nodiscard]] std::optional<ComparisonOp> GetOp() const
+    {
+        return op_;
+    }
+
+    [[nodiscard]] OperandTypes GetOperandTypes() const
+    {
+        return feedback_.Get();
+    }
+
+protected:
+    Comparison(ComparisonOp op, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
+
+    OperandFeedback feedback_;
+
 private:
-    Comparator comparator_;
+    std::optional<ComparisonOp> op_;
+    // Произвольная функция сравнения. У сравнений языка отсутствует
+    std::unique_ptr<const Comparator> comparator_;
 };
 
+// Функция runtime (Equal, Less, ...), выполняющая сравнение op
+constexpr Comparison::Function GetComparisonFunction(ComparisonOp op)
+{
+    switch (op)
+    {
+    case ComparisonOp::Equal:
+        return &runtime::Equal;
+    case ComparisonOp::NotEqual:
+        return &runtime::NotEqual;
+    case ComparisonOp::Less:
+        return &runtime::Less;
+    case ComparisonOp::Greater:
+        return &runtime::Greater;
+    case ComparisonOp::LessOrEqual:
+        return &runtime::LessOrEqual;
+    case ComparisonOp::GreaterOrEqual:
+        return &runtime::GreaterOrEqual;
+    }
+    return nullptr;
+}
+
+/*
+ * Сравнение языка, заданное параметром шаблона: функция runtime вызывается напрямую,
+ * а сравнение чисел после специализации узла (см. OperandFeedback) выполняется без вызова.
+ * GetComparator возвращает функцию GetComparisonFunction(Op)
+ */
+template <ComparisonOp Op>
+class StaticComparison final : public Comparison
+{
+public:
+    StaticComparison(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs)
+        : Comparison(Op, std::move(lhs), std::move(rhs))
+    {
+    }
+
+    [[nodiscard]] Comparator GetComparator() const override
+    {
+        return FUNCTION;
+    }
+
+    runtime::ObjectHolder Execute(runtime::Closure &closure, runtime::Context &context) override
+    {
+        runtime::ObjectHolder lhs = lhs_->Execute(closure, context);
+        runtime::ObjectHolder rhs = rhs_->Execute(closure, context);
+        const OperandTypes types = feedback_.Get();
+        if (types == OperandTypes::Numbers)
+        {
+            const auto *left = lhs.TryAs<runtime::Number>();
+            const auto *right = rhs.TryAs<runtime::Number>();
+            if (left != nullptr && right != nullptr)
+            {
+                return runtime::ObjectHolder::Own(runtime::Bool(CompareNumbers(left->GetValue(), right->GetValue())));
+            }
+            feedback_.Record(OperandTypes::Generic);
+        }
+        else if (types == OperandTypes::Unknown)
+        {
+            // Для строк и других типов специализированного пути нет
+            const OperandTypes seen = OperandFeedback::Classify(lhs, rhs);
+            feedback_.Record(seen == OperandTypes::Numbers ? seen : OperandTypes::Generic);
+        }
+        return runtime::ObjectHolder::Own(runtime::Bool(FUNCTION(lhs, rhs, context)));
+    }
+
+private:
+    static constexpr Function FUNCTION = GetComparisonFunction(Op);
+
+    static constexpr bool CompareNumbers(int lhs, int rhs)
+    {
+        if constexpr (Op == ComparisonOp::Equal)
+        {
+            return lhs == rhs;
+        }
+        else if constexpr (Op == ComparisonOp::NotEqual)
+        {
+            return lhs != rhs;
+        }
+        else if constexpr (Op == ComparisonOp::Less)
+        {
+            return lhs < rhs;
+        }
+        else if constexpr (Op == ComparisonOp::Greater)
+        {
+            return lhs > rhs;
+        }
+        else if constexpr (Op == ComparisonOp::LessOrEqual)
+        {
+            return lhs <= rhs;
+        }
+        else
+        {
+            static_assert(Op == ComparisonOp::GreaterOrEqual);
+            return lhs >= rhs;
+        }
+    }
+};
+
+// Создаёт узел StaticComparison для сравнения op
+std::unique_ptr<Comparison> MakeComparison(ComparisonOp op, std::unique_ptr<Statement> lhs,
+                                           std::unique_ptr<Statement> rhs);
+
 } // namespace ast
\ No newline at end of file
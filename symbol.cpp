@@ -0,0 +1,76 @@
+#include "symbol.h"
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace runtime
+{
+
+namespace
+{
+
+// Таблица имён. Строки хранятся в deque, поэтому указатели на них не меняются при добавлении
+class SymbolTable
+{
+public:
+    static SymbolTable &Instance()
+    {
+        static SymbolTable table;
+        return table;
+    }
+
+    const std::string *Intern(std::string_view name)
+    {
+        {
+            std::shared_lock lock(mutex_);
+            if (auto iter = index_.find(name); iter != index_.end())
+            {
+                return iter->second;
+            }
+        }
+        std::unique_lock lock(mutex_);
+        if (auto iter = index_.find(name); iter != index_.end())
+        {
+            return iter->second;
+        }
+        const std::string &stored = names_.emplace_back(name);
+        index_.emplace(stored, &stored);
+        return &stored;
+    }
+
+    size_t Size() const
+    {
+        std::shared_lock lock(mutex_);
+        return names_.size();
+    }
+
+private:
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, const std::string *> index_;
+    mutable std::shared_mutex mutex_;
+};
+
+} // namespace
+
+Symbol::Symbol()
+{
+    static const std::string *const empty = SymbolTable::Instance().Intern({});
+    name_ = empty;
+}
+
+Symbol::Symbol(std::string_view name) : name_(SymbolTable::Instance().Intern(name)) {}
+
+std::ostream &operator<<(std::ostream &os, const Symbol &symbol)
+{
+    return os << symbol.GetName();
+}
+
+size_t InternedSymbolCount()
+{
+    return SymbolTable::Instance().Size();
+}
+
+} // namespace runtime
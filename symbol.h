@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace runtime
+{
+
+/*
+ * Имя (переменной, поля, метода), хранящееся в глобальной таблице имён в единственном экземпляре.
+ * Символ - указатель на строку таблицы, поэтому символы сравниваются и хешируются за O(1),
+ * а строка имени не копируется. Символ неявно создаётся из строки, что позволяет передавать
+ * строки туда, где ожидается символ. Таблица только дополняется, символы действительны
+ * до завершения программы
+ */
+class Symbol
+{
+public:
+    // Символ пустого имени
+    Symbol();
+
+    Symbol(std::string_view name);
+    Symbol(const std::string &name) : Symbol(std::string_view(name)) {}
+    Symbol(const char *name) : Symbol(std::string_view(name)) {}
+
+    [[nodiscard]] const std::string &GetName() const
+    {
+        return *name_;
+    }
+
+    bool operator==(const Symbol &other) const
+    {
+        return name_ == other.name_;
+    }
+
+    bool operator!=(const Symbol &other) const
+    {
+        return name_ != other.name_;
+    }
+
+private:
+    friend struct std::hash<Symbol>;
+
+    const std::string *name_;
+};
+
+std::ostream &operator<<(std::ostream &os, const Symbol &symbol);
+
+// Количество имён в глобальной таблице (для тестов и диагностики)
+[[nodiscard]] size_t InternedSymbolCount();
+
+} // namespace runtime
+
+template <>
+struct std::hash<runtime::Symbol>
+{
+    size_t operator()(const runtime::Symbol &symbol) const noexcept
+    {
+        return std::hash<const std::string *>{}(symbol.name_);
+    }
+};
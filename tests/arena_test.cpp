@@ -0,0 +1,134 @@
+#include "../arena.h"
+#include "../lexer.h"
+#include "../parse.h"
+#include "../statement.h"
+
+#include "test_runner.h"
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+void TestNodesShareArena() {
+    const size_t arenas_before = Arena::LiveCount();
+    auto root = make_unique<Compound>();
+    {
+        ArenaScope scope;
+        ASSERT_EQUAL(Arena::Active(), &scope.GetArena());
+        for (int i = 0; i < 1000; ++i) {
+            root->AddStatement(make_unique<Add>(make_unique<NumericConst>(i), make_unique<NumericConst>(1)));
+        }
+        ASSERT(scope.GetArena().GetAllocatedBytes() >= 3000 * sizeof(NumericConst));
+        ASSERT(scope.GetArena().GetBlockCount() < 1000U);
+        ASSERT_EQUAL(Arena::LiveCount(), arenas_before + 1);
+    }
+    ASSERT(Arena::Active() == nullptr);
+
+    // Арена живёт, пока живы её узлы
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before + 1);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    const auto& statements = root->GetStatements();
+    ASSERT_EQUAL(statements.size(), 1000U);
+    ASSERT_EQUAL(statements[999]->Execute(closure, context).TryAs<runtime::Number>()->GetValue(), 1000);
+
+    root.reset();
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before);
+}
+
+void TestNestedScopes() {
+    const size_t arenas_before = Arena::LiveCount();
+    unique_ptr<Statement> outer_node;
+    unique_ptr<Statement> inner_node;
+    {
+        ArenaScope outer;
+        {
+            ArenaScope inner;
+            inner_node = make_unique<None>();
+            ASSERT_EQUAL(Arena::Active(), &inner.GetArena());
+        }
+        ASSERT_EQUAL(Arena::Active(), &outer.GetArena());
+        outer_node = make_unique<None>();
+    }
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before + 2);
+    inner_node.reset();
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before + 1);
+    outer_node.reset();
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before);
+
+    // Вне области узлы размещаются в куче
+    auto heap_node = make_unique<None>();
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before);
+}
+
+// Узлы, удалённые до завершения области, не освобождают арену раньше оставшихся узлов
+void TestNodesFreedInsideScope() {
+    const size_t arenas_before = Arena::LiveCount();
+    unique_ptr<Statement> survivor;
+    {
+        ArenaScope scope;
+        for (int i = 0; i < 10; ++i) {
+            auto temporary = make_unique<NumericConst>(i);
+        }
+        survivor = make_unique<NumericConst>(7);
+        make_unique<None>().reset();
+    }
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before + 1);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ASSERT_EQUAL(survivor->Execute(closure, context).TryAs<runtime::Number>()->GetValue(), 7);
+    survivor.reset();
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before);
+
+    // Область, все узлы которой удалены, освобождает арену при завершении
+    {
+        ArenaScope scope;
+        make_unique<None>().reset();
+        ASSERT_EQUAL(Arena::LiveCount(), arenas_before + 1);
+    }
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before);
+}
+
+void TestParsedProgramReleasesArena() {
+    const size_t arenas_before = Arena::LiveCount();
+    runtime::DummyContext context;
+    {
+        istringstream input(R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __str__():
+    return '(' + str(self.x) + ', ' + str(self.y) + ')'
+
+print Point(1, 2)
+)"s);
+        parse::Lexer lexer(input);
+        auto program = ParseProgram(lexer);
+        ASSERT_EQUAL(Arena::LiveCount(), arenas_before + 1);
+
+        runtime::Closure closure;
+        program->Execute(closure, context);
+    }
+    ASSERT_EQUAL(context.output.str(), "(1, 2)\n"s);
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before);
+
+    istringstream bad_input("x = (1 + \n"s);
+    parse::Lexer lexer(bad_input);
+    ASSERT_THROWS(ParseProgram(lexer), std::runtime_error);
+    ASSERT_EQUAL(Arena::LiveCount(), arenas_before);
+}
+
+}  // namespace
+
+void RunArenaTests(TestRunner& tr) {
+    RUN_TEST(tr, ast::TestNodesShareArena);
+    RUN_TEST(tr, ast::TestNestedScopes);
+    RUN_TEST(tr, ast::TestNodesFreedInsideScope);
+    RUN_TEST(tr, ast::TestParsedProgramReleasesArena);
+}
+
+}  // namespace ast
@@ -0,0 +1,132 @@
+#include "../batch.h"
+#include "../lexer.h"
+#include "../parse.h"
+#include "../statement.h"
+#include "../thread_pool.h"
+
+#include "test_runner.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+
+using namespace std;
+
+namespace batch {
+
+namespace {
+
+void RunProgram(string_view source, ostream& output) {
+    parse::Lexer lexer(source);
+    auto program = ParseProgram(lexer);
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    program->Execute(closure, context);
+}
+
+string ReadFile(const string& path) {
+    ifstream input(path);
+    return {istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+}
+
+void TestThreadPool() {
+    atomic<int> sum = 0;
+    {
+        ThreadPool pool(4);
+        ASSERT_EQUAL(pool.GetThreadCount(), 4U);
+        for (int i = 1; i <= 1000; ++i) {
+            // Задачи, добавленные из потока пула, тоже выполняются до завершения Wait
+            pool.Submit([&pool, &sum, i] {
+                sum += i;
+                pool.Submit([&sum] { sum += 1; });
+            });
+        }
+        pool.Wait();
+        ASSERT_EQUAL(sum.load(), 500500 + 1000);
+
+        pool.Submit([&sum] { sum = 0; });
+        pool.Wait();
+        ASSERT_EQUAL(sum.load(), 0);
+    }
+    ThreadPool default_pool(0);
+    ASSERT(default_pool.GetThreadCount() > 0U);
+}
+
+void TestReadManifest() {
+    istringstream manifest(R"(# comment
+a.my a.out
+
+  b.my    b.out
+)"s);
+    const vector<Job> jobs = ReadManifest(manifest);
+    ASSERT_EQUAL(jobs.size(), 2U);
+    ASSERT_EQUAL(jobs[0].input_path, "a.my"s);
+    ASSERT_EQUAL(jobs[0].output_path, "a.out"s);
+    ASSERT_EQUAL(jobs[1].input_path, "b.my"s);
+    ASSERT_EQUAL(jobs[1].output_path, "b.out"s);
+
+    istringstream missing_output("a.my\n"s);
+    ASSERT_THROWS(ReadManifest(missing_output), runtime_error);
+    istringstream extra_field("a.my a.out c\n"s);
+    ASSERT_THROWS(ReadManifest(extra_field), runtime_error);
+}
+
+void TestRunJobs() {
+    // Одна и та же программа во многих потоках: каждое задание создаёт свои классы и экземпляры
+    const string program = R"(
+class Counter:
+  def __init__(start):
+    self.value = start
+
+  def add(n):
+    self.value = self.value + n
+    return self
+
+  def __str__():
+    return 'Counter(' + str(self.value) + ')'
+
+c = Counter(0)
+d = Counter(100)
+c.add(1)
+c.add(2)
+print c.add(3), d.add(1)
+)"s;
+    vector<Job> jobs;
+    for (int i = 0; i < 16; ++i) {
+        const string input = "mython_batch_test_"s + to_string(i) + ".my"s;
+        ofstream(input) << (i == 5 ? "print undefined\n"s : program);
+        jobs.push_back({input, input + ".out"s});
+    }
+    jobs.push_back({"mython_batch_test_missing.my"s, "mython_batch_test_missing.out"s});
+
+    const vector<JobResult> results = RunJobs(jobs, 4, RunProgram);
+    ASSERT_EQUAL(results.size(), jobs.size());
+    for (size_t i = 0; i < 16; ++i) {
+        ASSERT_EQUAL(results[i].success, i != 5);
+        if (i != 5) {
+            ASSERT_EQUAL(ReadFile(jobs[i].output_path), "Counter(6) Counter(101)\n"s);
+        }
+    }
+    ASSERT(!results[5].error.empty());
+    ASSERT(!results.back().success);
+
+    ostringstream report;
+    ASSERT_EQUAL(PrintReport(report, jobs, results), 2U);
+    ASSERT(report.str().find("FAILED mython_batch_test_5.my"s) != string::npos);
+    ASSERT(report.str().find("15 of 17 jobs succeeded"s) != string::npos);
+
+    for (const Job& job : jobs) {
+        remove(job.input_path.c_str());
+        remove(job.output_path.c_str());
+    }
+}
+
+}  // namespace
+
+void RunBatchTests(TestRunner& tr) {
+    RUN_TEST(tr, batch::TestThreadPool);
+    RUN_TEST(tr, batch::TestReadManifest);
+    RUN_TEST(tr, batch::TestRunJobs);
+}
+
+}  // namespace batch
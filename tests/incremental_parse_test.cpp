@@ -0,0 +1,218 @@
+#include "../arena.h"
+#include "../incremental_parse.h"
+#include "../lexer.h"
+#include "../parse.h"
+#include "../statement.h"
+
+#include "test_runner.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace parse {
+
+namespace {
+
+const string PROGRAM = R"(class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __str__():
+    return str(self.x) + ':' + str(self.y)
+
+class Shifter:
+  def shift(p, dx):
+    return Point(p.x + dx, p.y)
+
+p = Point(1, 2)
+# Комментарий без отступа относится к предыдущей части
+s = Shifter()
+if p.x > 0:
+  print 'positive'
+else:
+  print 'negative'
+print s.shift(p, 10)
+)"s;
+
+string Execute(ast::Statement& program) {
+    runtime::DummyContext context;
+    runtime::Closure globals;
+    program.Execute(globals, context);
+    return context.output.str();
+}
+
+// Номера строк всех узлов дерева в порядке обхода
+void CollectLines(ast::Statement& node, vector<uint32_t>& lines) {
+    lines.push_back(node.GetLine());
+    node.ForEachChild([&lines](unique_ptr<ast::Statement>& child) {
+        CollectLines(*child, lines);
+    });
+}
+
+vector<uint32_t> Lines(ast::Statement& program) {
+    vector<uint32_t> lines;
+    CollectLines(program, lines);
+    return lines;
+}
+
+vector<uint32_t> FullParseLines(const string& source) {
+    Lexer lexer(source);
+    return Lines(*ParseProgram(lexer));
+}
+
+// Классы, объявленные программой, в порядке объявления
+vector<const runtime::Object*> Classes(ast::Statement& program) {
+    vector<const runtime::Object*> result;
+    program.ForEachChild([&result](unique_ptr<ast::Statement>& statement) {
+        if (auto class_def = dynamic_cast<ast::ClassDefinition*>(statement.get())) {
+            result.push_back(class_def->GetClass().Get());
+        }
+    });
+    return result;
+}
+
+string Replace(string source, const string& from, const string& to) {
+    source.replace(source.find(from), from.size(), to);
+    return source;
+}
+
+void TestReusesUnchangedStatements() {
+    IncrementalParser parser;
+    auto stats = parser.Update(PROGRAM);
+    ASSERT_EQUAL(stats.chunks, 6U);
+    ASSERT_EQUAL(stats.parsed, 6U);
+    ASSERT_EQUAL(Execute(parser.GetProgram()), "positive\n11:2\n"s);
+    const auto classes = Classes(parser.GetProgram());
+
+    // Правка внутри инструкции if разбирает заново только её
+    string edited = Replace(PROGRAM, "print 'negative'"s, "print 'not positive'"s);
+    stats = parser.Update(edited);
+    ASSERT_EQUAL(stats.parsed, 1U);
+    ASSERT_EQUAL(stats.reused, 5U);
+    ASSERT(Classes(parser.GetProgram()) == classes);
+    ASSERT_EQUAL(Execute(parser.GetProgram()), "positive\n11:2\n"s);
+
+    // Вставленные строки сдвигают номера строк сохранённых частей
+    edited = "x = 1\n\ny = x + 1\n"s + edited;
+    stats = parser.Update(edited);
+    ASSERT_EQUAL(stats.parsed, 2U);
+    ASSERT_EQUAL(stats.reused, 6U);
+    ASSERT(Lines(parser.GetProgram()) == FullParseLines(edited));
+
+    // Повторное применение той же версии ничего не разбирает
+    stats = parser.Update(edited);
+    ASSERT_EQUAL(stats.parsed, 0U);
+    ASSERT(Lines(parser.GetProgram()) == FullParseLines(edited));
+
+    // Переставленные части сопоставляются по тексту
+    const string p_statement = "p = Point(1, 2)\n# Комментарий без отступа относится к предыдущей части\n"s;
+    edited = Replace(Replace(edited, p_statement, ""s), "s = Shifter()\n"s, "s = Shifter()\n"s + p_statement);
+    stats = parser.Update(edited);
+    ASSERT_EQUAL(stats.parsed, 0U);
+    ASSERT_EQUAL(Execute(parser.GetProgram()), "positive\n11:2\n"s);
+    ASSERT(Lines(parser.GetProgram()) == FullParseLines(edited));
+}
+
+void TestReparsesDependentStatements() {
+    IncrementalParser parser;
+    parser.Update(PROGRAM);
+    const auto classes = Classes(parser.GetProgram());
+
+    // Изменённый класс Point создаётся заново, как и класс Shifter, ссылающийся на него,
+    // и части, создающие экземпляры этих классов
+    const string edited = Replace(PROGRAM, "return str(self.x) + ':' + str(self.y)"s, "return str(self.x)"s);
+    const auto stats = parser.Update(edited);
+    ASSERT_EQUAL(stats.parsed, 4U);
+    ASSERT_EQUAL(stats.reused, 2U);
+    const auto new_classes = Classes(parser.GetProgram());
+    ASSERT(new_classes[0] != classes[0]);
+    ASSERT(new_classes[1] != classes[1]);
+    ASSERT_EQUAL(Execute(parser.GetProgram()), "positive\n11\n"s);
+    ASSERT(Lines(parser.GetProgram()) == FullParseLines(edited));
+}
+
+void TestErrors() {
+    IncrementalParser parser;
+    parser.Update(PROGRAM);
+
+    ASSERT_THROWS(parser.Update(Replace(PROGRAM, "s = Shifter()"s, "s = Shifte()"s)), ParseError);
+    ASSERT_EQUAL(Execute(parser.GetProgram()), ""s);
+
+    // После исправления ошибки сохранённые части используются снова
+    auto stats = parser.Update(PROGRAM);
+    ASSERT_EQUAL(stats.parsed, 1U);
+    ASSERT_EQUAL(Execute(parser.GetProgram()), "positive\n11:2\n"s);
+
+    // Повторное объявление класса обнаруживается и в сохранённой части
+    ASSERT_THROWS(parser.Update("class Shifter:\n  def f():\n    return 1\n"s + PROGRAM), ParseError);
+    stats = parser.Update(PROGRAM);
+    ASSERT_EQUAL(stats.parsed, 0U);
+
+    // Классы, объявленные до начала программы
+    runtime::Closure declared;
+    declared["Point"s] = runtime::ObjectHolder::Own(runtime::Class("Point"s, {}, nullptr));
+    IncrementalParser with_classes(declared);
+    ASSERT_THROWS(with_classes.Update(PROGRAM), ParseError);
+    with_classes.Update("p = Point()\nprint p.x\n"s);
+}
+
+// Части, разобранные одним вызовом Update, размещаются в общей арене
+void TestChunksShareArena() {
+    string source;
+    for (int i = 0; i < 2000; ++i) {
+        source += "x"s + to_string(i) + " = "s + to_string(i) + "\n"s;
+    }
+    const size_t arenas_before = ast::Arena::LiveCount();
+    {
+        IncrementalParser parser;
+        ASSERT_EQUAL(parser.Update(source).parsed, 2000U);
+        ASSERT_EQUAL(ast::Arena::LiveCount(), arenas_before + 1);
+
+        // Правка добавляет одну арену, а арена заменённой части освобождается вместе с её последним узлом
+        parser.Update(Replace(source, "x5 = 5\n"s, "x5 = 50\n"s));
+        ASSERT_EQUAL(ast::Arena::LiveCount(), arenas_before + 2);
+    }
+    ASSERT_EQUAL(ast::Arena::LiveCount(), arenas_before);
+}
+
+// Кеши вызовов методов и обращений к полям сохранённой части не ссылаются на классы,
+// освобождённые при повторном разборе изменённой части
+void TestReusedCachesSurviveReparsedClasses() {
+    const string source = R"(class Foo:
+  def __init__():
+    self.v = 1
+
+  def m():
+    return k
+
+class User:
+  def use(o):
+    return o.m() + o.v
+
+u = User()
+f = Foo()
+print u.use(f)
+)"s;
+    IncrementalParser parser;
+    for (int k = 1; k <= 5; ++k) {
+        const auto stats = parser.Update(Replace(source, "return k"s, "return "s + to_string(k * 10)));
+        if (k > 1) {
+            ASSERT_EQUAL(stats.parsed, 2U);
+        }
+        ASSERT_EQUAL(Execute(parser.GetProgram()), to_string(k * 10 + 1) + "\n"s);
+    }
+}
+
+}  // namespace
+
+void RunIncrementalParseTests(TestRunner& tr) {
+    RUN_TEST(tr, parse::TestReusesUnchangedStatements);
+    RUN_TEST(tr, parse::TestReparsesDependentStatements);
+    RUN_TEST(tr, parse::TestErrors);
+    RUN_TEST(tr, parse::TestChunksShareArena);
+    RUN_TEST(tr, parse::TestReusedCachesSurviveReparsedClasses);
+}
+
+}  // namespace parse
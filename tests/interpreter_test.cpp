@@ -0,0 +1,437 @@
+#include "../interpreter.h"
+#include "../lexer.h"
+#include "../parse.h"
+#include "../serializer.h"
+#include "../thread_pool.h"
+
+#include "test_runner.h"
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace interpreter {
+
+namespace {
+
+const string COUNTER_PROGRAM = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def inc():
+    self.value = self.value + 1
+    return self.value
+
+c = Counter()
+c.inc()
+print c.inc(), n * 2
+)"s;
+
+string RunWith(const CompiledProgram& program, int n) {
+    runtime::DummyContext context;
+    runtime::Closure globals;
+    globals["n"s] = runtime::ObjectHolder::Own(runtime::Number(n));
+    Run(program, context, globals);
+    return context.output.str();
+}
+
+void TestRunTwice() {
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        const auto program = Compile(COUNTER_PROGRAM, Options{engine, ast::OptimizationLevel::O1});
+        ASSERT(program.GetOptions().engine == engine);
+
+        // Каждый запуск создаёт собственные экземпляры классов
+        ASSERT_EQUAL(RunWith(program, 1), "2 2\n"s);
+        ASSERT_EQUAL(RunWith(program, 5), "2 10\n"s);
+    }
+}
+
+void TestGlobalsReceiveResults() {
+    istringstream input("x = 2 + 3\ny = x * k\n"s);
+    const auto program = Compile(input);
+    ASSERT_EQUAL(program.GetOptimizationStats().folded_expressions, 1U);
+
+    runtime::DummyContext context;
+    runtime::Closure globals;
+    globals["k"s] = runtime::ObjectHolder::Own(runtime::Number(4));
+    Run(program, context, globals);
+    ASSERT_EQUAL(globals.at("x"s).TryAs<runtime::Number>()->GetValue(), 5);
+    ASSERT_EQUAL(globals.at("y"s).TryAs<runtime::Number>()->GetValue(), 20);
+}
+
+// Присваивания, выполненные до ошибки времени выполнения, остаются в globals на обоих исполнителях
+void TestGlobalsSurviveRuntimeErrors() {
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        const auto program = Compile("x = k + 1\ny = x * 2\nz = y / 0\nw = 1\n"s, Options{engine});
+
+        runtime::DummyContext context;
+        runtime::Closure globals;
+        globals["k"s] = runtime::ObjectHolder::Own(runtime::Number(4));
+        ASSERT_THROWS(Run(program, context, globals), runtime_error);
+        ASSERT_EQUAL(globals.size(), 3U);
+        ASSERT_EQUAL(globals.at("x"s).TryAs<runtime::Number>()->GetValue(), 5);
+        ASSERT_EQUAL(globals.at("y"s).TryAs<runtime::Number>()->GetValue(), 10);
+    }
+}
+
+void TestConcurrentRuns() {
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        const auto program = Compile(COUNTER_PROGRAM, Options{engine, ast::OptimizationLevel::O1});
+        constexpr int RUN_COUNT = 64;
+        vector<string> outputs(RUN_COUNT);
+        {
+            ThreadPool pool(4);
+            for (int i = 0; i < RUN_COUNT; ++i) {
+                pool.Submit([&program, &outputs, i] {
+                    outputs[i] = RunWith(program, i);
+                });
+            }
+            pool.Wait();
+        }
+        for (int i = 0; i < RUN_COUNT; ++i) {
+            ASSERT_EQUAL(outputs[i], "2 "s + to_string(i * 2) + "\n"s);
+        }
+    }
+}
+
+void TestSaveAndLoad() {
+    ostringstream image;
+    Save(Compile(COUNTER_PROGRAM, Options{Engine::Tree, ast::OptimizationLevel::O0}), image);
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        const auto program = Load(image.str(), Options{engine, ast::OptimizationLevel::O1});
+        ASSERT_EQUAL(RunWith(program, 3), "2 6\n"s);
+    }
+    ASSERT_THROWS(Load(COUNTER_PROGRAM), ast::SerializationError);
+}
+
+void TestCompileErrors() {
+    ASSERT_THROWS(Compile("x = foo()\n"sv), ParseError);
+    ASSERT_THROWS(Compile("print 1 $ 2\n"sv), parse::LexerError);
+
+    const auto program = Compile("print undefined_name\n"sv);
+    runtime::DummyContext context;
+    ASSERT_THROWS(Run(program, context), std::runtime_error);
+}
+
+// Хвостовые вызовы, в том числе между методами разных объектов, не увеличивают глубину рекурсии
+const string TAIL_CALLS_PROGRAM = R"(
+class Node:
+  def __init__(value, next):
+    self.value = value
+    self.next = next
+
+class Walker:
+  def visit(node, acc):
+    if node.value == 0:
+      return acc + 1
+    return self.visit(node.next, acc + 1)
+
+class Even:
+  def check(n, other):
+    if n == 0:
+      return True
+    return other.check(n - 1, self)
+
+class Odd:
+  def check(n, other):
+    if n == 0:
+      return False
+    return other.check(n - 1, self)
+
+class Builder:
+  def build(n, tail):
+    if n == 0:
+      return tail
+    return self.build(n - 1, Node(n, tail))
+
+even = Even()
+odd = Odd()
+builder = Builder()
+walker = Walker()
+list = builder.build(5000, Node(0, None))
+print walker.visit(list, 0), even.check(100001, odd), odd.check(100001, even)
+)"s;
+
+void TestTailCalls() {
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        for (ast::OptimizationLevel level : {ast::OptimizationLevel::O0, ast::OptimizationLevel::O1}) {
+            const auto program = Compile(TAIL_CALLS_PROGRAM, Options{engine, level});
+            runtime::DummyContext context;
+            Run(program, context);
+            ASSERT_EQUAL(context.output.str(), "5001 False True\n"s);
+            ASSERT_EQUAL(context.GetCallDepth(), 0U);
+        }
+    }
+}
+
+// Обращение к отсутствующему полю - ошибка времени выполнения, как и прочие ошибки программы
+void TestMissingField() {
+    const string program_text = R"(
+class A:
+  def get():
+    return self.missing
+
+a = A()
+print 'before'
+print a.get()
+)"s;
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        const auto program = Compile(program_text, Options{engine});
+        runtime::DummyContext context;
+        ASSERT_THROWS(Run(program, context), runtime_error);
+        ASSERT_EQUAL(context.output.str(), "before\n"s);
+    }
+}
+
+void TestRecursionLimit() {
+    const string program_text = R"(
+class Counter:
+  def count(n):
+    if n == 0:
+      return 0
+    return 1 + self.count(n - 1)
+
+c = Counter()
+print c.count(n)
+)"s;
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        Options options;
+        options.engine = engine;
+        options.recursion_limit = 100;
+        const auto program = Compile(program_text, options);
+        ASSERT_EQUAL(RunWith(program, 99), "99\n"s);
+
+        // Превышение ограничения - ошибка времени выполнения, после которой контекст пригоден для исполнения
+        runtime::DummyContext context;
+        runtime::Closure globals;
+        globals["n"s] = runtime::ObjectHolder::Own(runtime::Number(100));
+        ASSERT_THROWS(Run(program, context, globals), runtime::RecursionLimitError);
+        ASSERT_EQUAL(context.GetCallDepth(), 0U);
+        ASSERT(context.GetTailCall() == nullptr);
+        globals["n"s] = runtime::ObjectHolder::Own(runtime::Number(10));
+        Run(program, context, globals);
+        ASSERT_EQUAL(context.output.str(), "10\n"s);
+
+        // По умолчанию глубина не ограничена: рекурсия, с которой справляется стек, исполняется
+        ASSERT_EQUAL(RunWith(Compile(program_text, Options{engine}), 5000), "5000\n"s);
+    }
+
+    // Хвостовые вызовы на регистровой машине глубину не увеличивают
+    const auto tail = Compile(R"(
+class Counter:
+  def count(n, total):
+    if n == 0:
+      return total
+    return self.count(n - 1, total + 1)
+
+c = Counter()
+print c.count(n, 0)
+)"s,
+                              Options{Engine::Vm});
+    ASSERT_EQUAL(RunWith(tail, 100000), "100000\n"s);
+}
+
+// Классы с методами C++ используются программой наравне с её собственными классами
+void TestNativeClasses() {
+    using runtime::ClassInstance;
+    using runtime::Context;
+    using runtime::Number;
+    using runtime::ObjectHolder;
+
+    const auto number = [](const ObjectHolder& value) {
+        const auto* result = value.TryAs<Number>();
+        if (result == nullptr) {
+            throw runtime_error("Number expected"s);
+        }
+        return result->GetValue();
+    };
+    const ObjectHolder accumulator =
+        NativeClassBuilder("Accumulator"s)
+            .AddMethod("__init__"s, {"start"s},
+                       [](ClassInstance& self, const vector<ObjectHolder>& args, Context&) {
+                           self.Fields()["total"s] = args[0];
+                           return ObjectHolder::None();
+                       })
+            .AddMethod("add"s, {"x"s},
+                       [number](ClassInstance& self, const vector<ObjectHolder>& args, Context&) {
+                           ObjectHolder& total = self.Fields()["total"s];
+                           total = ObjectHolder::Own(Number(number(total) + number(args[0])));
+                           return total;
+                       })
+            .AddMethod("__str__"s, {},
+                       [number](ClassInstance& self, const vector<ObjectHolder>&, Context&) {
+                           return ObjectHolder::Own(
+                               runtime::String("Acc("s + to_string(number(self.Fields()["total"s])) + ")"s));
+                       })
+            .Build();
+    // Метод C++ может вызывать методы объектов программы
+    const ObjectHolder host = NativeClassBuilder("Host"s)
+                                  .AddMethod("apply"s, {"object"s, "x"s},
+                                             [](ClassInstance&, const vector<ObjectHolder>& args, Context& context) {
+                                                 return args[0].TryAs<ClassInstance>()->Call("run"s, {args[1]},
+                                                                                             context);
+                                             })
+                                  .Build();
+
+    const string program_text = R"(
+class Scaled(Accumulator):
+  def __init__(start, factor):
+    self.total = start
+    self.factor = factor
+
+  def add_scaled(x):
+    return self.add(x * self.factor)
+
+class Doubler:
+  def run(x):
+    return x * 2
+
+acc = Accumulator(1)
+acc.add(2)
+s = Scaled(10, 3)
+s.add_scaled(4)
+print acc, s, host.apply(Doubler(), 21)
+)"s;
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        for (ast::OptimizationLevel level : {ast::OptimizationLevel::O0, ast::OptimizationLevel::O1}) {
+            Options options{engine, level};
+            options.classes = {accumulator, host};
+            const auto program = Compile(program_text, options);
+            runtime::DummyContext context;
+            runtime::Closure globals;
+            globals["host"s] = ObjectHolder::Own(ClassInstance(*host.TryAs<runtime::Class>()));
+            Run(program, context, globals);
+            ASSERT_EQUAL(context.output.str(), "Acc(3) Acc(22) 42\n"s);
+
+            ostringstream image;
+            ASSERT_THROWS(Save(program, image), ast::SerializationError);
+        }
+    }
+
+    // Без объявления класса программа его не видит
+    ASSERT_THROWS(Compile("a = Accumulator(1)\n"sv), ParseError);
+    Options options;
+    options.classes = {accumulator};
+    ASSERT_THROWS(Compile("class Accumulator:\n  def f():\n    return 1\n"sv, options), ParseError);
+}
+
+// Циклы ссылок освобождаются при исполнении, а достижимые из переменных и кадров вызовов сохраняются
+void TestCycleCollection() {
+    const string program_text = R"(
+class Node:
+  def __init__(value):
+    self.value = value
+    self.next = self
+
+class Pair:
+  def __init__(value):
+    self.first = Node(value)
+    self.second = Node(value + 1)
+    self.first.next = self.second
+    self.second.next = self.first
+    self.owner = self
+
+class Maker:
+  def make(n, keep):
+    if n == 0:
+      return keep
+    p = Pair(n)
+    return self.make(n - 1, keep)
+
+keep = Pair(0)
+m = Maker()
+result = m.make(3000, keep)
+print result.first.next.next.value, keep.first.next.value
+)"s;
+    runtime::SetCollectionThreshold(10);
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        for (ast::OptimizationLevel level : {ast::OptimizationLevel::O0, ast::OptimizationLevel::O1}) {
+            const size_t instances = runtime::GetHeapStats().instances;
+            const auto program = Compile(program_text, Options{engine, level});
+            runtime::DummyContext context;
+            Run(program, context);
+            ASSERT_EQUAL(context.output.str(), "0 1\n"s);
+            ASSERT(runtime::GetHeapStats().instances <= instances + 100);
+            runtime::CollectCycles();
+            ASSERT_EQUAL(runtime::GetHeapStats().instances, instances);
+        }
+    }
+    runtime::SetCollectionThreshold(runtime::DEFAULT_COLLECTION_THRESHOLD);
+}
+
+// Бесконечная программа прерывается бюджетом шагов, сроком либо отменой
+void TestExecutionLimits() {
+    const auto limit_of = [](const CompiledProgram& program, runtime::DummyContext& context) {
+        try {
+            Run(program, context);
+        } catch (const runtime::ExecutionLimitError& e) {
+            return optional<runtime::ExecutionLimit>(e.GetLimit());
+        }
+        return optional<runtime::ExecutionLimit>();
+    };
+    const string endless = R"(
+class Loop:
+  def run(n):
+    print n
+    return self.run(n + 1)
+
+loop = Loop()
+loop.run(0)
+)"s;
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        Options options{engine, ast::OptimizationLevel::O1};
+        options.step_limit = 10000;
+        runtime::DummyContext context;
+        ASSERT(limit_of(Compile(endless, options), context) == runtime::ExecutionLimit::Steps);
+        ASSERT_EQUAL(context.GetStepCount(), 10001U);
+        ASSERT_EQUAL(context.GetCallDepth(), 0U);
+
+        // Ограничения устанавливаются заново при каждом запуске
+        const auto finite = Compile("x = 1\nprint x\n"sv, options);
+        Run(finite, context);
+        ASSERT(context.GetStepCount() <= 2U);
+
+        options.step_limit = 0;
+        options.time_limit = 50ms;
+        const auto start = chrono::steady_clock::now();
+        ASSERT(limit_of(Compile(endless, options), context) == runtime::ExecutionLimit::Deadline);
+        ASSERT(chrono::steady_clock::now() - start >= 50ms);
+
+        // Отмена из другого потока
+        options.time_limit = 0ms;
+        atomic<bool> cancelled = false;
+        context.SetCancellationFlag(&cancelled);
+        thread canceller([&cancelled] {
+            this_thread::sleep_for(20ms);
+            cancelled = true;
+        });
+        ASSERT(limit_of(Compile(endless, options), context) == runtime::ExecutionLimit::Cancelled);
+        canceller.join();
+        context.SetCancellationFlag(nullptr);
+        Run(finite, context);
+    }
+}
+
+}  // namespace
+
+void RunInterpreterTests(TestRunner& tr) {
+    RUN_TEST(tr, interpreter::TestRunTwice);
+    RUN_TEST(tr, interpreter::TestGlobalsReceiveResults);
+    RUN_TEST(tr, interpreter::TestGlobalsSurviveRuntimeErrors);
+    RUN_TEST(tr, interpreter::TestConcurrentRuns);
+    RUN_TEST(tr, interpreter::TestSaveAndLoad);
+    RUN_TEST(tr, interpreter::TestCompileErrors);
+    RUN_TEST(tr, interpreter::TestTailCalls);
+    RUN_TEST(tr, interpreter::TestMissingField);
+    RUN_TEST(tr, interpreter::TestRecursionLimit);
+    RUN_TEST(tr, interpreter::TestCycleCollection);
+    RUN_TEST(tr, interpreter::TestNativeClasses);
+    RUN_TEST(tr, interpreter::TestExecutionLimits);
+}
+
+}  // namespace interpreter
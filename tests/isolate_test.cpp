@@ -0,0 +1,179 @@
+#include "../isolate.h"
+
+#include "test_runner.h"
+
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace interpreter {
+
+namespace {
+
+void TestChannel() {
+    Channel channel(3);
+    ASSERT_EQUAL(channel.GetCapacity(), 4U);
+
+    Message message = 1;
+    ASSERT(channel.TrySend(message));
+    channel.Send("two"s);
+    channel.Send(true);
+    message = 4;
+    ASSERT(channel.TrySend(message));
+    message = 5;
+    ASSERT(!channel.TrySend(message));
+
+    ASSERT(channel.Receive() == Message{1});
+    ASSERT(channel.Receive() == Message{"two"s});
+    channel.Close();
+    ASSERT_THROWS(channel.Send(6), runtime_error);
+
+    // Отправленные до закрытия сообщения дочитываются
+    ASSERT(channel.WaitForMessage());
+    ASSERT(channel.Receive() == Message{true});
+    ASSERT(channel.TryReceive(message));
+    ASSERT(message == Message{4});
+    ASSERT(!channel.WaitForMessage());
+    ASSERT(!channel.Receive().has_value());
+}
+
+void TestChannelBetweenThreads() {
+    constexpr int COUNT = 100000;
+    Channel channel(16);
+    thread producer([&channel] {
+        for (int i = 1; i <= COUNT; ++i) {
+            channel.Send(i);
+        }
+        channel.Close();
+    });
+
+    int64_t sum = 0;
+    int expected = 1;
+    bool ordered = true;
+    while (optional<Message> message = channel.Receive()) {
+        const int value = get<int>(*message);
+        ordered = ordered && value == expected++;
+        sum += value;
+    }
+    producer.join();
+    ASSERT(ordered);
+    ASSERT_EQUAL(sum, int64_t{COUNT} * (COUNT + 1) / 2);
+}
+
+const string SQUARE_STAGE = R"(
+class Square:
+  def run(in, out):
+    if in.has_next():
+      x = in.receive()
+      out.send(x * x)
+      return self.run(in, out)
+
+s = Square()
+s.run(input, output)
+)"s;
+
+const string SUM_STAGE = R"(
+class Sum:
+  def run(in, total):
+    x = in.receive()
+    if x:
+      return self.run(in, total + x)
+    return total
+
+s = Sum()
+print 'sum', s.run(input, 0)
+)"s;
+
+void TestPipeline() {
+    for (Engine engine : {Engine::Tree, Engine::Vm}) {
+        const Options options{engine};
+        auto numbers = make_shared<Channel>(8);
+        auto squares = make_shared<Channel>(8);
+
+        ostringstream square_output;
+        ostringstream sum_output;
+        Isolate square(Compile(SQUARE_STAGE, options), square_output);
+        square.BindReceiver("input"s, numbers).BindSender("output"s, squares);
+        Isolate sum(Compile(SUM_STAGE, options), sum_output);
+        sum.BindReceiver("input"s, squares);
+        square.Start();
+        sum.Start();
+        ASSERT_THROWS(sum.Start(), logic_error);
+
+        for (int i = 1; i <= 1000; ++i) {
+            numbers->Send(i);
+        }
+        numbers->Close();
+        square.Join();
+        sum.Join();
+        ASSERT(squares->IsClosed());
+        ASSERT_EQUAL(square_output.str(), ""s);
+        ASSERT_EQUAL(sum_output.str(), "sum 333833500\n"s);
+    }
+}
+
+void TestStringsAndErrors() {
+    auto words = make_shared<Channel>();
+    auto replies = make_shared<Channel>();
+    ostringstream output;
+    Isolate echo(Compile(R"(
+class Echo:
+  def run(in, out):
+    word = in.receive()
+    out.send(word + '!')
+    out.send(word == 'hello')
+    out.send(self)
+
+e = Echo()
+e.run(input, output)
+)"s),
+                 output);
+    echo.BindReceiver("input"s, words).BindSender("output"s, replies);
+    echo.Start();
+    words->Send("hello"s);
+
+    ASSERT(replies->Receive() == Message{"hello!"s});
+    ASSERT(replies->Receive() == Message{true});
+    // Экземпляр класса не передаётся в другой изолят: программа завершается ошибкой и закрывает каналы
+    ASSERT_THROWS(echo.Join(), runtime_error);
+    ASSERT(!replies->Receive().has_value());
+    ASSERT_THROWS(words->Send("again"s), runtime_error);
+}
+
+void TestCancel() {
+    auto never = make_shared<Channel>();
+    ostringstream output;
+    Isolate spin(Compile(R"(
+class Spin:
+  def run(n):
+    return self.run(n + 1)
+
+s = Spin()
+s.run(0)
+)"s),
+                 output);
+    spin.BindReceiver("input"s, never);
+    spin.Start();
+    spin.Cancel();
+    ASSERT_THROWS(spin.Join(), runtime::ExecutionLimitError);
+    ASSERT(never->IsClosed());
+
+    // Изолят, не дождавшийся сообщения, отменяется при разрушении
+    auto idle = make_shared<Channel>();
+    Isolate waiting(Compile("x = input.receive()\n"s), output);
+    waiting.BindReceiver("input"s, idle);
+    waiting.Start();
+}
+
+}  // namespace
+
+void RunIsolateTests(TestRunner& tr) {
+    RUN_TEST(tr, interpreter::TestChannel);
+    RUN_TEST(tr, interpreter::TestChannelBetweenThreads);
+    RUN_TEST(tr, interpreter::TestPipeline);
+    RUN_TEST(tr, interpreter::TestStringsAndErrors);
+    RUN_TEST(tr, interpreter::TestCancel);
+}
+
+}  // namespace interpreter
@@ -1,8 +1,16 @@
 #include "../lexer.h"
+#include "../mapped_file.h"
 #include "test_runner.h"
 
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
+
+#if __has_include(<sys/stat.h>)
+#include <sys/stat.h>
+#endif
 
 using namespace std;
 
@@ -351,6 +359,173 @@ abc#
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
     }
 }
+
+void TestTokensAreReadOnDemand() {
+    string text;
+    while (text.size() < 4 * Lexer::CHUNK_SIZE) {
+        text += "x = x + 1\n"s;
+    }
+    const size_t lines = text.size() / 10;
+    istringstream is(text);
+    Lexer lexer(is);
+
+    // Поток читается по мере запроса лексем, а не целиком при создании лексера
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    ASSERT(is.good());
+    ASSERT(is.tellg() <= streampos(Lexer::CHUNK_SIZE));
+
+    size_t newlines = 0;
+    while (!lexer.CurrentToken().Is<token_type::Eof>()) {
+        newlines += lexer.CurrentToken().Is<token_type::Newline>() ? 1 : 0;
+        lexer.NextToken();
+    }
+    ASSERT_EQUAL(newlines, lines);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestErrorsAreReportedOnDemand() {
+    istringstream is("x = 1\ny = 'unterminated\n"s);
+    Lexer lexer(is);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"y"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_THROWS(lexer.NextToken(), ParsingError);
+}
+
+void TestBufferAndStreamGiveSameTokens() {
+    const string text = R"(# comment
+class Counter:
+  def __init__(start):
+    self.value = start   # trailing comment
+
+  def greet(name):
+    if self.value >= 10 and name != 'x\'y':
+      return "hi " + name
+    return 'plain'
+
+c = Counter(42)
+print c.greet('you'), 1 <= 2, not None
+  )"s;
+    istringstream is(text);
+    Lexer stream_lexer(is);
+    Lexer buffer_lexer(string_view{text});
+
+    // Текст лексем потока действителен, пока лексема текущая: лексеры сравниваются шаг за шагом
+    size_t count = 1;
+    ASSERT_EQUAL(buffer_lexer.CurrentToken(), stream_lexer.CurrentToken());
+    while (!stream_lexer.CurrentToken().Is<token_type::Eof>()) {
+        ASSERT_EQUAL(buffer_lexer.NextToken(), stream_lexer.NextToken());
+        ++count;
+    }
+    ASSERT(buffer_lexer.CurrentToken().Is<token_type::Eof>());
+    ASSERT(count > 50U);
+}
+
+// Идентификаторы и строки без escape-последовательностей ссылаются на разбираемый текст
+void TestTokensReferToSource() {
+    const string text = "name = 'plain' + 'esc\\n'\n"s;
+    Lexer lexer(string_view{text});
+
+    const string_view id = lexer.CurrentToken().As<token_type::Id>().value;
+    ASSERT_EQUAL(id, "name"sv);
+    ASSERT(id.data() == text.data());
+    lexer.NextToken();
+    const string_view plain = lexer.NextToken().As<token_type::String>().value;
+    ASSERT_EQUAL(plain, "plain"sv);
+    ASSERT(plain.data() == text.data() + text.find("plain"s));
+    lexer.NextToken();
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"esc\n"s}));
+}
+
+void TestTokensAcrossChunks() {
+    // Лексемы, пересекающие границу порций потока, собираются целиком
+    const string long_id(Lexer::CHUNK_SIZE + 100, 'a');
+    const string long_str(2 * Lexer::CHUNK_SIZE, 's');
+    const string padding(Lexer::CHUNK_SIZE - 3, ' ');
+    istringstream is(long_id + " = '"s + long_str + "\\n'\n"s + "#"s + padding + "\nx >= 1"s);
+    Lexer lexer(is);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{long_id}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{long_str + "\n"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::GreaterOrEq{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestMappedFile() {
+    const string path = "mython_lexer_test.my"s;
+    {
+        ofstream file(path);
+        file << "x = 'mapped'\n"s;
+    }
+    {
+        MappedFile mapped(path);
+        ASSERT_EQUAL(mapped.GetData(), "x = 'mapped'\n"sv);
+        Lexer lexer(mapped.GetData());
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"mapped"s}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    }
+    {
+        ofstream file(path, ios::trunc);
+    }
+    {
+        MappedFile empty(path);
+        ASSERT(empty.GetData().empty());
+        Lexer lexer(empty.GetData());
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Eof{}));
+    }
+    remove(path.c_str());
+    ASSERT_THROWS(MappedFile{path}, MappedFileError);
+}
+
+// Канал сообщает нулевой размер, но его содержимое всё равно читается целиком
+void TestMappedFifo() {
+#if __has_include(<sys/stat.h>)
+    const string path = "mython_lexer_test.fifo"s;
+    remove(path.c_str());
+    ASSERT_EQUAL(mkfifo(path.c_str(), 0600), 0);
+    thread writer([&path] {
+        ofstream file(path);
+        file << "print 1\n"s;
+    });
+    {
+        MappedFile fifo(path);
+        writer.join();
+        ASSERT_EQUAL(fifo.GetData(), "print 1\n"sv);
+    }
+    remove(path.c_str());
+#endif
+}
+
+void TestLineNumbers() {
+    Lexer lexer("x = 1\n\n# comment\nif x:\n  print x\n"sv);
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 1U);
+    lexer.NextToken();
+    lexer.NextToken();
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 1U);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::If{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 4U);
+    lexer.NextToken();
+    lexer.NextToken();
+    lexer.NextToken();
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 5U);
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+    ASSERT_EQUAL(lexer.CurrentLine(), 5U);
+}
 }  // namespace
 
 void RunOpenLexerTests(TestRunner& tr) {
@@ -367,6 +542,14 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestTokensAreReadOnDemand);
+    RUN_TEST(tr, parse::TestErrorsAreReportedOnDemand);
+    RUN_TEST(tr, parse::TestBufferAndStreamGiveSameTokens);
+    RUN_TEST(tr, parse::TestTokensReferToSource);
+    RUN_TEST(tr, parse::TestTokensAcrossChunks);
+    RUN_TEST(tr, parse::TestMappedFile);
+    RUN_TEST(tr, parse::TestMappedFifo);
+    RUN_TEST(tr, parse::TestLineNumbers);
 }
 
 }  // namespace parse
\ No newline at end of file
@@ -10,10 +10,15 @@ using namespace std;
 
 namespace parse {
 void RunOpenLexerTests(TestRunner& tr);
+void RunIncrementalParseTests(TestRunner& tr);
 }  // namespace parse
 
 namespace ast {
 void RunUnitTests(TestRunner& tr);
+void RunArenaTests(TestRunner& tr);
+void RunOptimizerTests(TestRunner& tr);
+void RunSerializerTests(TestRunner& tr);
+void RunProfilerTests(TestRunner& tr);
 }
 namespace runtime {
 void RunObjectHolderTests(TestRunner& tr);
@@ -22,6 +27,23 @@ void RunObjectsTests(TestRunner& tr);
 
 void TestParseProgram(TestRunner& tr);
 
+namespace vm {
+void RunVmTests(TestRunner& tr);
+}  // namespace vm
+
+namespace memory {
+void RunMemoryStatsTests(TestRunner& tr);
+}  // namespace memory
+
+namespace batch {
+void RunBatchTests(TestRunner& tr);
+}  // namespace batch
+
+namespace interpreter {
+void RunInterpreterTests(TestRunner& tr);
+void RunIsolateTests(TestRunner& tr);
+}  // namespace interpreter
+
 namespace {
 
 void RunMythonProgram(istream& input, ostream& output) {
@@ -117,7 +139,17 @@ void TestAll() {
     runtime::RunObjectHolderTests(tr);
     runtime::RunObjectsTests(tr);
     ast::RunUnitTests(tr);
+    ast::RunArenaTests(tr);
+    ast::RunOptimizerTests(tr);
+    ast::RunSerializerTests(tr);
+    ast::RunProfilerTests(tr);
     TestParseProgram(tr);
+    parse::RunIncrementalParseTests(tr);
+    vm::RunVmTests(tr);
+    batch::RunBatchTests(tr);
+    interpreter::RunInterpreterTests(tr);
+    interpreter::RunIsolateTests(tr);
+    memory::RunMemoryStatsTests(tr);
 
     RUN_TEST(tr, TestSimplePrints);
     RUN_TEST(tr, TestAssignments);
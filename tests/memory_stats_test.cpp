@@ -0,0 +1,127 @@
+#include "../lexer.h"
+#include "../memory_stats.h"
+#include "../parse.h"
+#include "../runtime.h"
+#include "../statement.h"
+
+#include "test_runner.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace memory {
+
+namespace {
+
+void TestCounters() {
+    ResetPeaks();
+    const MemoryStats before = GetMemoryStats();
+    OnAllocate(Category::OtherObjects, 100);
+    OnAllocate(Category::OtherObjects, 50);
+    OnDeallocate(Category::OtherObjects, 100);
+
+    MemoryStats after = GetMemoryStats();
+    const Usage& old_usage = before[Category::OtherObjects];
+    const Usage& usage = after[Category::OtherObjects];
+    ASSERT_EQUAL(usage.live_count, old_usage.live_count + 1);
+    ASSERT_EQUAL(usage.live_bytes, old_usage.live_bytes + 50);
+    ASSERT_EQUAL(usage.peak_count, old_usage.live_count + 2);
+    ASSERT_EQUAL(usage.peak_bytes, old_usage.live_bytes + 150);
+    ASSERT_EQUAL(usage.allocations, old_usage.allocations + 2);
+
+    OnDeallocate(Category::OtherObjects, 50);
+    ResetPeaks();
+    after = GetMemoryStats();
+    ASSERT_EQUAL(after[Category::OtherObjects].peak_bytes, old_usage.live_bytes);
+
+    // Распределитель учитывает блоки контейнера
+    const size_t fields = GetMemoryStats()[Category::InstanceFields].live_bytes;
+    {
+        vector<int, TrackingAllocator<int, Category::InstanceFields>> values;
+        values.reserve(10);
+        ASSERT_EQUAL(GetMemoryStats()[Category::InstanceFields].live_bytes, fields + 10 * sizeof(int));
+    }
+    ASSERT_EQUAL(GetMemoryStats()[Category::InstanceFields].live_bytes, fields);
+}
+
+void TestRuntimeCategories() {
+    const MemoryStats before = GetMemoryStats();
+    {
+        runtime::ObjectHolder text = runtime::ObjectHolder::Own(runtime::String(string(100, 'a')));
+        runtime::ObjectHolder sum = runtime::String::Concat(text, text);
+        runtime::Closure closure;
+        closure["text"s] = sum;
+
+        const MemoryStats during = GetMemoryStats();
+        ASSERT_EQUAL(during[Category::Strings].live_count, before[Category::Strings].live_count + 2);
+        ASSERT(during[Category::StringText].live_bytes >= before[Category::StringText].live_bytes + 100);
+        ASSERT(during[Category::Closures].live_count > before[Category::Closures].live_count);
+
+        // Текст узла конкатенации учитывается при его сборке
+        ASSERT_EQUAL(sum.TryAs<runtime::String>()->GetValue().size(), 200U);
+        ASSERT(GetMemoryStats()[Category::StringText].live_bytes >= during[Category::StringText].live_bytes + 200);
+    }
+    const MemoryStats after = GetMemoryStats();
+    for (Category category : {Category::Strings, Category::StringText, Category::Closures}) {
+        ASSERT_EQUAL(after[category].live_bytes, before[category].live_bytes);
+        ASSERT_EQUAL(after[category].live_count, before[category].live_count);
+    }
+}
+
+void TestProgramCategories() {
+    const MemoryStats before = GetMemoryStats();
+    {
+        istringstream input("class A:\n  def f():\n    self.x = 1\n\na = A()\na.f()\nprint a.x + 1\n"s);
+        parse::Lexer lexer(input);
+        auto program = ParseProgram(lexer);
+        const MemoryStats parsed = GetMemoryStats();
+        ASSERT(parsed[Category::AstNodes].live_count > before[Category::AstNodes].live_count);
+        ASSERT(parsed[Category::LexerTokens].allocations > before[Category::LexerTokens].allocations);
+
+        runtime::DummyContext context;
+        runtime::Closure globals;
+        program->Execute(globals, context);
+        const MemoryStats executed = GetMemoryStats();
+        ASSERT_EQUAL(executed[Category::Instances].live_count, before[Category::Instances].live_count + 1);
+        ASSERT(executed[Category::InstanceFields].live_bytes > before[Category::InstanceFields].live_bytes);
+    }
+    const MemoryStats after = GetMemoryStats();
+    for (Category category :
+         {Category::AstNodes, Category::Classes, Category::Instances, Category::InstanceFields, Category::LexerTokens}) {
+        ASSERT_EQUAL(after[category].live_bytes, before[category].live_bytes);
+    }
+
+    ostringstream report;
+    WriteReport(report, after);
+    ASSERT(report.str().find("ast nodes"s) != string::npos);
+}
+
+void TestAllocationHistogram() {
+    SetAllocationTracing(true);
+    OnAllocate(Category::OtherObjects, 24);
+    OnAllocate(Category::OtherObjects, 24);
+    OnAllocate(Category::OtherObjects, 1000);
+    SetAllocationTracing(false);
+    OnAllocate(Category::OtherObjects, 24);
+    OnDeallocate(Category::OtherObjects, 24);
+    OnDeallocate(Category::OtherObjects, 24);
+    OnDeallocate(Category::OtherObjects, 24);
+    OnDeallocate(Category::OtherObjects, 1000);
+
+    ostringstream histogram;
+    WriteAllocationHistogram(histogram);
+    ASSERT_EQUAL(histogram.str(), "other objects 1000 1 1000\nother objects 24 2 48\n"s);
+}
+
+}  // namespace
+
+void RunMemoryStatsTests(TestRunner& tr) {
+    RUN_TEST(tr, memory::TestCounters);
+    RUN_TEST(tr, memory::TestRuntimeCategories);
+    RUN_TEST(tr, memory::TestProgramCategories);
+    RUN_TEST(tr, memory::TestAllocationHistogram);
+}
+
+}  // namespace memory
@@ -0,0 +1,131 @@
+#include "../lexer.h"
+#include "../optimizer.h"
+#include "../parse.h"
+#include "../statement.h"
+
+#include "test_runner.h"
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+unique_ptr<Statement> Parse(const string& text) {
+    istringstream input(text);
+    parse::Lexer lexer(input);
+    return ParseProgram(lexer);
+}
+
+string Run(Statement& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program.Execute(closure, context);
+    return context.output.str();
+}
+
+const Statement& GetRightValue(const Statement& program, size_t index) {
+    const auto& statements = dynamic_cast<const Compound&>(program).GetStatements();
+    return dynamic_cast<const Assignment&>(*statements.at(index)).GetRightValue();
+}
+
+void TestFoldConstants() {
+    const string text = R"(
+x = 2 * 3 + 4
+y = str(10 / 3) + '!'
+z = not (1 < 2 and 'a' == 'a')
+w = x + 1
+print x, y, z, w
+)"s;
+    auto program = Parse(text);
+    const OptimizationStats stats = Optimize(program, OptimizationLevel::O1);
+    ASSERT_EQUAL(stats.folded_expressions, 9U);
+    ASSERT_EQUAL(stats.pruned_branches, 0U);
+
+    auto x = dynamic_cast<const NumericConst*>(&GetRightValue(*program, 0));
+    ASSERT(x != nullptr);
+    ASSERT_EQUAL(x->GetValue().GetValue(), 10);
+    auto y = dynamic_cast<const StringConst*>(&GetRightValue(*program, 1));
+    ASSERT(y != nullptr);
+    ASSERT_EQUAL(y->GetValue().GetValue(), "3!"s);
+    ASSERT(dynamic_cast<const BoolConst*>(&GetRightValue(*program, 2)) != nullptr);
+    // Выражения с переменными не сворачиваются
+    ASSERT(dynamic_cast<const Add*>(&GetRightValue(*program, 3)) != nullptr);
+
+    ASSERT_EQUAL(Run(*program), "10 3! False 11\n"s);
+}
+
+void TestFailingExpressionsAreKept() {
+    auto program = Parse("x = 1 + 2\ny = x / (2 - 2)\nz = 1 / 0\n"s);
+    const OptimizationStats stats = Optimize(program, OptimizationLevel::O1);
+    ASSERT_EQUAL(stats.folded_expressions, 2U);
+    ASSERT(dynamic_cast<const Div*>(&GetRightValue(*program, 2)) != nullptr);
+    ASSERT_THROWS(Run(*program), std::runtime_error);
+}
+
+void TestShortCircuit() {
+    // Правый операнд не вычисляется, поэтому неизвестная переменная не мешает свёртке
+    auto program = Parse("x = True or undefined\ny = False and undefined\nz = False or undefined\n"s);
+    const OptimizationStats stats = Optimize(program, OptimizationLevel::O1);
+    ASSERT_EQUAL(stats.folded_expressions, 2U);
+    ASSERT(dynamic_cast<const BoolConst*>(&GetRightValue(*program, 0)) != nullptr);
+    ASSERT(dynamic_cast<const BoolConst*>(&GetRightValue(*program, 1)) != nullptr);
+    ASSERT(dynamic_cast<const Or*>(&GetRightValue(*program, 2)) != nullptr);
+}
+
+void TestPruneBranches() {
+    const string text = R"(
+class Config:
+  def level():
+    if 2 > 1:
+      return 'high'
+    else:
+      return 'low'
+
+  def verbose():
+    if None:
+      return True
+    return False
+
+if True:
+  print 'enabled'
+else:
+  print undefined
+if 'a' == 'b':
+  print undefined
+config = Config()
+print config.level(), config.verbose()
+)"s;
+    auto program = Parse(text);
+    const string expected = Run(*Parse(text));
+    const OptimizationStats stats = Optimize(program, OptimizationLevel::O1);
+    ASSERT_EQUAL(stats.pruned_branches, 4U);
+    ASSERT_EQUAL(Run(*program), expected);
+    ASSERT_EQUAL(expected, "enabled\nhigh False\n"s);
+
+    const auto& statements = dynamic_cast<const Compound&>(*program).GetStatements();
+    for (const auto& stmt : statements) {
+        ASSERT(dynamic_cast<const IfElse*>(stmt.get()) == nullptr);
+    }
+}
+
+void TestNoOptimization() {
+    auto program = Parse("x = 2 * 3\nif True:\n  print x\n"s);
+    const OptimizationStats stats = Optimize(program, OptimizationLevel::O0);
+    ASSERT_EQUAL(stats.folded_expressions, 0U);
+    ASSERT_EQUAL(stats.pruned_branches, 0U);
+    ASSERT(dynamic_cast<const Mult*>(&GetRightValue(*program, 0)) != nullptr);
+    ASSERT_EQUAL(Run(*program), "6\n"s);
+}
+
+}  // namespace
+
+void RunOptimizerTests(TestRunner& tr) {
+    RUN_TEST(tr, ast::TestFoldConstants);
+    RUN_TEST(tr, ast::TestFailingExpressionsAreKept);
+    RUN_TEST(tr, ast::TestShortCircuit);
+    RUN_TEST(tr, ast::TestPruneBranches);
+    RUN_TEST(tr, ast::TestNoOptimization);
+}
+
+}  // namespace ast
@@ -245,6 +245,49 @@ print r, c, t1, t2
                  "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
 }
 
+void TestMethodLocalsUseSlots() {
+    const string program = R"(
+class Counter:
+  def count(n, step):
+    total = 0
+    if n > 0:
+      total = step + self.count(n - 1, step)
+    return total
+
+  def unassigned(flag):
+    if flag:
+      value = 1
+    return value
+
+c = Counter()
+result = c.count(3, 2)
+print result
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "6\n"s);
+    // Локальные переменные методов не попадают в словарь глобальных переменных
+    ASSERT_EQUAL(closure.size(), 3U);
+    ASSERT_EQUAL(closure.count("total"s), 0U);
+    ASSERT_EQUAL(closure.at("result"s).TryAs<runtime::Number>()->GetValue(), 6);
+
+    const auto& cls = *closure.at("Counter"s).TryAs<runtime::Class>();
+    const runtime::Method* count = cls.GetMethod("count"s);
+    ASSERT(count != nullptr);
+    ASSERT_EQUAL(count->slot_names, (vector<string>{"self"s, "n"s, "step"s, "total"s}));
+
+    auto& instance = *closure.at("c"s).TryAs<runtime::ClassInstance>();
+    const auto yes = runtime::ObjectHolder::Own(runtime::Bool(true));
+    const auto no = runtime::ObjectHolder::Own(runtime::Bool(false));
+    ASSERT(runtime::IsTrue(instance.Call("unassigned"s, {yes}, context)));
+    ASSERT_THROWS(instance.Call("unassigned"s, {no}, context), std::runtime_error);
+}
+
 }  // namespace parse
 
 void TestParseProgram(TestRunner& tr) {
@@ -256,4 +299,5 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestRecursion2);
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
+    RUN_TEST(tr, parse::TestMethodLocalsUseSlots);
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "../interpreter.h"
+#include "../lexer.h"
+#include "../parse.h"
+#include "../profiler.h"
+#include "../statement.h"
+
+#include "test_runner.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+const string PROGRAM = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def inc(n):
+    if n > 0:
+      self.value = self.value + 1
+      self.inc(n - 1)
+
+  def fail():
+    return 1 / 0
+
+c = Counter()
+c.inc(3)
+print c.value
+)"s;
+
+unique_ptr<Statement> Parse(const string& source) {
+    istringstream input(source);
+    parse::Lexer lexer(input);
+    return ParseProgram(lexer);
+}
+
+const Profiler::FrameProfile& FindFrame(const Profiler& profiler, const string& name) {
+    for (const auto& frame : profiler.GetFrames()) {
+        if (frame.name == name) {
+            return frame;
+        }
+    }
+    throw runtime_error("No frame "s + name);
+}
+
+void TestStatementLines() {
+    auto program = Parse(PROGRAM);
+    const auto& statements = dynamic_cast<const Compound&>(*program).GetStatements();
+    ASSERT_EQUAL(statements.size(), 4U);
+    ASSERT_EQUAL(statements[0]->GetLine(), 2U);
+    ASSERT_EQUAL(statements[1]->GetLine(), 14U);
+    ASSERT_EQUAL(statements[3]->GetLine(), 16U);
+    // Операнды выражения относятся к строке инструкции
+    const auto& print = dynamic_cast<const Print&>(*statements[3]);
+    ASSERT_EQUAL(print.GetArgs()[0]->GetLine(), 16U);
+
+    const auto& cls = *dynamic_cast<const ClassDefinition&>(*statements[0]).GetClass().TryAs<runtime::Class>();
+    const auto& inc = dynamic_cast<const MethodBody&>(*cls.GetMethod("inc"s)->body);
+    ASSERT_EQUAL(inc.GetLine(), 6U);
+    const auto& inc_statements = dynamic_cast<const Compound&>(inc.GetBody()).GetStatements();
+    ASSERT_EQUAL(inc_statements[0]->GetLine(), 7U);
+    const auto& if_body = dynamic_cast<const Compound&>(dynamic_cast<const IfElse&>(*inc_statements[0]).GetIfBody());
+    ASSERT_EQUAL(if_body.GetStatements()[1]->GetLine(), 9U);
+}
+
+void TestCounters() {
+    Profiler profiler;
+    auto program = Parse(PROGRAM);
+    profiler.Instrument(program);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "3\n"s);
+
+    ASSERT_EQUAL(FindFrame(profiler, "<module>"s).count, 1U);
+    ASSERT_EQUAL(FindFrame(profiler, "Counter.__init__"s).count, 1U);
+    const auto& inc = FindFrame(profiler, "Counter.inc"s);
+    ASSERT_EQUAL(inc.count, 4U);
+    ASSERT_EQUAL(inc.line, 6U);
+    ASSERT_EQUAL(inc.depth, 0U);
+    ASSERT_EQUAL(FindFrame(profiler, "Counter.fail"s).count, 0U);
+    // Рекурсивные вызовы не учитываются в суммарном времени повторно
+    ASSERT(inc.total <= FindFrame(profiler, "<module>"s).total);
+
+    size_t field_assignments = 0;
+    for (const auto& node : profiler.GetNodes()) {
+        if (node.kind == "FieldAssignment"sv && node.line == 8) {
+            field_assignments += node.count;
+        }
+    }
+    ASSERT_EQUAL(field_assignments, 3U);
+
+    ostringstream stacks;
+    profiler.WriteCollapsedStacks(stacks);
+    const string folded = stacks.str();
+    ASSERT(folded.find("<module>;Counter.__init__ "s) != string::npos);
+    ASSERT(folded.find("<module>;Counter.inc;Counter.inc;Counter.inc;Counter.inc "s) != string::npos);
+
+    ostringstream report;
+    profiler.WriteReport(report);
+    ASSERT(report.str().find("Counter.inc"s) != string::npos);
+    ASSERT(report.str().find("FieldAssignment"s) != string::npos);
+}
+
+void TestFramesUnwindOnErrors() {
+    Profiler profiler;
+    auto program = Parse(PROGRAM + "c.fail()\n"s);
+    profiler.Instrument(program);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ASSERT_THROWS(program->Execute(closure, context), runtime_error);
+    ASSERT_EQUAL(FindFrame(profiler, "Counter.fail"s).count, 1U);
+    ASSERT_EQUAL(FindFrame(profiler, "Counter.fail"s).depth, 0U);
+
+    // После ошибки стек вызовов вновь начинается с программы
+    runtime::Closure second;
+    ASSERT_THROWS(program->Execute(second, context), runtime_error);
+    ostringstream stacks;
+    profiler.WriteCollapsedStacks(stacks);
+    ASSERT(stacks.str().find("<module>;<module>"s) == string::npos);
+    ASSERT_EQUAL(FindFrame(profiler, "<module>"s).count, 2U);
+}
+
+void TestInterpreterOptions() {
+    Profiler profiler;
+    interpreter::Options options;
+    options.profiler = &profiler;
+    const auto program = interpreter::Compile(PROGRAM, options);
+    runtime::DummyContext context;
+    interpreter::Run(program, context);
+    ASSERT_EQUAL(context.output.str(), "3\n"s);
+    ASSERT_EQUAL(FindFrame(profiler, "Counter.inc"s).count, 4U);
+
+    options.engine = interpreter::Engine::Vm;
+    ASSERT_THROWS(interpreter::Compile(PROGRAM, options), invalid_argument);
+}
+
+// Счётчики не меняют исполнение программы: хвостовые вызовы по-прежнему не увеличивают глубину рекурсии
+void TestTailCalls() {
+    Profiler profiler;
+    interpreter::Options options;
+    options.profiler = &profiler;
+    options.recursion_limit = 100;
+    const auto program = interpreter::Compile(R"(
+class Loop:
+  def run(n, total):
+    if n == 0:
+      return total
+    return self.run(n - 1, total + n)
+
+l = Loop()
+print l.run(5000, 0)
+)"s,
+                                              options);
+    runtime::DummyContext context;
+    interpreter::Run(program, context);
+    ASSERT_EQUAL(context.output.str(), "12502500\n"s);
+    ASSERT_EQUAL(FindFrame(profiler, "Loop.run"s).count, 5001U);
+    ASSERT_EQUAL(FindFrame(profiler, "Loop.run"s).depth, 0U);
+
+    size_t calls = 0;
+    for (const auto& node : profiler.GetNodes()) {
+        if (node.kind == "MethodCall"sv && node.line == 6) {
+            calls += node.count;
+        }
+    }
+    ASSERT_EQUAL(calls, 5000U);
+}
+
+}  // namespace
+
+void RunProfilerTests(TestRunner& tr) {
+    RUN_TEST(tr, ast::TestStatementLines);
+    RUN_TEST(tr, ast::TestCounters);
+    RUN_TEST(tr, ast::TestFramesUnwindOnErrors);
+    RUN_TEST(tr, ast::TestInterpreterOptions);
+    RUN_TEST(tr, ast::TestTailCalls);
+}
+
+}  // namespace ast
@@ -1,6 +1,7 @@
 #include "../runtime.h"
 
 #include <functional>
+#include <thread>
 #include "test_runner.h"
 
 using namespace std;
@@ -19,7 +20,8 @@ public:
     }
 
     Logger(const Logger& rhs)
-        : id_(rhs.id_)  //
+        : Object(rhs)
+        , id_(rhs.id_)  //
     {
         ++instance_count;
     }
@@ -248,6 +250,236 @@ void TestNullptr() {
     ASSERT(!oh.Get());
 }
 
+void TestInlineValues() {
+    auto number = ObjectHolder::Own(Number{42});
+    auto copy = number;
+    ASSERT(number.Get() != copy.Get());
+    ASSERT_EQUAL(copy.TryAs<Number>()->GetValue(), 42);
+    ASSERT(copy.TryAs<Bool>() == nullptr);
+    ASSERT(copy.TryAs<String>() == nullptr);
+    ASSERT(dynamic_cast<Number*>(copy.Get()) != nullptr);
+
+    auto flag = ObjectHolder::Own(Bool{true});
+    ASSERT(flag.TryAs<Bool>()->GetValue());
+    ASSERT(flag.TryAs<Number>() == nullptr);
+    ASSERT(flag.TryAs<ValueObject<bool>>() != nullptr);
+
+    number = flag;
+    ASSERT(number.TryAs<Number>() == nullptr);
+    ASSERT(number.TryAs<Bool>() != nullptr);
+
+    Number shared{7};
+    auto reference = ObjectHolder::Share(shared);
+    ASSERT(reference.TryAs<Number>() == &shared);
+
+    DummyContext context;
+    ASSERT(Equal(reference, ObjectHolder::Own(Number{7}), context));
+    ASSERT(Less(copy, ObjectHolder::Own(Number{43}), context));
+    ASSERT(IsTrue(flag));
+    ASSERT(!IsTrue(ObjectHolder::Own(Number{0})));
+
+    copy->Print(context.output, context);
+    ASSERT_EQUAL(context.output.str(), "42"s);
+}
+
+void TestPoolAllocation() {
+    // Блоки одного класса размеров переиспользуются
+    void* block = PoolAllocate(40);
+    PoolDeallocate(block, 40);
+    ASSERT_EQUAL(PoolAllocate(33), block);
+    PoolDeallocate(block, 33);
+
+    void* large = PoolAllocate(POOL_MAX_SIZE + 1);
+    ASSERT(large != nullptr);
+    PoolDeallocate(large, POOL_MAX_SIZE + 1);
+
+    const Object* first = nullptr;
+    {
+        auto str = ObjectHolder::Own(String{"pooled"s});
+        first = str.Get();
+    }
+    auto str = ObjectHolder::Own(String{"reused"s});
+    ASSERT_EQUAL(str.Get(), first);
+    ASSERT_EQUAL(str.TryAs<String>()->GetValue(), "reused"s);
+
+    {
+        ASSERT_EQUAL(Logger::instance_count, 0);
+        auto logger = ObjectHolder::Own(Logger(5));
+        ASSERT_EQUAL(Logger::instance_count, 1);
+    }
+    ASSERT_EQUAL(Logger::instance_count, 0);
+}
+
+void TestReferenceCounting() {
+    ASSERT_EQUAL(Logger::instance_count, 0);
+    {
+        auto one = ObjectHolder::Own(Logger(1));
+        ASSERT(one.IsUnique());
+        {
+            ObjectHolder two = one;
+            ASSERT(!one.IsUnique());
+            ASSERT(two.Get() == one.Get());
+            ObjectHolder three;
+            three = two;
+            three = std::move(two);
+            ASSERT(!two);  // NOLINT
+            ASSERT_EQUAL(Logger::instance_count, 1);
+        }
+        ASSERT(one.IsUnique());
+
+        // Невладеющая ссылка не продлевает жизнь объекта
+        auto shared = ObjectHolder::Share(*one);
+        ASSERT(!shared.IsUnique());
+        one = shared;
+        ASSERT_EQUAL(Logger::instance_count, 0);
+    }
+    ASSERT_EQUAL(Logger::instance_count, 0);
+
+    // Объект, разрешённый к передаче между потоками, освобождается ровно один раз
+    {
+        auto object = ObjectHolder::Own(Logger(2));
+        object.ShareBetweenThreads();
+        vector<thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([object] {
+                for (int j = 0; j < 10000; ++j) {
+                    ObjectHolder copy = object;
+                    ASSERT(copy.TryAs<Logger>() != nullptr);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        ASSERT(object.IsUnique());
+    }
+    ASSERT_EQUAL(Logger::instance_count, 0);
+}
+
+void TestCycleCollection() {
+    Class cls{"Node"s, {}, nullptr};
+    const HeapStats initial = GetHeapStats();
+    {
+        // Цикл из двух экземпляров и экземпляр, ссылающийся на себя, недостижимы после выхода из блока
+        auto a = ObjectHolder::Own(ClassInstance{cls});
+        auto b = ObjectHolder::Own(ClassInstance{cls});
+        a.TryAs<ClassInstance>()->Fields()["next"s] = b;
+        a.TryAs<ClassInstance>()->Fields()["payload"s] = ObjectHolder::Own(Logger(1));
+        b.TryAs<ClassInstance>()->Fields()["next"s] = a;
+        auto c = ObjectHolder::Own(ClassInstance{cls});
+        c.TryAs<ClassInstance>()->Fields()["next"s] = c;
+        ASSERT_EQUAL(GetHeapStats().instances, initial.instances + 3);
+
+        // Пока на экземпляры ссылаются переменные, сборка их не освобождает
+        ASSERT_EQUAL(CollectCycles(), 0U);
+        ASSERT_EQUAL(GetHeapStats().instances, initial.instances + 3);
+    }
+    ASSERT_EQUAL(Logger::instance_count, 1);
+    ASSERT_EQUAL(CollectCycles(), 3U);
+    ASSERT_EQUAL(Logger::instance_count, 0);
+
+    HeapStats stats = GetHeapStats();
+    ASSERT_EQUAL(stats.instances, initial.instances);
+    ASSERT_EQUAL(stats.objects, initial.objects);
+    ASSERT_EQUAL(stats.bytes, initial.bytes);
+    ASSERT_EQUAL(stats.collections, initial.collections + 2);
+    ASSERT_EQUAL(stats.collected, initial.collected + 3);
+
+    // Цикл, достижимый из внешнего экземпляра, сохраняется целиком
+    {
+        auto root = ObjectHolder::Own(ClassInstance{cls});
+        {
+            auto a = ObjectHolder::Own(ClassInstance{cls});
+            auto b = ObjectHolder::Own(ClassInstance{cls});
+            a.TryAs<ClassInstance>()->Fields()["next"s] = b;
+            b.TryAs<ClassInstance>()->Fields()["next"s] = a;
+            root.TryAs<ClassInstance>()->Fields()["next"s] = a;
+        }
+        ASSERT_EQUAL(CollectCycles(), 0U);
+        auto& a = root.TryAs<ClassInstance>()->Fields()["next"s];
+        auto& b = a.TryAs<ClassInstance>()->Fields()["next"s];
+        ASSERT(b.TryAs<ClassInstance>()->Fields()["next"s].Get() == a.Get());
+
+        // Экземпляр, переданный другим потокам, не учитывается сборщиком текущего потока
+        root.ShareBetweenThreads();
+        ASSERT_EQUAL(GetHeapStats().instances, initial.instances + 2);
+        root.TryAs<ClassInstance>()->Fields()["next"s] = ObjectHolder::None();
+    }
+    ASSERT_EQUAL(CollectCycles(), 2U);
+
+    // Автоматическая сборка по числу созданных экземпляров
+    SetCollectionThreshold(100);
+    const size_t collections = GetHeapStats().collections;
+    for (int i = 0; i < 1000; ++i) {
+        auto instance = ObjectHolder::Own(ClassInstance{cls});
+        instance.TryAs<ClassInstance>()->Fields()["next"s] = instance;
+    }
+    stats = GetHeapStats();
+    ASSERT(stats.collections > collections);
+    ASSERT(stats.instances <= initial.instances + 100);
+    CollectCycles();
+    SetCollectionThreshold(DEFAULT_COLLECTION_THRESHOLD);
+    ASSERT_EQUAL(GetHeapStats().instances, initial.instances);
+}
+
+void TestExecutionLimit() {
+    DummyContext context;
+    context.SetStepLimit(3);
+    for (int i = 0; i < 3; ++i) {
+        context.Step();
+    }
+    ASSERT_EQUAL(context.GetStepCount(), 3U);
+    try {
+        context.Step();
+        ASSERT(false);
+    } catch (const ExecutionLimitError& e) {
+        ASSERT(e.GetLimit() == ExecutionLimit::Steps);
+    }
+    // Превышение сообщается до изменения ограничений
+    ASSERT_THROWS(context.Step(), ExecutionLimitError);
+    context.SetStepLimit(0);
+    context.Step();
+    ASSERT_EQUAL(context.GetStepCount(), 1U);
+
+    // Срок проверяется раз в LIMIT_CHECK_INTERVAL шагов даже без бюджета шагов
+    context.SetDeadline(chrono::steady_clock::now() - 1s);
+    for (uint64_t i = 1; i < LIMIT_CHECK_INTERVAL; ++i) {
+        context.Step();
+    }
+    try {
+        context.Step();
+        ASSERT(false);
+    } catch (const ExecutionLimitError& e) {
+        ASSERT(e.GetLimit() == ExecutionLimit::Deadline);
+    }
+    ASSERT_EQUAL(context.GetStepCount(), LIMIT_CHECK_INTERVAL + 1);
+    context.SetDeadline(nullopt);
+    context.Step();
+}
+
+void TestObjectKind() {
+    ASSERT(ObjectHolder::None().GetKind() == ObjectKind::None);
+    ASSERT(ObjectHolder::Own(Number{1}).GetKind() == ObjectKind::Number);
+    ASSERT(ObjectHolder::Own(Bool{false}).GetKind() == ObjectKind::Bool);
+    ASSERT(ObjectHolder::Own(String{"s"s}).GetKind() == ObjectKind::String);
+
+    Number number{5};
+    ASSERT(ObjectHolder::Share(number).GetKind() == ObjectKind::Number);
+
+    Class cls{"A"s, {}, nullptr};
+    ClassInstance instance{cls};
+    ASSERT(ObjectHolder::Share(cls).GetKind() == ObjectKind::Class);
+    ASSERT(ObjectHolder::Share(instance).GetKind() == ObjectKind::ClassInstance);
+    ASSERT(ObjectHolder::Share(instance).TryAs<ClassInstance>() == &instance);
+    ASSERT(ObjectHolder::Share(instance).TryAs<Class>() == nullptr);
+    ASSERT(ObjectHolder::Share(cls).TryAs<Object>() == &cls);
+
+    Logger logger;
+    ASSERT(ObjectHolder::Share(logger).GetKind() == ObjectKind::Other);
+    ASSERT(ObjectHolder::Share(logger).TryAs<Logger>() == &logger);
+    ASSERT(ObjectHolder::Share(logger).TryAs<Number>() == nullptr);
+}
+
 void TestIsTrue() {
     {
         ASSERT(!IsTrue(ObjectHolder::Own(Bool{false})));
@@ -529,6 +761,190 @@ void TestClassInstance() {
     ASSERT_THROWS(instance.Call("missing_method"s, {}, ctx), runtime_error);
 }
 
+void TestInstanceShapes() {
+    Class cls{"Point"s, {}, nullptr};
+    ClassInstance first{cls};
+    ClassInstance second{cls};
+    ClassInstance reversed{cls};
+    ASSERT_EQUAL(&first.Fields().GetShape(), &cls.GetInstanceShape());
+
+    first.Fields()["x"s] = ObjectHolder::Own(Number{1});
+    first.Fields()["y"s] = ObjectHolder::Own(Number{2});
+    second.Fields()["x"s] = ObjectHolder::Own(Number{3});
+    second.Fields()["y"s] = ObjectHolder::Own(Number{4});
+    reversed.Fields()["y"s] = ObjectHolder::Own(Number{5});
+    reversed.Fields()["x"s] = ObjectHolder::Own(Number{6});
+
+    // Объекты с одинаковым порядком добавления полей разделяют форму
+    ASSERT_EQUAL(&first.Fields().GetShape(), &second.Fields().GetShape());
+    ASSERT(&first.Fields().GetShape() != &reversed.Fields().GetShape());
+    ASSERT_EQUAL(first.Fields().size(), 2U);
+    ASSERT_EQUAL(reversed.Fields().GetShape().FindOffset("x"s), 1U);
+    ASSERT_EQUAL(second.Fields().at("y"s).TryAs<Number>()->GetValue(), 4);
+    ASSERT_THROWS(second.Fields().at("z"s), std::runtime_error);
+    ASSERT_EQUAL(second.Fields().count("z"s), 0U);
+
+    vector<string> names;
+    for (auto [name, value] : reversed.Fields()) {
+        names.push_back(name);
+        ASSERT(value.TryAs<Number>() != nullptr);
+    }
+    ASSERT_EQUAL(names, (vector<string>{"y"s, "x"s}));
+
+    // Один кеш обслуживает объекты разных форм, в том числе при добавлении поля
+    FieldCache cache;
+    for (int round = 0; round < 2; ++round) {
+        for (ClassInstance* instance : {&first, &reversed}) {
+            ASSERT_EQUAL(cache.Find(instance->Fields(), "x"s), &instance->Fields().at("x"s));
+        }
+    }
+    ASSERT(cache.Find(ClassInstance{cls}.Fields(), "x"s) == nullptr);
+
+    FieldCache assign_cache;
+    for (int i = 0; i < 3; ++i) {
+        ClassInstance fresh{cls};
+        assign_cache.Assign(fresh.Fields(), "x"s) = ObjectHolder::Own(Number{i});
+        ASSERT_EQUAL(&fresh.Fields().GetShape(), &cls.GetInstanceShape().AddField("x"s));
+        ASSERT_EQUAL(fresh.Fields().at("x"s).TryAs<Number>()->GetValue(), i);
+    }
+}
+
+void TestSymbols() {
+    const Symbol name{"symbol_test_name"s};
+    const size_t interned = InternedSymbolCount();
+
+    // Повторное обращение к имени возвращает тот же символ и не пополняет таблицу
+    const Symbol same{"symbol_test_name"sv};
+    ASSERT(name == same);
+    ASSERT_EQUAL(&name.GetName(), &same.GetName());
+    ASSERT_EQUAL(hash<Symbol>{}(name), hash<Symbol>{}(same));
+    ASSERT_EQUAL(InternedSymbolCount(), interned);
+
+    const Symbol other = "symbol_test_other";
+    ASSERT(name != other);
+    ASSERT_EQUAL(other.GetName(), "symbol_test_other"s);
+    ASSERT_EQUAL(InternedSymbolCount(), interned + 1);
+    ASSERT(Symbol{} == Symbol{""s});
+
+    ostringstream os;
+    os << name;
+    ASSERT_EQUAL(os.str(), "symbol_test_name"s);
+}
+
+void TestOutputBuffer() {
+    ostringstream out;
+    {
+        OutputBuffer buffer(out, 8);
+        buffer.Append("abc"sv);
+        ASSERT_EQUAL(out.str(), ""s);
+        // Данные, не поместившиеся в буфер, передаются в поток вслед за накопленными
+        buffer.AppendNumber(numeric_limits<int>::min());
+        ASSERT_EQUAL(out.str(), "abc-2147483648"s);
+        buffer.Append(' ');
+        buffer.AppendNumber(42);
+        ASSERT_EQUAL(out.str(), "abc-2147483648"s);
+        buffer.Flush();
+        ASSERT_EQUAL(out.str(), "abc-2147483648 42"s);
+        buffer.Append("long text goes straight through"sv);
+        ASSERT_EQUAL(out.str(), "abc-2147483648 42long text goes straight through"s);
+        buffer.Append('!');
+    }
+    ASSERT_EQUAL(out.str(), "abc-2147483648 42long text goes straight through!"s);
+
+    // Прямой вывод в поток контекста не обгоняет содержимое буфера
+    ostringstream context_out;
+    SimpleContext context(context_out);
+    context.GetOutputBuffer().Append("buffered "sv);
+    ASSERT_EQUAL(context_out.str(), ""s);
+    context.GetOutputStream() << "direct";
+    ASSERT_EQUAL(context_out.str(), "buffered direct"s);
+}
+
+void TestPrintValue() {
+    vector<Method> methods;
+    methods.push_back({"__str__", {}, make_unique<TestMethodBody>([](Closure&, Context&) {
+                           return ObjectHolder::Own(Number{-7});
+                       })});
+    Class with_str{"WithStr"s, move(methods), nullptr};
+    Class without_str{"WithoutStr"s, {}, nullptr};
+
+    DummyContext context;
+    const vector<ObjectHolder> values = {
+        ObjectHolder::Own(Number{-15}),    ObjectHolder::Own(String{"text"s}),
+        ObjectHolder::Own(Bool{true}),     ObjectHolder::None(),
+        ObjectHolder::Share(without_str),  ObjectHolder::Own(ClassInstance{with_str}),
+    };
+    string expected;
+    for (const auto& value : values) {
+        PrintValue(value, context);
+        expected += ToString(value, context);
+    }
+    ASSERT_EQUAL(context.output.str(), expected);
+    ASSERT_EQUAL(expected, "-15textTrueNoneClass WithoutStr-7"s);
+
+    // Экземпляр без __str__ выводится так же, как через Object::Print
+    ObjectHolder instance = ObjectHolder::Own(ClassInstance{without_str});
+    ostringstream out;
+    instance->Print(out, context);
+    ASSERT_EQUAL(ToString(instance, context), out.str());
+}
+
+void TestStringConcatenation() {
+    DummyContext context;
+    const string piece = "0123456789"s;
+    const ObjectHolder x = ObjectHolder::Own(String{piece});
+
+    // Построение строки по частям: длина известна без сборки, байты собираются при сравнении
+    constexpr int count = 200000;
+    ObjectHolder s = ObjectHolder::Own(String{""s});
+    for (int i = 0; i < count; ++i) {
+        s = Add(s, x, context);
+    }
+    ASSERT_EQUAL(s.TryAs<String>()->GetSize(), piece.size() * count);
+    ASSERT(IsTrue(s));
+
+    string expected;
+    for (int i = 0; i < count; ++i) {
+        expected += piece;
+    }
+    ASSERT(Equal(s, ObjectHolder::Own(String{expected}), context));
+    ASSERT(!Equal(s, x, context));
+    ASSERT(Less(x, s, context));
+
+    // Слагаемые не изменяются, копия строки не зависит от оригинала
+    const ObjectHolder left = Add(s, x, context);
+    const ObjectHolder right = Add(x, s, context);
+    ASSERT_EQUAL(right.TryAs<String>()->GetValue(), piece + expected);
+    ASSERT_EQUAL(left.TryAs<String>()->GetValue(), expected + piece);
+    ASSERT_EQUAL(s.TryAs<String>()->GetValue(), expected);
+    const String copy = *Add(left, x, context).TryAs<String>();
+    ASSERT_EQUAL(copy.GetValue(), expected + piece + piece);
+
+    ASSERT_EQUAL(ToString(Add(x, x, context), context), piece + piece);
+    ASSERT(!IsTrue(Add(ObjectHolder::Own(String{""s}), ObjectHolder::Own(String{""s}), context)));
+
+    // Результат владеет слагаемыми, на которые аргументы лишь ссылаются (строки из дерева программы)
+    {
+        auto empty = make_unique<String>(""s);
+        auto literal = make_unique<String>(string(String::ROPE_MIN_SIZE, 'b'));
+        const ObjectHolder same = Add(ObjectHolder::Share(*literal), ObjectHolder::Share(*empty), context);
+        const ObjectHolder rope = Add(x, ObjectHolder::Share(*literal), context);
+        ASSERT(!same.IsShared());
+        ASSERT(same.Get() != literal.get());
+        literal.reset();
+        empty.reset();
+        ASSERT_EQUAL(same.TryAs<String>()->GetValue(), string(String::ROPE_MIN_SIZE, 'b'));
+        ASSERT_EQUAL(rope.TryAs<String>()->GetValue(), piece + string(String::ROPE_MIN_SIZE, 'b'));
+    }
+
+    // Длинная несобранная цепочка освобождается без переполнения стека
+    ObjectHolder chain = ObjectHolder::Own(String{string(String::ROPE_MIN_SIZE, 'a')});
+    for (int i = 0; i < 1000000; ++i) {
+        chain = Add(chain, x, context);
+    }
+    chain = ObjectHolder::None();
+}
+
 }  // namespace
 
 void RunObjectsTests(TestRunner& tr) {
@@ -540,6 +956,11 @@ void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestComparison);
     RUN_TEST(tr, runtime::TestClass);
     RUN_TEST(tr, runtime::TestClassInstance);
+    RUN_TEST(tr, runtime::TestInstanceShapes);
+    RUN_TEST(tr, runtime::TestSymbols);
+    RUN_TEST(tr, runtime::TestOutputBuffer);
+    RUN_TEST(tr, runtime::TestPrintValue);
+    RUN_TEST(tr, runtime::TestStringConcatenation);
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
@@ -547,6 +968,12 @@ void RunObjectHolderTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestOwning);
     RUN_TEST(tr, runtime::TestMove);
     RUN_TEST(tr, runtime::TestNullptr);
+    RUN_TEST(tr, runtime::TestInlineValues);
+    RUN_TEST(tr, runtime::TestObjectKind);
+    RUN_TEST(tr, runtime::TestPoolAllocation);
+    RUN_TEST(tr, runtime::TestReferenceCounting);
+    RUN_TEST(tr, runtime::TestCycleCollection);
+    RUN_TEST(tr, runtime::TestExecutionLimit);
 }
 
 }  // namespace runtime
\ No newline at end of file
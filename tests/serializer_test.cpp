@@ -0,0 +1,165 @@
+#include "../lexer.h"
+#include "../parse.h"
+#include "../serializer.h"
+#include "../statement.h"
+
+#include "test_runner.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+const string PROGRAM = R"(
+class Shape:
+  def __init__(name):
+    self.name = name
+    self.scale = -3
+
+  def area():
+    return 0
+
+  def __str__():
+    return self.name + ' ' + str(self.area())
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.name = 'rect'
+    self.w = w
+    self.h = h
+
+  def area():
+    result = self.w * self.h
+    if result >= 100 and not result == 144:
+      return 'big'
+    else:
+      return result
+
+class Factory:
+  def make(w):
+    return Rect(w, w + 1)
+
+f = Factory()
+r = f.make(3)
+print r, Shape('dot')
+big = f.make(20)
+print big, big.w / 2 - 1, r.w < 1 or r.h != 4
+if True:
+  print 'folded', 2 + 3
+print None
+)"s;
+
+unique_ptr<Statement> Parse(const string& source) {
+    istringstream input(source);
+    parse::Lexer lexer(input);
+    return ParseProgram(lexer);
+}
+
+string Execute(Statement& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program.Execute(closure, context);
+    return context.output.str();
+}
+
+string Serialize(const Statement& program) {
+    ostringstream output;
+    SerializeProgram(program, output);
+    return output.str();
+}
+
+void TestRoundTrip() {
+    auto program = Parse(PROGRAM);
+    const string expected = Execute(*program);
+    ASSERT_EQUAL(expected, "rect 12 dot 0\nrect big 9 False\nfolded 5\nNone\n"s);
+
+    const string image = Serialize(*program);
+    ASSERT(IsProgramImage(image));
+    ASSERT(!IsProgramImage(PROGRAM));
+
+    auto loaded = DeserializeProgram(image);
+    ASSERT_EQUAL(Execute(*loaded), expected);
+    // Повторная запись восстановленного дерева даёт тот же образ
+    ASSERT_EQUAL(Serialize(*loaded), image);
+
+    // Образ живёт отдельно от исходного дерева
+    program.reset();
+    ASSERT_EQUAL(Execute(*loaded), expected);
+}
+
+void TestCorruptedImages() {
+    const string image = Serialize(*Parse(PROGRAM));
+    for (size_t size = 0; size < image.size(); ++size) {
+        ASSERT_THROWS(DeserializeProgram(string_view(image).substr(0, size)), SerializationError);
+    }
+    ASSERT_THROWS(DeserializeProgram(image + "x"s), SerializationError);
+    ASSERT_THROWS(DeserializeProgram("print 1\n"sv), SerializationError);
+
+    string bad_version = image;
+    bad_version[IMAGE_MAGIC.size()] = '\x7f';
+    ASSERT_THROWS(DeserializeProgram(bad_version), SerializationError);
+}
+
+// Номер слота переменной проверяется по числу слотов метода, в котором она находится
+void TestCorruptedSlots() {
+    Compound top_level;
+    auto variable = make_unique<VariableValue>("x"s);
+    variable->BindSlot(0);
+    top_level.AddStatement(make_unique<Print>(std::move(variable)));
+    ASSERT_THROWS(DeserializeProgram(Serialize(top_level)), SerializationError);
+
+    // Образ с любым изменённым байтом либо отвергается, либо исполняется без выхода за пределы кадра
+    const string image = Serialize(*Parse(R"(
+class A:
+  def f(x, y):
+    z = x + y
+    return z * x
+
+a = A()
+print a.f(2, 3)
+)"s));
+    for (size_t pos = IMAGE_MAGIC.size() + 1; pos < image.size(); ++pos) {
+        for (int delta : {1, 2, 3, -1}) {
+            string corrupted = image;
+            corrupted[pos] = static_cast<char>(corrupted[pos] + delta);
+            unique_ptr<Statement> program;
+            try {
+                program = DeserializeProgram(corrupted);
+            } catch (const SerializationError&) {
+                continue;
+            }
+            runtime::DummyContext context;
+            context.SetStepLimit(10000);
+            runtime::Closure closure;
+            try {
+                program->Execute(closure, context);
+            } catch (const runtime_error&) {
+            }
+        }
+    }
+}
+
+void TestUnsupportedNodes() {
+    Compound program;
+    program.AddStatement(make_unique<Comparison>(
+        [](const runtime::ObjectHolder&, const runtime::ObjectHolder&, runtime::Context&) {
+            return true;
+        },
+        make_unique<NumericConst>(1), make_unique<NumericConst>(2)));
+    ostringstream output;
+    ASSERT_THROWS(SerializeProgram(program, output), SerializationError);
+}
+
+}  // namespace
+
+void RunSerializerTests(TestRunner& tr) {
+    RUN_TEST(tr, ast::TestRoundTrip);
+    RUN_TEST(tr, ast::TestCorruptedImages);
+    RUN_TEST(tr, ast::TestCorruptedSlots);
+    RUN_TEST(tr, ast::TestUnsupportedNodes);
+}
+
+}  // namespace ast
@@ -41,6 +41,16 @@ void TestNumericConst() {
     ObjectHolder o = num.Execute(empty, context);
     ASSERT(o);
     ASSERT(empty.empty());
+    // Значение литерала копируется внутрь ObjectHolder, а не указывает на узел
+    ASSERT(o.GetKind() == runtime::ObjectKind::Number);
+    ASSERT(o.Get() != &num.GetValue());
+    ASSERT_EQUAL(o.TryAs<runtime::Number>()->GetValue(), 57);
+
+    BoolConst flag(runtime::Bool(true));
+    ObjectHolder b = flag.Execute(empty, context);
+    ASSERT(b.GetKind() == runtime::ObjectKind::Bool);
+    ASSERT(b.Get() != &flag.GetValue());
+    ASSERT(b.TryAs<runtime::Bool>()->GetValue());
 
     ostringstream os;
     o->Print(os, context);
@@ -454,6 +464,165 @@ void TestNot() {
     test_not(false);
 }
 
+void TestPolymorphicCallSite() {
+    runtime::DummyContext context;
+
+    // Иерархия глубже ёмкости кеша: каждый класс переопределяет name, метод base наследуется
+    vector<unique_ptr<runtime::Class>> classes;
+    for (int i = 0; i < 6; ++i) {
+        vector<runtime::Method> methods;
+        methods.push_back({"name"s, {}, make_unique<NumericConst>(i)});
+        if (i == 0) {
+            methods.push_back({"base"s, {"x"s}, make_unique<VariableValue>("x"s)});
+        }
+        const runtime::Class* parent = classes.empty() ? nullptr : classes.back().get();
+        classes.push_back(make_unique<runtime::Class>("C"s + to_string(i), std::move(methods), parent));
+    }
+    ASSERT(classes.back()->GetMethod("base"s) == classes.front()->GetMethod("base"s));
+
+    MethodCall name_call(make_unique<VariableValue>("obj"s), "name"s, {});
+    vector<unique_ptr<Statement>> base_args;
+    base_args.push_back(make_unique<VariableValue>("obj"s));
+    MethodCall base_call(make_unique<VariableValue>("obj"s), "base"s, std::move(base_args));
+
+    vector<runtime::ClassInstance> instances;
+    for (const auto& cls : classes) {
+        instances.emplace_back(*cls);
+    }
+    for (int round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < instances.size(); ++i) {
+            Closure closure = {{"obj"s, ObjectHolder::Share(instances[i])}};
+            ASSERT_OBJECT_VALUE_EQUAL(name_call.Execute(closure, context), static_cast<int>(i));
+            ASSERT(base_call.Execute(closure, context).Get() == &instances[i]);
+        }
+    }
+
+    vector<unique_ptr<Statement>> extra_args;
+    extra_args.push_back(make_unique<NumericConst>(1));
+    MethodCall extra_arg_call(make_unique<VariableValue>("obj"s), "name"s, std::move(extra_args));
+    Closure closure = {{"obj"s, ObjectHolder::Share(instances[0])}};
+    ASSERT_OBJECT_VALUE_EQUAL(name_call.Execute(closure, context), 0);
+    ASSERT_THROWS(extra_arg_call.Execute(closure, context), std::runtime_error);
+}
+
+void TestReturnCompletion() {
+    runtime::DummyContext context;
+
+    // if x: return 'then' ; print 'skipped' ; return 'end'
+    auto make_body = [] {
+        auto body = make_unique<Compound>();
+        body->AddStatement(make_unique<IfElse>(make_unique<VariableValue>("x"s),
+                                               make_unique<Compound>(make_unique<Return>(
+                                                   make_unique<StringConst>("then"s))),
+                                               nullptr));
+        body->AddStatement(Print::Variable("x"s));
+        body->AddStatement(make_unique<Return>(make_unique<StringConst>("end"s)));
+        body->AddStatement(Print::Variable("x"s));
+        return make_unique<MethodBody>(std::move(body));
+    };
+
+    Closure closure = {{"x"s, ObjectHolder::Own(runtime::Bool(true))}};
+    ASSERT_OBJECT_VALUE_EQUAL(make_body()->Execute(closure, context), "then"s);
+    ASSERT(context.output.str().empty());
+
+    closure["x"s] = ObjectHolder::Own(runtime::Bool(false));
+    ASSERT_OBJECT_VALUE_EQUAL(make_body()->Execute(closure, context), "end"s);
+    ASSERT_EQUAL(context.output.str(), "False\n"s);
+
+    ObjectHolder result;
+    Compound without_return{make_unique<Assignment>("y"s, make_unique<NumericConst>(1))};
+    ASSERT(without_return.Run(closure, context, result) == Completion::Normal);
+    ASSERT(!result);
+    ASSERT(MethodBody(make_unique<Compound>()).Execute(closure, context).Get() == nullptr);
+
+    // Ошибки времени выполнения проходят через тело метода без изменений
+    MethodBody failing(make_unique<Compound>(
+        make_unique<Return>(make_unique<Div>(make_unique<NumericConst>(1), make_unique<NumericConst>(0)))));
+    ASSERT_THROWS(failing.Execute(closure, context), std::runtime_error);
+}
+
+void TestNewInstanceIsFresh() {
+    runtime::DummyContext context;
+    Closure closure;
+
+    runtime::Class cls{"Point"s, {}, nullptr};
+    NewInstance new_instance{cls};
+    ObjectHolder first = new_instance.Execute(closure, context);
+    ObjectHolder second = new_instance.Execute(closure, context);
+    ASSERT(first.TryAs<runtime::ClassInstance>() != nullptr);
+    ASSERT(first.Get() != second.Get());
+    ASSERT_EQUAL(&new_instance.GetClass(), &cls);
+
+    // Поля одного экземпляра не видны в другом
+    first.TryAs<runtime::ClassInstance>()->Fields()["x"s] = ObjectHolder::Own(runtime::Number{1});
+    ASSERT(second.TryAs<runtime::ClassInstance>()->Fields().empty());
+}
+
+void TestAddQuickening() {
+    runtime::DummyContext context;
+    Closure closure{{"x"s, ObjectHolder::Own(runtime::Number{23})}, {"y"s, ObjectHolder::Own(runtime::Number{34})}};
+
+    Add sum(make_unique<VariableValue>("x"s), make_unique<VariableValue>("y"s));
+    ASSERT(sum.GetOperandTypes() == OperandTypes::Unknown);
+    ASSERT_OBJECT_VALUE_EQUAL(sum.Execute(closure, context), 57);
+    ASSERT(sum.GetOperandTypes() == OperandTypes::Numbers);
+    ASSERT_OBJECT_VALUE_EQUAL(sum.Execute(closure, context), 57);
+
+    // Операнды других типов переводят узел к общему пути
+    closure["x"s] = ObjectHolder::Own(runtime::String{"2"s});
+    closure["y"s] = ObjectHolder::Own(runtime::String{"3"s});
+    ASSERT_OBJECT_VALUE_EQUAL(sum.Execute(closure, context), "23"s);
+    ASSERT(sum.GetOperandTypes() == OperandTypes::Generic);
+    closure["y"s] = ObjectHolder::Own(runtime::Number{3});
+    ASSERT_THROWS(sum.Execute(closure, context), std::runtime_error);
+    closure["x"s] = ObjectHolder::Own(runtime::Number{2});
+    ASSERT_OBJECT_VALUE_EQUAL(sum.Execute(closure, context), 5);
+    ASSERT(sum.GetOperandTypes() == OperandTypes::Generic);
+
+    Add strings(make_unique<StringConst>("a"s), make_unique<StringConst>("b"s));
+    ASSERT_OBJECT_VALUE_EQUAL(strings.Execute(closure, context), "ab"s);
+    ASSERT(strings.GetOperandTypes() == OperandTypes::Strings);
+    ASSERT_OBJECT_VALUE_EQUAL(strings.Execute(closure, context), "ab"s);
+}
+
+void TestComparisonQuickening() {
+    runtime::DummyContext context;
+    Closure closure{{"x"s, ObjectHolder::Own(runtime::Number{1})}, {"y"s, ObjectHolder::Own(runtime::Number{2})}};
+
+    StaticComparison<ComparisonOp::GreaterOrEqual> compare(make_unique<VariableValue>("x"s),
+                                                      make_unique<VariableValue>("y"s));
+    ASSERT_OBJECT_VALUE_EQUAL(compare.Execute(closure, context), "False"s);
+    ASSERT(compare.GetOperandTypes() == OperandTypes::Numbers);
+    closure["x"s] = ObjectHolder::Own(runtime::Number{2});
+    ASSERT_OBJECT_VALUE_EQUAL(compare.Execute(closure, context), "True"s);
+
+    closure["x"s] = ObjectHolder::Own(runtime::String{"a"s});
+    closure["y"s] = ObjectHolder::Own(runtime::String{"b"s});
+    ASSERT_OBJECT_VALUE_EQUAL(compare.Execute(closure, context), "False"s);
+    ASSERT(compare.GetOperandTypes() == OperandTypes::Generic);
+    closure["x"s] = ObjectHolder::Own(runtime::Number{3});
+    closure["y"s] = ObjectHolder::Own(runtime::Number{3});
+    ASSERT_OBJECT_VALUE_EQUAL(compare.Execute(closure, context), "True"s);
+
+    // Сравнение строк не специализируется
+    StaticComparison<ComparisonOp::Less> strings(make_unique<StringConst>("a"s), make_unique<StringConst>("b"s));
+    ASSERT_OBJECT_VALUE_EQUAL(strings.Execute(closure, context), "True"s);
+    ASSERT(strings.GetOperandTypes() == OperandTypes::Generic);
+
+    auto known = MakeComparison(ComparisonOp::NotEqual, make_unique<NumericConst>(1), make_unique<NumericConst>(2));
+    ASSERT(dynamic_cast<StaticComparison<ComparisonOp::NotEqual>*>(known.get()) != nullptr);
+    ASSERT(known->GetOp() == ComparisonOp::NotEqual);
+    ASSERT(*known->GetComparator().target<Comparison::Function>() == &runtime::NotEqual);
+    ASSERT_OBJECT_VALUE_EQUAL(known->Execute(closure, context), "True"s);
+    auto custom = make_unique<Comparison>(
+        [](const ObjectHolder&, const ObjectHolder&, runtime::Context&) {
+            return false;
+        },
+        make_unique<NumericConst>(1), make_unique<NumericConst>(1));
+    ASSERT(!custom->GetOp().has_value());
+    ASSERT_OBJECT_VALUE_EQUAL(custom->Execute(closure, context), "False"s);
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
@@ -477,6 +646,11 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
     RUN_TEST(tr, ast::TestNot);
+    RUN_TEST(tr, ast::TestPolymorphicCallSite);
+    RUN_TEST(tr, ast::TestReturnCompletion);
+    RUN_TEST(tr, ast::TestNewInstanceIsFresh);
+    RUN_TEST(tr, ast::TestAddQuickening);
+    RUN_TEST(tr, ast::TestComparisonQuickening);
 }
 
 }  // namespace ast
\ No newline at end of file
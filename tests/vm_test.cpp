@@ -0,0 +1,224 @@
+#include "../compiler.h"
+#include "../lexer.h"
+#include "../parse.h"
+#include "../statement.h"
+#include "../vm.h"
+
+#include "test_runner.h"
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+string RunTree(const string& program) {
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    return context.output.str();
+}
+
+string RunVm(const string& program) {
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    Program bytecode = Compile(*tree);
+    Machine(bytecode, context).Run(closure);
+    return context.output.str();
+}
+
+// Обе реализации должны выводить одно и то же
+void AssertSameOutput(const string& program, const string& expected) {
+    ASSERT_EQUAL(RunTree(program), expected);
+    ASSERT_EQUAL(RunVm(program), expected);
+}
+
+void TestExpressions() {
+    AssertSameOutput(R"(
+x = 4
+y = 'world'
+print x, x + 6, 'Hello, ' + y
+print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2, -x
+print x > 3 and y == 'world', not x, None, str(x) + str(None)
+print 1 < 2, 2 <= 2, 3 >= 4, 'a' != 'b', True or x / 0
+)"s,
+                     "4 10 Hello, world\n15 120 -13 3 15 -4\nTrue False None 4None\nTrue True False True True\n"s);
+}
+
+void TestClassesAndRecursion() {
+    AssertSameOutput(R"(
+class GCD:
+  def __init__():
+    self.call_count = 0
+
+  def calc(a, b):
+    self.call_count = self.call_count + 1
+    if a < b:
+      return self.calc(b, a)
+    if b == 0:
+      return a
+    return self.calc(a - b, b)
+
+x = GCD()
+print x.calc(510510, 18629977)
+print x.calc(22, 17)
+print x.call_count
+)"s,
+                     "17\n1\n115\n"s);
+}
+
+void TestInheritanceAndSpecialMethods() {
+    AssertSameOutput(R"(
+class Shape:
+  def __str__():
+    return "Shape"
+
+  def area():
+    return 0
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def area():
+    return self.w * self.h
+
+  def __str__():
+    return "Rect(" + str(self.w) + 'x' + str(self.h) + ')'
+
+  def __eq__(other):
+    return self.area() == other.area()
+
+  def __lt__(other):
+    return self.area() < other.area()
+
+class Circle(Shape):
+  def __init__(r):
+    self.r = r
+
+r = Rect(10, 20)
+s = Rect(5, 40)
+c = Circle(52)
+print r, c, c.area(), r.area()
+print r == s, r < s, r > s, r >= s
+)"s,
+                     "Rect(10x20) Shape 0 200\nTrue False False True\n"s);
+}
+
+void TestPrintEvaluationOrder() {
+    AssertSameOutput(R"(
+class Noisy:
+  def say(word):
+    print word
+    return word
+
+n = Noisy()
+print 'start', n.say('inner'), 'end'
+)"s,
+                     "start inner\ninner end\n"s);
+}
+
+void TestMethodCallOnNonInstance() {
+    AssertSameOutput(R"(
+x = 5
+print x.method(1, 2)
+)"s,
+                     "None\n"s);
+}
+
+void TestRuntimeErrors() {
+    ASSERT_THROWS(RunVm("print y\n"s), std::runtime_error);
+    ASSERT_THROWS(RunVm("print 1 / 0\n"s), std::runtime_error);
+    ASSERT_THROWS(RunVm("print 1 + 'a'\n"s), std::runtime_error);
+    ASSERT_THROWS(RunVm(R"(
+class A:
+  def f(x):
+    return x
+
+a = A()
+a.f()
+)"s),
+                  std::runtime_error);
+}
+
+void TestGlobalsAreUpdated() {
+    istringstream input("x = 1\ny = x + 1\n"s);
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure = {{"z"s, runtime::ObjectHolder::Own(runtime::Number(3))}};
+    Program bytecode = Compile(*tree);
+    Machine(bytecode, context).Run(closure);
+
+    ASSERT_EQUAL(closure.size(), 3U);
+    ASSERT_EQUAL(closure.at("y"s).TryAs<runtime::Number>()->GetValue(), 2);
+    ASSERT_EQUAL(closure.at("z"s).TryAs<runtime::Number>()->GetValue(), 3);
+}
+
+void TestDeepRecursionDoesNotUseNativeStack() {
+    const string program = R"(
+class Counter:
+  def count(n):
+    if n == 0:
+      return 0
+    return 1 + self.count(n - 1)
+
+c = Counter()
+print c.count(200000)
+)"s;
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    context.SetRecursionLimit(1000000);
+    runtime::Closure closure;
+    Program bytecode = Compile(*tree);
+    Machine(bytecode, context).Run(closure);
+    ASSERT_EQUAL(context.output.str(), "200000\n"s);
+
+    // Заданное ограничение глубины проверяется так же, как при обходе дерева
+    context.SetRecursionLimit(1000);
+    ASSERT_THROWS(Machine(bytecode, context).Run(closure), runtime::RecursionLimitError);
+}
+
+// Сравнение произвольной функцией выполняется командой CompareCustom
+void TestCustomComparison() {
+    ast::Print print(make_unique<ast::Comparison>(
+        [](const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs, runtime::Context& context) {
+            return runtime::Less(rhs, lhs, context);
+        },
+        make_unique<ast::NumericConst>(2), make_unique<ast::NumericConst>(1)));
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    Program bytecode = Compile(print);
+    Machine(bytecode, context).Run(closure);
+    ASSERT_EQUAL(context.output.str(), "True\n"s);
+}
+
+}  // namespace
+
+void RunVmTests(TestRunner& tr) {
+    RUN_TEST(tr, vm::TestExpressions);
+    RUN_TEST(tr, vm::TestClassesAndRecursion);
+    RUN_TEST(tr, vm::TestInheritanceAndSpecialMethods);
+    RUN_TEST(tr, vm::TestPrintEvaluationOrder);
+    RUN_TEST(tr, vm::TestMethodCallOnNonInstance);
+    RUN_TEST(tr, vm::TestRuntimeErrors);
+    RUN_TEST(tr, vm::TestGlobalsAreUpdated);
+    RUN_TEST(tr, vm::TestDeepRecursionDoesNotUseNativeStack);
+    RUN_TEST(tr, vm::TestCustomComparison);
+}
+
+}  // namespace vm
@@ -0,0 +1,128 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace
+{
+// Пул и номер очереди потока пула, в котором выполняется код
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local size_t current_queue = 0;
+} // namespace
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+    }
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        threads_.emplace_back([this, i] { RunWorker(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (std::thread &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::Submit(Task task)
+{
+    const size_t index = current_pool == this ? current_queue
+                                              : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    {
+        Queue &queue = *queues_[index];
+        std::lock_guard guard(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard guard(mutex_);
+        ++queued_;
+        ++unfinished_;
+    }
+    has_tasks_.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+    std::unique_lock lock(mutex_);
+    all_done_.wait(lock, [this] { return unfinished_ == 0; });
+}
+
+size_t ThreadPool::GetThreadCount() const
+{
+    return threads_.size();
+}
+
+ThreadPool::Task ThreadPool::TakeTask(size_t index)
+{
+    // Задача уже учтена в queued_, поэтому она найдётся в одной из очередей
+    while (true)
+    {
+        for (size_t i = 0; i < queues_.size(); ++i)
+        {
+            Queue &queue = *queues_[(index + i) % queues_.size()];
+            std::lock_guard guard(queue.mutex);
+            if (queue.tasks.empty())
+            {
+                continue;
+            }
+            Task task;
+            if (i == 0)
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            return task;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void ThreadPool::RunWorker(size_t index)
+{
+    current_pool = this;
+    current_queue = index;
+    while (true)
+    {
+        {
+            std::unique_lock lock(mutex_);
+            has_tasks_.wait(lock, [this] { return queued_ != 0 || stopping_; });
+            if (queued_ == 0)
+            {
+                return;
+            }
+            --queued_;
+        }
+        TakeTask(index)();
+
+        bool done = false;
+        {
+            std::lock_guard guard(mutex_);
+            done = --unfinished_ == 0;
+        }
+        if (done)
+        {
+            all_done_.notify_all();
+        }
+    }
+}
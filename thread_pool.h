@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Пул потоков с перехватом работы. У каждого потока своя очередь задач: поток берёт задачи
+ * из начала своей очереди, а когда она пуста - из конца очереди другого потока.
+ * Задачи, добавленные из потока пула, попадают в его собственную очередь.
+ * Задача не должна выбрасывать исключений
+ */
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    // Если thread_count равен 0, используется количество аппаратных потоков
+    explicit ThreadPool(size_t thread_count);
+
+    // Дожидается выполнения всех добавленных задач и завершает потоки
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void Submit(Task task);
+
+    // Блокирует вызывающий поток, пока не будут выполнены все добавленные задачи
+    void Wait();
+
+    [[nodiscard]] size_t GetThreadCount() const;
+
+private:
+    struct Queue
+    {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    void RunWorker(size_t index);
+    Task TakeTask(size_t index);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_queue_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    std::condition_variable all_done_;
+    // Задачи в очередях, ещё не взятые потоками
+    size_t queued_ = 0;
+    // Задачи в очередях и выполняющиеся задачи
+    size_t unfinished_ = 0;
+    bool stopping_ = false;
+};
@@ -0,0 +1,346 @@
+#include "vm.h"
+
+using namespace std;
+
+namespace vm
+{
+
+using runtime::ClassInstance;
+using runtime::ObjectHolder;
+
+namespace
+{
+const runtime::Symbol INIT_METHOD = "__init__";
+
+// Значение регистров переменных, которым ещё ничего не присвоено
+class Undefined : public runtime::Object
+{
+public:
+    void Print(std::ostream & /*os*/, runtime::Context & /*context*/) override {}
+};
+
+Undefined UNDEFINED;
+
+bool Compare(CompareOp op, const ObjectHolder &lhs, const ObjectHolder &rhs, runtime::Context &context)
+{
+    switch (op)
+    {
+    case CompareOp::Equal:
+        return runtime::Equal(lhs, rhs, context);
+    case CompareOp::NotEqual:
+        return runtime::NotEqual(lhs, rhs, context);
+    case CompareOp::Less:
+        return runtime::Less(lhs, rhs, context);
+    case CompareOp::Greater:
+        return runtime::Greater(lhs, rhs, context);
+    case CompareOp::LessOrEqual:
+        return runtime::LessOrEqual(lhs, rhs, context);
+    case CompareOp::GreaterOrEqual:
+        return runtime::GreaterOrEqual(lhs, rhs, context);
+    }
+    throw std::runtime_error("Unknown comparison in vm::Machine"s);
+}
+
+// Возвращает true, если за вызовом с результатом в регистре result (возможно, после перехода) следует его возврат
+bool IsTailCall(const Instruction *code, size_t pc, Register result)
+{
+    const Instruction *next = &code[pc];
+    if (next->op == OpCode::Jump)
+    {
+        next = &code[next->b];
+    }
+    return next->op == OpCode::Return && next->a == result;
+}
+} // namespace
+
+Machine::Machine(const Program &program, runtime::Context &context) : program_(program), context_(context) {}
+
+void Machine::Run(runtime::Closure &globals)
+{
+    const Function &main = program_.main;
+    registers_.clear();
+    registers_.resize(main.register_count);
+    frames_.clear();
+    frames_.push_back(Frame{&main, 0, 0, NO_REGISTER});
+
+    for (uint32_t i = 0; i < main.local_count; ++i)
+    {
+        auto iter = globals.find(main.local_names[i]);
+        registers_[i] = iter != globals.end() ? iter->second : ObjectHolder::Share(UNDEFINED);
+    }
+
+    // Присваивания, выполненные до ошибки времени выполнения, остаются в globals, как при обходе дерева
+    const auto store_globals = [&] {
+        for (uint32_t i = 0; i < main.local_count; ++i)
+        {
+            if (registers_[i].Get() != &UNDEFINED)
+            {
+                globals[main.local_names[i]] = registers_[i];
+            }
+        }
+        registers_.clear();
+    };
+    try
+    {
+        Execute();
+    }
+    catch (...)
+    {
+        store_globals();
+        throw;
+    }
+    store_globals();
+}
+
+void Machine::PushFrame(const Function &function, ClassInstance &self, size_t first_arg, uint32_t arg_count,
+                        Register result)
+{
+    context_.Step();
+    // Кадры методов (кроме кадра программы) учитываются вместе с вызовами, незавершёнными при обходе дерева
+    if (context_.GetCallDepth() + frames_.size() - 1 >= context_.GetRecursionLimit())
+    {
+        throw runtime::RecursionLimitError("Maximum recursion depth exceeded"s);
+    }
+    Frame &caller = frames_.back();
+    const size_t base = caller.base + caller.function->register_count;
+    const size_t caller_first_arg = caller.base + first_arg;
+
+    registers_.resize(base + function.register_count);
+    registers_[base] = ObjectHolder::Share(self);
+    for (uint32_t i = 0; i < arg_count; ++i)
+    {
+        registers_[base + 1 + i] = registers_[caller_first_arg + i];
+    }
+    for (uint32_t i = function.param_count; i < function.local_count; ++i)
+    {
+        registers_[base + i] = ObjectHolder::Share(UNDEFINED);
+    }
+    frames_.push_back(Frame{&function, 0, base, result});
+}
+
+void Machine::ReplaceFrame(const Function &function, ObjectHolder self, size_t first_arg, uint32_t arg_count)
+{
+    context_.Step();
+    Frame &frame = frames_.back();
+    const size_t base = frame.base;
+    // Параметры переносятся до того, как регистры кадра будут перезаписаны
+    tail_args_.assign(registers_.begin() + base + first_arg, registers_.begin() + base + first_arg + arg_count);
+
+    registers_.resize(base + function.register_count);
+    registers_[base] = std::move(self);
+    for (uint32_t i = 0; i < arg_count; ++i)
+    {
+        registers_[base + 1 + i] = std::move(tail_args_[i]);
+    }
+    for (uint32_t i = function.param_count; i < function.local_count; ++i)
+    {
+        registers_[base + i] = ObjectHolder::Share(UNDEFINED);
+    }
+    for (uint32_t i = function.local_count; i < function.register_count; ++i)
+    {
+        registers_[base + i] = ObjectHolder::None();
+    }
+    tail_args_.clear();
+    frame.function = &function;
+    frame.pc = 0;
+}
+
+bool Machine::PopFrame(ObjectHolder result)
+{
+    const Frame frame = frames_.back();
+    if (frames_.size() == 1)
+    {
+        return false;
+    }
+    frames_.pop_back();
+    registers_.resize(frame.base);
+    if (frame.result != NO_REGISTER)
+    {
+        registers_[frames_.back().base + frame.result] = std::move(result);
+    }
+    return true;
+}
+
+void Machine::Execute()
+{
+    const Function *function = nullptr;
+    const Instruction *code = nullptr;
+    ObjectHolder *regs = nullptr;
+    size_t pc = 0;
+
+    // Перечитывает состояние текущего кадра после вызова или возврата
+    auto load_frame = [&]() {
+        const Frame &frame = frames_.back();
+        function = frame.function;
+        code = function->code.data();
+        regs = registers_.data() + frame.base;
+        pc = frame.pc;
+    };
+    load_frame();
+
+    while (true)
+    {
+        const Instruction &ins = code[pc++];
+        switch (ins.op)
+        {
+        case OpCode::LoadConst:
+            regs[ins.a] = function->constants[ins.b];
+            break;
+        case OpCode::LoadNone:
+            regs[ins.a] = ObjectHolder::None();
+            break;
+        case OpCode::LoadBool:
+            regs[ins.a] = ObjectHolder::Own(runtime::Bool(ins.b != 0));
+            break;
+        case OpCode::Move:
+            regs[ins.a] = regs[ins.b];
+            break;
+        case OpCode::CheckDefined:
+            if (regs[ins.a].Get() == &UNDEFINED)
+            {
+                throw std::runtime_error("Failed to VariableValue::Execute!");
+            }
+            break;
+        case OpCode::GetField: {
+            // Как и при обходе дерева, обращение к полю не у экземпляра класса возвращает сам объект
+            ObjectHolder object = regs[ins.b];
+            if (auto instance = object.TryAs<ClassInstance>())
+            {
+                object = instance->Fields().at(function->names[ins.c]);
+            }
+            regs[ins.a] = std::move(object);
+            break;
+        }
+        case OpCode::SetField: {
+            auto instance = regs[ins.a].TryAs<ClassInstance>();
+            if (instance == nullptr)
+            {
+                throw std::runtime_error("Failed to FieldAssignment::Execute ");
+            }
+            instance->Fields()[function->names[ins.b]] = regs[ins.c];
+            break;
+        }
+        case OpCode::Add:
+            regs[ins.a] = runtime::Add(regs[ins.b], regs[ins.c], context_);
+            break;
+        case OpCode::Sub:
+            regs[ins.a] = runtime::Sub(regs[ins.b], regs[ins.c]);
+            break;
+        case OpCode::Mult:
+            regs[ins.a] = runtime::Mult(regs[ins.b], regs[ins.c]);
+            break;
+        case OpCode::Div:
+            regs[ins.a] = runtime::Div(regs[ins.b], regs[ins.c]);
+            break;
+        case OpCode::Compare:
+            regs[ins.a] =
+                ObjectHolder::Own(runtime::Bool(Compare(static_cast<CompareOp>(ins.d), regs[ins.b], regs[ins.c], context_)));
+            break;
+        case OpCode::CompareCustom:
+            regs[ins.a] =
+                ObjectHolder::Own(runtime::Bool(function->custom_comparators[ins.d](regs[ins.b], regs[ins.c], context_)));
+            break;
+        case OpCode::Not:
+            regs[ins.a] = ObjectHolder::Own(runtime::Bool(!runtime::IsTrue(regs[ins.b])));
+            break;
+        case OpCode::Stringify:
+            regs[ins.a] = ObjectHolder::Own(runtime::String(runtime::ToString(regs[ins.b], context_)));
+            break;
+        case OpCode::Jump:
+            pc = ins.b;
+            break;
+        case OpCode::JumpIfFalse:
+            if (!runtime::IsTrue(regs[ins.a]))
+            {
+                pc = ins.b;
+            }
+            break;
+        case OpCode::JumpIfTrue:
+            if (runtime::IsTrue(regs[ins.a]))
+            {
+                pc = ins.b;
+            }
+            break;
+        case OpCode::JumpIfNotInstance:
+            if (regs[ins.a].TryAs<ClassInstance>() == nullptr)
+            {
+                pc = ins.b;
+            }
+            break;
+        case OpCode::Print:
+            context_.Step();
+            runtime::PrintValue(regs[ins.a], context_);
+            break;
+        case OpCode::PrintSpace:
+            context_.GetOutputBuffer().Append(' ');
+            break;
+        case OpCode::PrintNewline:
+            context_.GetOutputBuffer().Append('\n');
+            break;
+        case OpCode::CallMethod: {
+            auto instance = regs[ins.b].TryAs<ClassInstance>();
+            const CallSite &site = function->call_sites[ins.c];
+            const runtime::Method *method = instance->GetClass().GetMethod(site.method);
+            if (method == nullptr || method->formal_params.size() != site.arg_count)
+            {
+                throw std::runtime_error("Cannot call method");
+            }
+            auto compiled = program_.method_index.find(method);
+            if (compiled == program_.method_index.end())
+            {
+                std::vector<ObjectHolder> args(regs + site.first_arg, regs + site.first_arg + site.arg_count);
+                regs[ins.a] = instance->Call(*method, args, context_);
+                break;
+            }
+            if (frames_.size() > 1 && IsTailCall(code, pc, ins.a))
+            {
+                // Владение объектом в регистре self сохраняет его, пока исполняется метод
+                ReplaceFrame(program_.methods[compiled->second], regs[ins.b], site.first_arg, site.arg_count);
+            }
+            else
+            {
+                frames_.back().pc = pc;
+                PushFrame(program_.methods[compiled->second], *instance, site.first_arg, site.arg_count, ins.a);
+            }
+            load_frame();
+            break;
+        }
+        case OpCode::NewInstance:
+            regs[ins.a] = ObjectHolder::Own(ClassInstance(*program_.classes[ins.b]));
+            break;
+        case OpCode::Construct: {
+            ObjectHolder holder = ObjectHolder::Own(ClassInstance(*program_.classes[ins.b]));
+            auto instance = holder.TryAs<ClassInstance>();
+            regs[ins.a] = holder;
+            const runtime::Method *init = instance->GetClass().GetMethod(INIT_METHOD);
+            auto compiled = program_.method_index.find(init);
+            if (compiled == program_.method_index.end())
+            {
+                std::vector<ObjectHolder> args(regs + ins.c, regs + ins.c + ins.d);
+                instance->Call(INIT_METHOD, args, context_);
+                break;
+            }
+            frames_.back().pc = pc;
+            PushFrame(program_.methods[compiled->second], *instance, ins.c, ins.d, NO_REGISTER);
+            load_frame();
+            break;
+        }
+        case OpCode::Return:
+            if (!PopFrame(regs[ins.a]))
+            {
+                return;
+            }
+            load_frame();
+            break;
+        case OpCode::ReturnNone:
+            if (!PopFrame(ObjectHolder::None()))
+            {
+                return;
+            }
+            load_frame();
+            break;
+        }
+    }
+}
+
+} // namespace vm
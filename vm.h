@@ -0,0 +1,58 @@
+#pragma once
+
+#include "bytecode.h"
+
+#include <vector>
+
+namespace vm
+{
+
+/*
+ * Регистровая машина, исполняющая скомпилированную программу.
+ * Вызовы скомпилированных методов не используют стек C++: каждый вызов добавляет кадр
+ * в frames_, а регистры кадров лежат подряд в общем массиве registers_. Вызов, значение которого
+ * сразу возвращается (return obj.method(...)), замещает кадр вызывающего метода.
+ * Некомпилированные методы и специальные методы (__str__, __eq__ и т.д.), вызываемые из runtime,
+ * исполняются обходом дерева через ClassInstance::Call.
+ */
+class Machine
+{
+public:
+    Machine(const Program &program, runtime::Context &context);
+
+    // Исполняет код верхнего уровня. Переменные программы читаются из globals
+    // и записываются в него по завершении
+    void Run(runtime::Closure &globals);
+
+private:
+    struct Frame
+    {
+        const Function *function = nullptr;
+        size_t pc = 0;
+        size_t base = 0;
+        // Регистр вызывающего кадра для результата либо NO_REGISTER, если результат не нужен
+        Register result = NO_REGISTER;
+    };
+
+    void Execute();
+
+    // Добавляет кадр вызова метода function у объекта self с параметрами из регистров вызывающего кадра
+    void PushFrame(const Function &function, runtime::ClassInstance &self, size_t first_arg, uint32_t arg_count,
+                   Register result);
+
+    // Замещает текущий кадр кадром хвостового вызова метода function у объекта self
+    void ReplaceFrame(const Function &function, runtime::ObjectHolder self, size_t first_arg, uint32_t arg_count);
+
+    // Завершает текущий кадр, передавая результат в вызывающий. Возвращает false, если завершён код
+    // верхнего уровня
+    bool PopFrame(runtime::ObjectHolder result);
+
+    const Program &program_;
+    runtime::Context &context_;
+    std::vector<runtime::ObjectHolder> registers_;
+    std::vector<Frame> frames_;
+    // Параметры хвостового вызова на время замещения кадра
+    std::vector<runtime::ObjectHolder> tail_args_;
+};
+
+} // namespace vm